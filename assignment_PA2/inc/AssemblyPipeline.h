@@ -0,0 +1,101 @@
+#ifndef _ASSEMBLYPIPELINE_H_
+#define _ASSEMBLYPIPELINE_H_
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Node.h"
+#include "Element.h"
+#include "FEGrid.h"
+#include "FEAssembler.h"
+
+using namespace std;
+
+/**
+ * @class AssemblyPipeline
+ * @brief Reads a mesh and assembles its stiffness matrix with overlapping stages.
+ *
+ * Five stages run on their own threads, connected by BoundedQueue objects:
+ * - nodes: parses the .node file into the coordinate table, in batches;
+ * - numbering: tags boundary nodes and numbers the interior ones in global
+ *   node order as soon as a contiguous prefix of nodes has been parsed;
+ * - elements: parses the .elem file into batches of elements;
+ * - kernel: computes the element stiffness matrices of a batch once the node
+ *   coordinates are complete;
+ * - scatter: adds each batch into per-row accumulators once the numbering is
+ *   complete (the pattern grows with the batches).
+ * Assembly thus starts while the element file is still being read, and the
+ * queues bound the memory held by batches in flight. Finally the rows are
+ * sorted into CSR, the scatter map is resolved and the grid and an assembled
+ * FEAssembler are handed out, identical to reading with FEGrid and assembling
+ * with FEAssembler.
+ */
+class AssemblyPipeline
+{
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param a_conductivity Conductivity tensor (row major DIM x DIM) of every element.
+   * @param a_batchSize Nodes or elements per batch.
+   * @param a_queueDepth Batches each queue holds before its producer blocks.
+   */
+  AssemblyPipeline(const double a_conductivity[DIM * DIM], const int& a_batchSize = 4096,
+                   const int& a_queueDepth = 8);
+
+  /**
+   * @brief Read a mesh and assemble its stiffness matrix.
+   *
+   * @param a_nodeFileName The .node file.
+   * @param a_elementFileName The .elem file.
+   * @param a_grid Grid to replace with the mesh.
+   * @param a_assembler Set to an assembler of a_grid holding the assembled matrix.
+   * @return False if a file could not be opened, is truncated, or has a node or element
+   * number out of range or repeated; a_grid and a_assembler are then unchanged.
+   */
+  bool run(const std::string& a_nodeFileName, const std::string& a_elementFileName, FEGrid& a_grid,
+           unique_ptr<FEAssembler>& a_assembler);
+
+  /**
+   * @brief Print the busy and blocked time and the throughput of each stage of the last run().
+   *
+   * @param a_os Output stream.
+   */
+  void printStatistics(ostream& a_os) const;
+
+private:
+  /**
+   * @brief Batch of elements travelling from the parser through the kernel to the scatter.
+   */
+  struct ElementBatch
+  {
+    vector<int> ids; /**< Element numbers (0-based). */
+    vector<int> vertices; /**< VERTICES node numbers (0-based) per element. */
+    vector<double> matrices; /**< VERTICES x VERTICES stiffness matrix per element, filled by the kernel. */
+  };
+
+  /**
+   * @brief Time and volume of one stage.
+   */
+  struct Stage
+  {
+    const char* name; /**< Stage name. */
+    double seconds; /**< Wall time from start to finish of the stage. */
+    double blocked; /**< Time spent waiting for input, for space or for another stage. */
+    long items; /**< Nodes, elements or rows processed. */
+  };
+
+  enum
+  {
+    NODES, NUMBERING, ELEMENTS, KERNEL, SCATTER, FINALIZE, NUM_STAGES
+  };
+
+  double m_conductivity[DIM * DIM]; /**< Conductivity tensor. */
+  int m_batchSize; /**< Items per batch. */
+  int m_queueDepth; /**< Capacity of the queues. */
+  Stage m_stages[NUM_STAGES]; /**< Statistics of the last run(). */
+  double m_elapsed; /**< Wall time of the last run(). */
+};
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef _BOUNDEDQUEUE_H_
+#define _BOUNDEDQUEUE_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+using namespace std;
+
+/**
+ * @class BoundedQueue
+ * @brief Blocking first-in first-out queue of limited capacity between two pipeline stages.
+ *
+ * push() blocks while the queue is full, so a fast producer cannot run ahead of
+ * its consumer by more than the capacity; pop() blocks while it is empty. The
+ * producer calls close() after its last item, after which pop() drains the
+ * queue and then reports the end. Both calls add the time spent blocked to a
+ * counter, which tells which side of the queue is the bottleneck.
+ */
+template <class T>
+class BoundedQueue
+{
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param a_capacity Maximum number of queued items (at least 1).
+   */
+  explicit BoundedQueue(const size_t& a_capacity)
+    : m_capacity(a_capacity > 0 ? a_capacity : 1), m_closed(false), m_pushWait(0.0), m_popWait(0.0)
+  {
+  }
+
+  /**
+   * @brief Append an item, waiting for space.
+   *
+   * @param a_item The item; moved from.
+   */
+  void push(T& a_item)
+  {
+    unique_lock<mutex> guard(m_lock);
+    if (m_items.size() >= m_capacity)
+    {
+      auto start = chrono::steady_clock::now();
+      m_notFull.wait(guard, [this] { return m_items.size() < m_capacity; });
+      m_pushWait += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    m_items.push_back(std::move(a_item));
+    m_notEmpty.notify_one();
+  }
+
+  /**
+   * @brief Remove the oldest item, waiting for one.
+   *
+   * @param a_item Item to fill.
+   * @return False once the queue is closed and empty.
+   */
+  bool pop(T& a_item)
+  {
+    unique_lock<mutex> guard(m_lock);
+    if (m_items.empty() && !m_closed)
+    {
+      auto start = chrono::steady_clock::now();
+      m_notEmpty.wait(guard, [this] { return !m_items.empty() || m_closed; });
+      m_popWait += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    if (m_items.empty())
+      return false;
+    a_item = std::move(m_items.front());
+    m_items.pop_front();
+    m_notFull.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief Mark the end of the input; called once by the producer.
+   */
+  void close()
+  {
+    lock_guard<mutex> guard(m_lock);
+    m_closed = true;
+    m_notEmpty.notify_all();
+  }
+
+  /**
+   * @brief Time the producer spent waiting for space.
+   *
+   * @return Seconds blocked in push().
+   */
+  double getPushWait() const
+  {
+    lock_guard<mutex> guard(m_lock);
+    return m_pushWait;
+  }
+
+  /**
+   * @brief Time the consumer spent waiting for items.
+   *
+   * @return Seconds blocked in pop().
+   */
+  double getPopWait() const
+  {
+    lock_guard<mutex> guard(m_lock);
+    return m_popWait;
+  }
+
+private:
+  BoundedQueue(const BoundedQueue&);
+  BoundedQueue& operator=(const BoundedQueue&);
+
+  size_t m_capacity; /**< Maximum number of queued items. */
+  deque<T> m_items; /**< Queued items, oldest first. */
+  bool m_closed; /**< True once the producer is done. */
+  double m_pushWait; /**< Seconds blocked in push(). */
+  double m_popWait; /**< Seconds blocked in pop(). */
+  mutable mutex m_lock; /**< Guards all members. */
+  condition_variable m_notFull; /**< Signalled when an item is removed. */
+  condition_variable m_notEmpty; /**< Signalled when an item is added or the queue is closed. */
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef _CONTENTHASH_H_
+#define _CONTENTHASH_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class ContentHash
+ * @brief FNV-1a hashing of values and file contents, shared by the caches.
+ *
+ * Every file is hashed byte by byte and followed by a separator, so that
+ * moving bytes from one file to the next changes the hash.
+ */
+class ContentHash
+{
+public:
+  static const uint64_t s_offset = 14695981039346656037ULL; /**< FNV-1a offset basis, the empty hash. */
+
+  /**
+   * @brief Add one value to a hash.
+   *
+   * @param a_hash The hash so far.
+   * @param a_value The value.
+   * @return The new hash.
+   */
+  static uint64_t add(const uint64_t& a_hash, const uint64_t& a_value)
+  {
+    return (a_hash ^ a_value) * 1099511628211ULL;
+  }
+
+  /**
+   * @brief Add the contents of files to a hash.
+   *
+   * @param a_files The files, in order.
+   * @param a_hash The hash so far; updated.
+   * @return False if a file could not be opened (a_hash is then undefined).
+   */
+  static bool addFiles(const vector<std::string>& a_files, uint64_t& a_hash);
+};
+
+#endif
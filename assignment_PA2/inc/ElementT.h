@@ -0,0 +1,301 @@
+#ifndef _ELEMENTT_H_
+#define _ELEMENTT_H_
+
+#include <cmath>
+#include <utility>
+
+using namespace std;
+
+/**
+ * @brief Call a_body(integral_constant<int, i>) for i = 0 .. N-1, expanded at compile time.
+ *
+ * The loop index is a constant expression in the body, so loops over the
+ * nodes, quadrature points and dimensions of an element are fully unrolled
+ * (once the lambdas are inlined, i.e. with optimization enabled).
+ */
+template <class F, int... I>
+inline void unrollImpl(F& a_body, integer_sequence<int, I...>)
+{
+  (a_body(integral_constant<int, I>()), ...);
+}
+
+template <int N, class F>
+inline void unroll(F&& a_body)
+{
+  unrollImpl(a_body, make_integer_sequence<int, N>());
+}
+
+/**
+ * @brief Shape tag of triangles.
+ */
+struct Triangle
+{
+  static constexpr int dim = 2; /**< Spatial dimension. */
+};
+
+/**
+ * @brief Shape tag of tetrahedra.
+ */
+struct Tetrahedron
+{
+  static constexpr int dim = 3; /**< Spatial dimension. */
+};
+
+/**
+ * @class ElementT
+ * @brief Reference element of a shape and polynomial order, with all sizes known at compile time.
+ *
+ * Named ElementT because Element is the vertex container of FEGrid. Every
+ * specialization provides the node count, shape functions and their
+ * gradients on the reference simplex, and two quadrature rules: one exact for
+ * the stiffness integrand and one exact for (order + 2) degree polynomials for
+ * load vectors. The first dim + 1 nodes are the vertices, which define the
+ * affine map to the physical element.
+ */
+template <class Shape, int Order>
+class ElementT;
+
+/**
+ * @brief Linear triangle: nodes at the vertices.
+ */
+template <>
+class ElementT<Triangle, 1>
+{
+public:
+  static constexpr int dim = 2; /**< Spatial dimension. */
+  static constexpr int numNodes = 3; /**< Nodes per element. */
+  static constexpr int numStiffnessPoints = 1; /**< The gradients are constant. */
+  static constexpr double stiffnessPoints[1][2] = {{1.0 / 3, 1.0 / 3}};
+  static constexpr double stiffnessWeights[1] = {0.5};
+  static constexpr int numLoadPoints = 3; /**< Degree 2. */
+  static constexpr double loadPoints[3][2] = {{1.0 / 6, 1.0 / 6}, {2.0 / 3, 1.0 / 6}, {1.0 / 6, 2.0 / 3}};
+  static constexpr double loadWeights[3] = {1.0 / 6, 1.0 / 6, 1.0 / 6};
+
+  /**
+   * @brief Shape functions at a reference point.
+   */
+  static void shape(const double a_xi[2], double a_n[3])
+  {
+    a_n[0] = 1.0 - a_xi[0] - a_xi[1];
+    a_n[1] = a_xi[0];
+    a_n[2] = a_xi[1];
+  }
+
+  /**
+   * @brief Reference gradients of the shape functions, one row per node.
+   */
+  static void gradients(const double*, double a_g[3][2])
+  {
+    a_g[0][0] = -1.0; a_g[0][1] = -1.0;
+    a_g[1][0] = 1.0;  a_g[1][1] = 0.0;
+    a_g[2][0] = 0.0;  a_g[2][1] = 1.0;
+  }
+};
+
+/**
+ * @brief Quadratic triangle: vertices, then the midpoints of edges 0-1, 1-2 and 2-0.
+ */
+template <>
+class ElementT<Triangle, 2>
+{
+public:
+  static constexpr int dim = 2; /**< Spatial dimension. */
+  static constexpr int numNodes = 6; /**< Nodes per element. */
+  static constexpr int numStiffnessPoints = 3; /**< Degree 2. */
+  static constexpr double stiffnessPoints[3][2] = {{1.0 / 6, 1.0 / 6}, {2.0 / 3, 1.0 / 6}, {1.0 / 6, 2.0 / 3}};
+  static constexpr double stiffnessWeights[3] = {1.0 / 6, 1.0 / 6, 1.0 / 6};
+  static constexpr int numLoadPoints = 6; /**< Degree 4 (Dunavant). */
+  static constexpr double loadPoints[6][2] = {
+    {0.445948490915965, 0.445948490915965}, {0.108103018168070, 0.445948490915965},
+    {0.445948490915965, 0.108103018168070}, {0.091576213509771, 0.091576213509771},
+    {0.816847572980459, 0.091576213509771}, {0.091576213509771, 0.816847572980459}};
+  static constexpr double loadWeights[6] = {0.111690794839005, 0.111690794839005, 0.111690794839005,
+                                            0.054975871827661, 0.054975871827661, 0.054975871827661};
+
+  /**
+   * @brief Shape functions at a reference point.
+   */
+  static void shape(const double a_xi[2], double a_n[6])
+  {
+    double l0 = 1.0 - a_xi[0] - a_xi[1], l1 = a_xi[0], l2 = a_xi[1];
+    a_n[0] = l0 * (2 * l0 - 1);
+    a_n[1] = l1 * (2 * l1 - 1);
+    a_n[2] = l2 * (2 * l2 - 1);
+    a_n[3] = 4 * l0 * l1;
+    a_n[4] = 4 * l1 * l2;
+    a_n[5] = 4 * l2 * l0;
+  }
+
+  /**
+   * @brief Reference gradients of the shape functions, one row per node.
+   */
+  static void gradients(const double a_xi[2], double a_g[6][2])
+  {
+    double l0 = 1.0 - a_xi[0] - a_xi[1], l1 = a_xi[0], l2 = a_xi[1];
+    a_g[0][0] = -(4 * l0 - 1);    a_g[0][1] = -(4 * l0 - 1);
+    a_g[1][0] = 4 * l1 - 1;       a_g[1][1] = 0.0;
+    a_g[2][0] = 0.0;              a_g[2][1] = 4 * l2 - 1;
+    a_g[3][0] = 4 * (l0 - l1);    a_g[3][1] = -4 * l1;
+    a_g[4][0] = 4 * l2;           a_g[4][1] = 4 * l1;
+    a_g[5][0] = -4 * l2;          a_g[5][1] = 4 * (l0 - l2);
+  }
+};
+
+/**
+ * @brief Linear tetrahedron: nodes at the vertices.
+ */
+template <>
+class ElementT<Tetrahedron, 1>
+{
+public:
+  static constexpr int dim = 3; /**< Spatial dimension. */
+  static constexpr int numNodes = 4; /**< Nodes per element. */
+  static constexpr int numStiffnessPoints = 1; /**< The gradients are constant. */
+  static constexpr double stiffnessPoints[1][3] = {{0.25, 0.25, 0.25}};
+  static constexpr double stiffnessWeights[1] = {1.0 / 6};
+  static constexpr int numLoadPoints = 4; /**< Degree 2. */
+  static constexpr double loadPoints[4][3] = {{0.138196601125011, 0.138196601125011, 0.138196601125011},
+                                              {0.585410196624968, 0.138196601125011, 0.138196601125011},
+                                              {0.138196601125011, 0.585410196624968, 0.138196601125011},
+                                              {0.138196601125011, 0.138196601125011, 0.585410196624968}};
+  static constexpr double loadWeights[4] = {1.0 / 24, 1.0 / 24, 1.0 / 24, 1.0 / 24};
+
+  /**
+   * @brief Shape functions at a reference point.
+   */
+  static void shape(const double a_xi[3], double a_n[4])
+  {
+    a_n[0] = 1.0 - a_xi[0] - a_xi[1] - a_xi[2];
+    a_n[1] = a_xi[0];
+    a_n[2] = a_xi[1];
+    a_n[3] = a_xi[2];
+  }
+
+  /**
+   * @brief Reference gradients of the shape functions, one row per node.
+   */
+  static void gradients(const double*, double a_g[4][3])
+  {
+    a_g[0][0] = -1.0; a_g[0][1] = -1.0; a_g[0][2] = -1.0;
+    a_g[1][0] = 1.0;  a_g[1][1] = 0.0;  a_g[1][2] = 0.0;
+    a_g[2][0] = 0.0;  a_g[2][1] = 1.0;  a_g[2][2] = 0.0;
+    a_g[3][0] = 0.0;  a_g[3][1] = 0.0;  a_g[3][2] = 1.0;
+  }
+};
+
+/**
+ * @class ElementKernel
+ * @brief Element stiffness matrix and load vector of an ElementT, instantiated per element type.
+ *
+ * All loops run over compile-time counts and are unrolled with unroll(), so an
+ * instantiation is straight-line code without dimension or order branches.
+ */
+template <class E>
+class ElementKernel
+{
+public:
+  static constexpr int dim = E::dim; /**< Spatial dimension. */
+  static constexpr int numNodes = E::numNodes; /**< Nodes per element. */
+
+  /**
+   * @brief Compute the element stiffness matrix, the integral of grad N_i^T C grad N_j.
+   *
+   * @param a_x Coordinates of the nodes (only the vertices are used: the map is affine).
+   * @param a_conductivity Conductivity tensor (row major dim x dim).
+   * @param a_k Array to store the numNodes x numNodes matrix (row major).
+   */
+  static void stiffness(const double a_x[numNodes][dim], const double a_conductivity[dim * dim],
+                        double a_k[numNodes * numNodes])
+  {
+    double inverse[dim][dim];
+    double det = affine(a_x, inverse);
+    unroll<numNodes * numNodes>([&](auto k) { a_k[k] = 0.0; });
+    unroll<E::numStiffnessPoints>([&](auto q) {
+      double g[numNodes][dim], b[numNodes][dim], cb[numNodes][dim];
+      E::gradients(E::stiffnessPoints[q], g);
+      // Physical gradients b_i = J^-T g_i, and C b_i
+      unroll<numNodes>([&](auto i) {
+        unroll<dim>([&](auto r) {
+          b[i][r] = 0.0;
+          unroll<dim>([&](auto c) { b[i][r] += inverse[c][r] * g[i][c]; });
+        });
+        unroll<dim>([&](auto r) {
+          cb[i][r] = 0.0;
+          unroll<dim>([&](auto c) { cb[i][r] += a_conductivity[r * dim + c] * b[i][c]; });
+        });
+      });
+      double weight = E::stiffnessWeights[q] * fabs(det);
+      unroll<numNodes>([&](auto i) {
+        unroll<numNodes>([&](auto j) {
+          double sum = 0.0;
+          unroll<dim>([&](auto r) { sum += b[i][r] * cb[j][r]; });
+          a_k[i * numNodes + j] += weight * sum;
+        });
+      });
+    });
+  }
+
+  /**
+   * @brief Compute the element load vector, the integral of f N_i.
+   *
+   * @param a_x Coordinates of the nodes.
+   * @param a_source Source f, called with a point of dim coordinates.
+   * @param a_f Array to store the numNodes values.
+   */
+  template <class Source>
+  static void load(const double a_x[numNodes][dim], const Source& a_source, double a_f[numNodes])
+  {
+    double inverse[dim][dim];
+    double det = affine(a_x, inverse);
+    unroll<numNodes>([&](auto i) { a_f[i] = 0.0; });
+    unroll<E::numLoadPoints>([&](auto q) {
+      double n[numNodes], point[dim];
+      E::shape(E::loadPoints[q], n);
+      unroll<dim>([&](auto r) {
+        point[r] = a_x[0][r];
+        unroll<dim>([&](auto c) { point[r] += (a_x[c + 1][r] - a_x[0][r]) * E::loadPoints[q][c]; });
+      });
+      double value = E::loadWeights[q] * fabs(det) * a_source(point);
+      unroll<numNodes>([&](auto i) { a_f[i] += value * n[i]; });
+    });
+  }
+
+private:
+  /**
+   * @brief Jacobian J[r][c] = x_{c+1}[r] - x_0[r] of the affine map.
+   *
+   * @param a_x Coordinates of the nodes.
+   * @param a_inverse Filled with the inverse of J.
+   * @return The determinant of J.
+   */
+  static double affine(const double a_x[numNodes][dim], double a_inverse[dim][dim])
+  {
+    double j[dim][dim];
+    unroll<dim>([&](auto r) { unroll<dim>([&](auto c) { j[r][c] = a_x[c + 1][r] - a_x[0][r]; }); });
+    if constexpr (dim == 2)
+    {
+      double det = j[0][0] * j[1][1] - j[0][1] * j[1][0];
+      a_inverse[0][0] = j[1][1] / det;
+      a_inverse[0][1] = -j[0][1] / det;
+      a_inverse[1][0] = -j[1][0] / det;
+      a_inverse[1][1] = j[0][0] / det;
+      return det;
+    }
+    else
+    {
+      // Cofactors: inverse = adj(J) / det
+      double det = 0.0;
+      unroll<3>([&](auto r) {
+        unroll<3>([&](auto c) {
+          constexpr int r1 = (r + 1) % 3, r2 = (r + 2) % 3, c1 = (c + 1) % 3, c2 = (c + 2) % 3;
+          a_inverse[c][r] = j[r1][c1] * j[r2][c2] - j[r1][c2] * j[r2][c1];
+        });
+      });
+      unroll<3>([&](auto c) { det += j[0][c] * a_inverse[c][0]; });
+      unroll<3>([&](auto r) { unroll<3>([&](auto c) { a_inverse[r][c] /= det; }); });
+      return det;
+    }
+  }
+};
+
+#endif
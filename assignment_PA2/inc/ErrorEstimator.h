@@ -0,0 +1,70 @@
+#ifndef _ERRORESTIMATOR_H_
+#define _ERRORESTIMATOR_H_
+
+#include <vector>
+#include "FEGrid.h"
+
+using namespace std;
+
+/**
+ * @class ErrorEstimator
+ * @brief Zienkiewicz-Zhu (gradient recovery) error estimator for linear solutions on an FEGrid.
+ *
+ * The gradient of a linear solution is constant per element and jumps across
+ * edges. The recovered gradient G is continuous and linear: at every node it
+ * is the area-weighted average of the gradients of the surrounding elements.
+ * The indicator of element T is eta_T = ||G - grad u_h||_L2(T), an estimate of
+ * the energy-norm (H1 seminorm, unit conductivity) error on T; the global
+ * estimate is sqrt(sum eta_T^2).
+ */
+class ErrorEstimator
+{
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param a_grid The grid; must outlive the estimator.
+   */
+  ErrorEstimator(const FEGrid& a_grid);
+
+  /**
+   * @brief Compute the element indicators of a solution.
+   *
+   * @param a_u Solution at the interior nodes (boundary nodes are zero).
+   * @param a_eta Filled with the indicator of every element.
+   * @return The global estimate.
+   */
+  double estimate(const double* a_u, vector<double>& a_eta);
+
+  /**
+   * @brief Get the recovered gradient at a node (valid after estimate()).
+   *
+   * @param a_node The node number.
+   * @param a_gradient Array to store the gradient.
+   */
+  void recoveredGradient(const int& a_node, double a_gradient[DIM]) const;
+
+  /**
+   * @brief Doerfler (bulk) marking.
+   *
+   * Marks the elements with the largest indicators until their squares add up
+   * to at least a_theta times the total.
+   *
+   * @param a_eta Indicator of every element.
+   * @param a_theta Bulk fraction in (0, 1].
+   * @param a_marked Filled with the marked elements.
+   * @return The number of marked elements.
+   */
+  static int mark(const vector<double>& a_eta, const double& a_theta, vector<int>& a_marked);
+
+private:
+  /**
+   * @brief Gradient of the solution on an element.
+   */
+  void elementGradient(const double* a_u, const int& a_eltNumber, double a_gradient[DIM]) const;
+
+  const FEGrid& m_grid; /**< The grid. */
+  vector<double> m_recovered; /**< DIM components of the recovered gradient per node. */
+};
+
+#endif
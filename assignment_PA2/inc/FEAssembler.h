@@ -0,0 +1,149 @@
+#ifndef _FEASSEMBLER_H_
+#define _FEASSEMBLER_H_
+
+#include <vector>
+#include <string>
+#include "FEGrid.h"
+#include "SparseMatrix.h"
+
+using namespace std;
+
+class ThreadPool;
+
+/**
+ * @class FEAssembler
+ * @brief Assembles the global stiffness (Poisson) matrix of an FEGrid with per-element conductivity.
+ *
+ * The sparsity pattern of the global matrix and the scatter map (element-local
+ * entry to CSR slot) are computed once at construction. Assembly is then a
+ * streaming pass over the cached element matrices. Changing the conductivity
+ * of an element marks it dirty; the next call to assemble() re-integrates only
+ * the dirty elements and applies the difference to the global matrix.
+ */
+class FEAssembler
+{
+public:
+  /**
+   * @brief Constructor building the pattern and scatter map for a grid.
+   *
+   * @param a_grid The grid; must outlive the assembler.
+   * @param a_conductivity Conductivity tensor (row major DIM x DIM) given to every element.
+   */
+  FEAssembler(const FEGrid& a_grid, const double a_conductivity[DIM * DIM]);
+
+  /**
+   * @brief Constructor adopting a matrix assembled elsewhere (see AssemblyPipeline).
+   *
+   * The assembler starts out assembled with no dirty elements.
+   *
+   * @param a_grid The grid; must outlive the assembler.
+   * @param a_conductivity Conductivity tensor (row major DIM x DIM) the matrix was assembled with.
+   * @param a_matrix The assembled matrix; swapped in.
+   * @param a_scatter The scatter map (as m_scatter); swapped in.
+   * @param a_elementMatrices The element stiffness matrices of every element; swapped in.
+   */
+  FEAssembler(const FEGrid& a_grid, const double a_conductivity[DIM * DIM], SparseMatrix& a_matrix,
+              vector<int>& a_scatter, vector<double>& a_elementMatrices);
+
+  /**
+   * @brief Set the conductivity tensor of one element and mark it dirty.
+   *
+   * @param a_eltNumber The element number.
+   * @param a_conductivity Conductivity tensor (row major DIM x DIM).
+   */
+  void setConductivity(const int& a_eltNumber, const double a_conductivity[DIM * DIM]);
+
+  /**
+   * @brief Read element conductivities from a file.
+   *
+   * The file starts with the number of entries, followed by one line per
+   * entry: element number (1-based) and the DIM x DIM tensor in row major order.
+   * Elements not listed keep their current conductivity. The whole file is
+   * checked before any conductivity changes, so a bad file changes nothing.
+   *
+   * @param a_fileName The file name.
+   * @return The number of entries read, -1 if the file could not be opened, or -2 if it
+   * is truncated or malformed or names an element out of range.
+   */
+  int readConductivities(const std::string& a_fileName);
+
+  /**
+   * @brief Bring the global matrix up to date.
+   *
+   * The first call integrates every element and scatters the full matrix.
+   * Later calls re-integrate only the dirty elements.
+   *
+   * @param a_pool Pool that integrates chunks of elements of the first call in parallel, or NULL.
+   * @return The number of elements integrated.
+   */
+  int assemble(ThreadPool* a_pool = NULL);
+
+  /**
+   * @brief Get the assembled global matrix over the interior nodes.
+   *
+   * @return Reference to the matrix.
+   */
+  const SparseMatrix& matrix() const;
+
+  /**
+   * @brief Assemble the consistent mass matrix over the interior nodes.
+   *
+   * Uses the same pattern and scatter map as the stiffness matrix.
+   *
+   * @param a_mass Matrix to fill; its pattern is replaced by the stiffness pattern.
+   */
+  void assembleMass(SparseMatrix& a_mass) const;
+
+  /**
+   * @brief Assemble the lumped (row sum) mass matrix over the interior nodes.
+   *
+   * @param a_mass Vector of size getNumInteriorNodes() to fill with the diagonal.
+   */
+  void assembleLumpedMass(double* a_mass) const;
+
+  /**
+   * @brief Assemble the load vector of a uniform source term.
+   *
+   * @param a_source Source value f.
+   * @param a_load Vector of size getNumInteriorNodes() to fill with the integral of f N_i.
+   */
+  void assembleLoad(const double& a_source, double* a_load) const;
+
+  /**
+   * @brief Get the cached element stiffness matrix of an element.
+   *
+   * @param a_eltNumber The element number.
+   * @return Pointer to VERTICES x VERTICES values (row major).
+   */
+  const double* elementMatrix(const int& a_eltNumber) const;
+
+  /**
+   * @brief Compute the stiffness matrix area * B^T C B of a linear triangle.
+   *
+   * @param a_x Coordinates of the VERTICES vertices.
+   * @param a_conductivity Conductivity tensor (row major DIM x DIM).
+   * @param a_kij Array to store the VERTICES x VERTICES matrix (row major).
+   */
+  static void elementStiffness(const double a_x[VERTICES][DIM], const double a_conductivity[DIM * DIM],
+                               double a_kij[VERTICES * VERTICES]);
+
+private:
+  /**
+   * @brief Compute the element stiffness matrix area * B^T C B.
+   *
+   * @param a_eltNumber The element number.
+   * @param a_kij Array to store the VERTICES x VERTICES matrix (row major).
+   */
+  void integrate(const int& a_eltNumber, double a_kij[VERTICES * VERTICES]) const;
+
+  const FEGrid& m_grid; /**< The grid being assembled. */
+  SparseMatrix m_matrix; /**< The global matrix over interior nodes. */
+  vector<int> m_scatter; /**< CSR slot of each element-local entry, -1 for boundary rows/columns. */
+  vector<double> m_elementMatrices; /**< Cached element stiffness matrices. */
+  vector<double> m_conductivity; /**< Conductivity tensor of each element. */
+  vector<int> m_dirty; /**< Elements whose conductivity changed since the last assemble(). */
+  vector<bool> m_isDirty; /**< Flag per element, true if it is in m_dirty. */
+  bool m_assembled; /**< True once the full matrix has been assembled. */
+};
+
+#endif
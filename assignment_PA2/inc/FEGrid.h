@@ -35,6 +35,31 @@ public:
    */
   FEGrid(const std::string& nodeFile, const std::string& a_elementFileName);
 
+  /**
+   * @brief Constructor adopting nodes and elements built elsewhere (see AssemblyPipeline).
+   *
+   * The interior nodes are numbered in global node order, as by the file constructor.
+   *
+   * @param a_nodes Nodes with their interior flags; swapped in and left empty.
+   * @param a_elements Elements; swapped in and left empty.
+   */
+  FEGrid(vector<Node>& a_nodes, vector<Element>& a_elements);
+
+  /**
+   * @brief Read the grid from node and element files, validating their contents.
+   *
+   * Unlike the file constructor, every count, node ID, cell ID and vertex
+   * reference is checked: the counts must be positive, each node and cell ID
+   * must appear exactly once within its count, every vertex must name an
+   * existing node, and no read may fail. On failure the grid is left unchanged.
+   *
+   * @param a_nodeFileName The node file.
+   * @param a_elementFileName The element file.
+   * @param a_error If not NULL, set to a description of the first problem found.
+   * @return True if both files were read and valid.
+   */
+  bool load(const std::string& a_nodeFileName, const std::string& a_elementFileName, std::string* a_error = NULL);
+
   /**
    * @brief Calculate the gradient at a specific element.
    * 
@@ -98,10 +123,79 @@ public:
    */
   const Node& node(int i) const;
 
+  /**
+   * @brief Uniformly refine the grid in memory.
+   *
+   * Each level splits every triangle into four by connecting its edge midpoints
+   * (red refinement). Element i of the coarse grid becomes elements 4i..4i+3.
+   * A midpoint is a boundary node exactly when its edge belongs to a single
+   * element, and the interior nodes are renumbered afterwards.
+   *
+   * @param a_levels The number of refinement levels.
+   */
+  void refine(const int& a_levels);
+
+  /**
+   * @brief Locally refine marked elements by newest-vertex bisection.
+   *
+   * Each element is split by connecting its newest vertex to the midpoint of the
+   * opposite (refinement) edge; the midpoint becomes the newest vertex of both
+   * children. Neighbours are bisected as well until the grid is conforming
+   * again. On the first call after construction or uniform refinement the
+   * refinement edge of every element is its longest edge.
+   *
+   * Nodes and elements are only appended: existing nodes keep their node and
+   * interior node numbers, new interior nodes are numbered after them, and the
+   * first child of a bisected element takes the parent's number.
+   *
+   * @param a_marked Elements to refine.
+   * @param a_parents If not NULL, filled with the two end nodes of the bisected
+   * edge of every new node (node getNumNodes() before the call comes first).
+   * @return The number of new nodes.
+   */
+  int bisect(const vector<int>& a_marked, vector<int>* a_parents = NULL);
+
+  /**
+   * @brief Write the grid as .node/.elem files readable by the file constructor.
+   *
+   * @param a_nodeFileName The node file to write.
+   * @param a_elementFileName The element file to write.
+   * @return True on success.
+   */
+  bool write(const std::string& a_nodeFileName, const std::string& a_elementFileName) const;
+
+  /**
+   * @brief Check if a position lies on the boundary of the plate [0, 0.6] x [0, 0.4].
+   *
+   * This is the rule used to tag the nodes read from a .node file.
+   *
+   * @param a_x The position.
+   * @return True on the boundary.
+   */
+  static bool isBoundaryPosition(const double a_x[DIM]);
+
 private:
+  /**
+   * @brief Number the interior nodes in global node order.
+   *
+   * These numbers are the rows of the global matrix.
+   */
+  void numberInteriorNodes();
+
+  /**
+   * @brief Perform one level of red refinement.
+   */
+  void refineOnce();
+
+  /**
+   * @brief Rotate the vertices of every element so that its longest edge is the refinement edge.
+   */
+  void labelLongestEdges();
+
   vector<Node> m_nodes; /**< Vector of nodes in the grid. */
   vector<Element> m_elements; /**< Vector of elements in the grid. */
   int m_numInteriorNodes; /**< The number of interior nodes in the grid. */
+  bool m_bisectionLabels; /**< True once vertex 0 of every element is its newest vertex (see bisect()). */
 };
 
 #endif
@@ -0,0 +1,130 @@
+#ifndef _FEHEAT_H_
+#define _FEHEAT_H_
+
+#include <vector>
+#include <string>
+#include <memory>
+#include "FEGrid.h"
+#include "FEAssembler.h"
+#include "SparseMatrix.h"
+#include "PCGSolver.h"
+
+using namespace std;
+
+/**
+ * @class FEHeat
+ * @brief Transient heat conduction M du/dt + K u = F on an FEGrid with zero boundary temperature.
+ *
+ * Time stepping uses the theta method
+ *   (M + theta dt K) u^{n+1} = (M - (1 - theta) dt K) u^n + dt F,
+ * so theta = 0 is forward Euler, 0.5 Crank-Nicolson and 1 backward Euler.
+ * With a lumped mass matrix and theta = 0 the system is diagonal and each step
+ * is a single SpMV. Otherwise the system matrix is assembled and preconditioned
+ * once in the constructor and reused for every step.
+ */
+class FEHeat
+{
+public:
+  /**
+   * @brief Kind of mass matrix.
+   */
+  enum MassType
+  {
+    LUMPED, /**< Diagonal row-sum mass matrix. */
+    CONSISTENT /**< Full Galerkin mass matrix. */
+  };
+
+  /**
+   * @brief Constructor building the system matrix and its preconditioner.
+   *
+   * @param a_grid The grid; must outlive this object.
+   * @param a_assembler Assembler holding the assembled stiffness matrix; must outlive this object.
+   * @param a_dt Time step.
+   * @param a_theta Implicitness, 0 (explicit) to 1 (backward Euler).
+   * @param a_massType Lumped or consistent mass matrix.
+   * @param a_source Uniform heat source f.
+   */
+  FEHeat(const FEGrid& a_grid, const FEAssembler& a_assembler, const double& a_dt,
+         const double& a_theta, const MassType& a_massType, const double& a_source = 0.0);
+
+  /**
+   * @brief Set the temperature at every interior node from a function of position.
+   *
+   * @param a_function Initial temperature u0(x).
+   */
+  void initialize(double (*a_function)(const double a_x[DIM]));
+
+  /**
+   * @brief Advance the solution by one time step.
+   *
+   * @return The number of solver iterations used (0 for the diagonal explicit step).
+   */
+  int step();
+
+  /**
+   * @brief Estimate the largest stable time step of the theta scheme with the mass matrix in use.
+   *
+   * Bounds the largest eigenvalue of M^-1 K from above: Gershgorin with the
+   * lumped mass matrix, times 4 for the consistent one (see FEHeat.cpp).
+   *
+   * @return 2 / ((1 - 2 theta) lambda_max) for theta < 1/2, infinity otherwise (unconditionally stable).
+   */
+  double stableTimeStep() const;
+
+  /**
+   * @brief Write the nodal temperatures to a binary file.
+   *
+   * The file holds the time (double) followed by getNumNodes() doubles, boundary nodes included.
+   *
+   * @param a_fileName The output file.
+   * @return True on success.
+   */
+  bool writeSnapshot(const std::string& a_fileName) const;
+
+  /**
+   * @brief Copy the temperature at every node of the grid (zero on the boundary).
+   *
+   * @param a_u Array of size getNumNodes().
+   */
+  void nodalValues(double* a_u) const;
+
+  /**
+   * @brief Get the temperature at the interior nodes.
+   *
+   * @return Reference to the interior solution vector.
+   */
+  const vector<double>& solution() const;
+
+  /**
+   * @brief Get the current simulation time.
+   *
+   * @return The time.
+   */
+  double getTime() const;
+
+  /**
+   * @brief Get the number of steps taken.
+   *
+   * @return The number of steps.
+   */
+  int getNumSteps() const;
+
+private:
+  const FEGrid& m_grid; /**< The grid. */
+  const SparseMatrix& m_stiffness; /**< Stiffness matrix K. */
+  double m_dt; /**< Time step. */
+  double m_theta; /**< Implicitness of the theta method. */
+  MassType m_massType; /**< Lumped or consistent mass. */
+  SparseMatrix m_mass; /**< Consistent mass matrix (unused when lumped). */
+  vector<double> m_lumpedMass; /**< Lumped mass matrix (diagonal). */
+  vector<double> m_load; /**< dt * F. */
+  SparseMatrix m_system; /**< M + theta dt K. */
+  unique_ptr<PCGSolver> m_solver; /**< Solver for the system matrix, null for the diagonal case. */
+  vector<double> m_u; /**< Interior temperatures. */
+  vector<double> m_rhs; /**< Right hand side work vector. */
+  vector<double> m_ku; /**< K u work vector. */
+  double m_time; /**< Current time. */
+  int m_numSteps; /**< Steps taken. */
+};
+
+#endif
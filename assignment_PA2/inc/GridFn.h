@@ -6,10 +6,23 @@
 
 class GridFn {
 public:
+    // Time integrators of solve(): forward Euler, backward Euler and Crank-Nicolson
+    enum Integrator { EXPLICIT, IMPLICIT, CRANK_NICOLSON };
+
     GridFn(int m, int n);  // Constructor to initialize grid size
+    GridFn(double l, double dx, double dt, double alpha = 1.0);  // Rod [0, l] with points at both ends
     void initialize();  // Function to initialize grid values
     void solve();  // Function to solve the 1D heat diffusion equation
     void printGrid();  // Print the current grid for debugging
+    void setVerbose(bool v);  // Enable/disable the per-point printing in initialize() and solve()
+    void setIntegrator(Integrator integrator);  // Select the time integrator used by solve()
+
+    int size() const { return m; }  // Number of grid points
+    double value(int i) const { return gridValues[i][0]; }  // Temperature at point i
+    double position(int i) const { return i * dx; }  // x-coordinate of point i
+    double getTime() const { return time; }  // Time reached by the solve() calls so far
+    double getLength() const { return l; }
+    double getAlpha() const { return alpha; }
 
 private:
     int m, n;  // Grid dimensions
@@ -18,7 +31,10 @@ private:
     double dx = 0.4;  // Space step
     double dt = 0.1;  // Time step
     double l = 1.2;  // Length of the rod
+    double time = 0.0;  // Current time
+    bool verbose = true;  // Print every point in initialize() and solve()
+    Integrator integrator = EXPLICIT;  // Time integrator
+    std::vector<double> previous, diag, rhs;  // Work arrays of the time step
 };
 
 #endif
-
@@ -0,0 +1,172 @@
+#ifndef _MATRIXCACHE_H_
+#define _MATRIXCACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "SparseMatrix.h"
+#include "PCGSolver.h"
+
+using namespace std;
+
+/**
+ * @class MatrixCache
+ * @brief Content-addressed on-disk cache of an assembled system, memory-mapped on load.
+ *
+ * A cache file holds the stiffness matrix (CSR), the load vector and
+ * optionally the preconditioner of PCGSolver, each as a 64-byte aligned array
+ * behind a fixed header. The file name is the key, a
+ * hash of the mesh and material file contents and the assembly parameters, so a
+ * changed input simply misses. On a hit the file is mapped copy-on-write and
+ * the matrix and preconditioner are views into the mapping: nothing is parsed,
+ * assembled or copied. A file is only used after the header (magic, version,
+ * key, sizes, offsets, checksum), a checksum of the whole payload and the row
+ * pointers have been validated. Files are written to a temporary name and
+ * renamed, so readers never see a partial file.
+ */
+class MatrixCache
+{
+public:
+  /**
+   * @brief Constructor of an empty (unmapped) cache entry.
+   */
+  MatrixCache();
+
+  /**
+   * @brief Destructor unmapping the file.
+   */
+  ~MatrixCache();
+
+  /**
+   * @brief Hash the contents of input files together with numeric parameters.
+   *
+   * @param a_files Files whose contents determine the system (mesh, materials).
+   * @param a_parameters Parameters of the assembly (conductivity, refinement levels, ...).
+   * @param a_key Resulting key.
+   * @return False if a file could not be read.
+   */
+  static bool computeKey(const vector<std::string>& a_files, const vector<double>& a_parameters, uint64_t& a_key);
+
+  /**
+   * @brief Name of the cache file of a key.
+   *
+   * @param a_directory Cache directory.
+   * @param a_key The key.
+   * @return a_directory/<16 hex digits>.femc
+   */
+  static std::string fileName(const std::string& a_directory, const uint64_t& a_key);
+
+  /**
+   * @brief Map and validate a cache file.
+   *
+   * @param a_fileName The cache file.
+   * @param a_key Key the file must have been written with.
+   * @return False on a miss: missing, truncated, corrupt or stale file.
+   */
+  bool open(const std::string& a_fileName, const uint64_t& a_key);
+
+  /**
+   * @brief Write a cache file.
+   *
+   * @param a_fileName The cache file.
+   * @param a_key The key.
+   * @param a_matrix The assembled matrix.
+   * @param a_load The load vector.
+   * @param a_solver Solver whose preconditioner is stored, or NULL.
+   * @return False if the file could not be written.
+   */
+  static bool write(const std::string& a_fileName, const uint64_t& a_key, const SparseMatrix& a_matrix,
+                    const double* a_load, const PCGSolver* a_solver);
+
+  /**
+   * @brief The mapped matrix (valid after a successful open()).
+   *
+   * @return A view into the mapping.
+   */
+  const SparseMatrix& matrix() const;
+
+  /**
+   * @brief The mapped load vector.
+   *
+   * @return numRows() values.
+   */
+  const double* load() const;
+
+  /**
+   * @brief Check whether the file holds a preconditioner.
+   *
+   * @return True if makeSolver() does not need to factor.
+   */
+  bool hasPreconditioner() const;
+
+  /**
+   * @brief Create a solver for the mapped matrix.
+   *
+   * @return A solver using the mapped preconditioner, or building IC(0) if none was stored.
+   * The caller owns the solver; it must not outlive this object.
+   */
+  PCGSolver* makeSolver() const;
+
+  /**
+   * @brief Get the size of the mapping.
+   *
+   * @return The size in bytes.
+   */
+  size_t mappedBytes() const;
+
+private:
+  MatrixCache(const MatrixCache&);
+  MatrixCache& operator=(const MatrixCache&);
+
+  /**
+   * @brief Arrays of a cache file, in file order.
+   */
+  enum Array
+  {
+    ROW_PTR, COL_IND, VALUES, LOAD, L_ROW_PTR, L_COL_IND, L_VALUES, INV_DIAG, NUM_ARRAYS
+  };
+
+  /**
+   * @brief Fixed header at the start of a cache file.
+   */
+  struct Header
+  {
+    uint64_t magic; /**< s_magic. */
+    uint32_t version; /**< s_version. */
+    uint32_t headerBytes; /**< sizeof(Header). */
+    uint64_t key; /**< Key of the inputs. */
+    uint64_t fileBytes; /**< Size of the file. */
+    int32_t numRows; /**< Number of rows (interior nodes). */
+    int32_t nnz; /**< Entries of the matrix. */
+    int32_t preconditioner; /**< PCGSolver::Preconditioner, or -1 if none is stored. */
+    int32_t factorNnz; /**< Entries of the strictly lower factor. */
+    int32_t reserved[2]; /**< Zero. */
+    uint64_t offsets[NUM_ARRAYS]; /**< Byte offset of every array (0 if absent). */
+    uint64_t payloadChecksum; /**< Checksum of everything after the header. */
+    uint64_t headerChecksum; /**< Checksum of the header up to this field. */
+  };
+
+  /**
+   * @brief Typed pointer to an array of the mapping.
+   */
+  template <class T>
+  T* array(const Array& a_array) const
+  {
+    return reinterpret_cast<T*>(static_cast<char*>(m_mapping) + m_header->offsets[a_array]);
+  }
+
+  /**
+   * @brief Unmap the current file.
+   */
+  void close();
+
+  static const uint64_t s_magic = 0x45484341434d4546ULL; /**< "FEMCACHE" */
+  static const uint32_t s_version = 2; /**< File format version. */
+
+  void* m_mapping; /**< Start of the mapping, NULL if closed. */
+  size_t m_bytes; /**< Size of the mapping. */
+  const Header* m_header; /**< Header inside the mapping. */
+  SparseMatrix m_matrix; /**< View of the mapped matrix. */
+};
+
+#endif
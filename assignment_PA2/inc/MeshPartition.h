@@ -0,0 +1,158 @@
+#ifndef _MESHPARTITION_H_
+#define _MESHPARTITION_H_
+
+#include <ostream>
+#include <vector>
+#include "FEGrid.h"
+
+using namespace std;
+
+/**
+ * @class MeshPartition
+ * @brief Splits the elements and interior nodes of an FEGrid into partitions by coordinates.
+ *
+ * Elements are split by their centroids, either by recursive coordinate
+ * bisection (each cut at the weighted median across the longer extent) or by
+ * cutting the Morton (Z-order) curve into equal pieces. Each interior node is
+ * owned by the lowest partition among its elements, and the rows of the
+ * global matrix are renumbered so that every partition owns a contiguous
+ * range. A row touched by the elements of partitions other than its owner is
+ * an interface row; for each partition the interface rows it contributes to
+ * and the neighbours owning them are listed.
+ */
+class MeshPartition
+{
+public:
+  /**
+   * @brief How elements are split.
+   */
+  enum Method
+  {
+    RCB, /**< Recursive coordinate bisection. */
+    MORTON /**< Equal pieces of the Morton order. */
+  };
+
+  /**
+   * @brief Constructor partitioning a grid.
+   *
+   * @param a_grid The grid; must outlive the partition.
+   * @param a_numParts Number of partitions.
+   * @param a_method Partitioning method.
+   */
+  MeshPartition(const FEGrid& a_grid, const int& a_numParts, const Method& a_method = RCB);
+
+  /**
+   * @brief Get the number of partitions.
+   *
+   * @return The number of partitions.
+   */
+  int numParts() const;
+
+  /**
+   * @brief Get the grid.
+   *
+   * @return The partitioned grid.
+   */
+  const FEGrid& grid() const;
+
+  /**
+   * @brief Elements of a partition, in increasing order.
+   *
+   * @param a_part The partition.
+   * @return The element numbers.
+   */
+  const vector<int>& elements(const int& a_part) const;
+
+  /**
+   * @brief First row owned by a partition (partition numbering).
+   *
+   * @param a_part The partition.
+   * @return The first row; the rows up to rowBegin(a_part + 1) are owned.
+   */
+  int rowBegin(const int& a_part) const;
+
+  /**
+   * @brief Partition of a row.
+   *
+   * @param a_row Row in partition numbering.
+   * @return The owning partition.
+   */
+  int owner(const int& a_row) const;
+
+  /**
+   * @brief Partition numbering of the interior nodes.
+   *
+   * @return The row of every interior node ID.
+   */
+  const vector<int>& rowOf() const;
+
+  /**
+   * @brief Interior node ID of every row, the inverse of rowOf().
+   *
+   * @return The interior node ID of every row.
+   */
+  const vector<int>& interiorNodeOf() const;
+
+  /**
+   * @brief Rows of other partitions that the elements of a partition contribute to.
+   *
+   * @param a_part The partition.
+   * @return The rows in increasing order.
+   */
+  const vector<int>& interfaceRows(const int& a_part) const;
+
+  /**
+   * @brief Partitions owning the interface rows of a partition.
+   *
+   * @param a_part The partition.
+   * @return The neighbours in increasing order.
+   */
+  const vector<int>& neighbors(const int& a_part) const;
+
+  /**
+   * @brief Elements adjacent to each interior node (CSR, by interior node ID).
+   *
+   * @param a_offsets Filled with numInteriorNodes + 1 offsets.
+   * @param a_elements Filled with the element numbers.
+   */
+  void nodeElements(vector<int>& a_offsets, vector<int>& a_elements) const;
+
+  /**
+   * @brief Print sizes, balance and interface size of the partitions.
+   *
+   * @param a_os Output stream.
+   */
+  void printStatistics(ostream& a_os) const;
+
+private:
+  /**
+   * @brief Recursive coordinate bisection of a range of elements.
+   *
+   * @param a_order Element numbers; the range is reordered so that each partition is contiguous.
+   * @param a_begin First position of the range.
+   * @param a_end One past the last position.
+   * @param a_firstPart First partition of the range.
+   * @param a_numParts Number of partitions of the range.
+   */
+  void bisect(vector<int>& a_order, const int& a_begin, const int& a_end, const int& a_firstPart,
+              const int& a_numParts);
+
+  /**
+   * @brief Number the rows and build the interface lists from the element partitions.
+   */
+  void buildRows();
+
+  const FEGrid& m_grid; /**< The grid. */
+  int m_numParts; /**< Number of partitions. */
+  Method m_method; /**< Partitioning method. */
+  vector<double> m_centroids; /**< DIM coordinates per element. */
+  vector<int> m_partOfElement; /**< Partition of every element. */
+  vector<vector<int> > m_elements; /**< Elements of every partition. */
+  vector<int> m_rowBegin; /**< First row of every partition, and the number of rows. */
+  vector<int> m_rowOf; /**< Row of every interior node ID. */
+  vector<int> m_interiorNodeOf; /**< Interior node ID of every row. */
+  vector<vector<int> > m_interfaceRows; /**< Foreign rows each partition contributes to. */
+  vector<vector<int> > m_neighbors; /**< Owners of those rows. */
+};
+
+#endif
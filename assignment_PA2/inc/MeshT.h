@@ -0,0 +1,217 @@
+#ifndef _MESHT_H_
+#define _MESHT_H_
+
+#include <algorithm>
+#include <vector>
+#include "ElementT.h"
+#include "FEGrid.h"
+#include "SparseMatrix.h"
+#include "Profiler.h"
+
+using namespace std;
+
+/**
+ * @brief Mesh of ElementT elements: coordinates, connectivity and interior numbering.
+ *
+ * Boundary nodes carry homogeneous Dirichlet values and have no row, as in FEGrid.
+ */
+template <class E>
+struct MeshT
+{
+  vector<double> coordinates; /**< E::dim coordinates per node. */
+  vector<int> connectivity; /**< E::numNodes node numbers per element. */
+  vector<int> interiorID; /**< Row of every node, -1 for boundary nodes. */
+  int numInteriorNodes = 0; /**< Number of rows. */
+
+  /**
+   * @brief Get the number of nodes.
+   *
+   * @return The number of nodes.
+   */
+  int getNumNodes() const { return coordinates.size() / E::dim; }
+
+  /**
+   * @brief Get the number of elements.
+   *
+   * @return The number of elements.
+   */
+  int getNumElts() const { return connectivity.size() / E::numNodes; }
+
+  /**
+   * @brief Gather the node coordinates of an element.
+   *
+   * @param a_eltNumber The element number.
+   * @param a_x Array to store the coordinates.
+   */
+  void gather(const int& a_eltNumber, double a_x[E::numNodes][E::dim]) const
+  {
+    const int* nodes = &connectivity[a_eltNumber * E::numNodes];
+    unroll<E::numNodes>([&](auto m) {
+      unroll<E::dim>([&](auto r) { a_x[m][r] = coordinates[nodes[m] * E::dim + r]; });
+    });
+  }
+};
+
+/**
+ * @class AssemblerT
+ * @brief Assembles the global stiffness matrix of a MeshT, instantiated per element type.
+ *
+ * Same scheme as FEAssembler: the pattern and the scatter map are built once,
+ * assembly integrates every element with ElementKernel<E> and scatters it. The
+ * element loop has no dimension or order branches; it is compiled separately
+ * for every element type.
+ */
+template <class E>
+class AssemblerT
+{
+public:
+  static constexpr int dim = E::dim; /**< Spatial dimension. */
+  static constexpr int numNodes = E::numNodes; /**< Nodes per element. */
+
+  /**
+   * @brief Constructor building the pattern and scatter map for a mesh.
+   *
+   * @param a_mesh The mesh; must outlive the assembler.
+   * @param a_conductivity Conductivity tensor (row major dim x dim) of every element.
+   */
+  AssemblerT(const MeshT<E>& a_mesh, const double a_conductivity[dim * dim]) : m_mesh(a_mesh)
+  {
+    PROFILE_SCOPE("templated_symbolic");
+    copy(a_conductivity, a_conductivity + dim * dim, m_conductivity);
+    int numElts = m_mesh.getNumElts();
+    vector<vector<int> > columns(m_mesh.numInteriorNodes);
+    for (int e = 0; e < numElts; e++)
+    {
+      const int* nodes = &m_mesh.connectivity[e * numNodes];
+      for (int m = 0; m < numNodes; m++)
+      {
+        int row = m_mesh.interiorID[nodes[m]];
+        if (row < 0)
+          continue;
+        for (int n = 0; n < numNodes; n++)
+        {
+          int col = m_mesh.interiorID[nodes[n]];
+          if (col >= 0)
+            columns[row].push_back(col);
+        }
+      }
+    }
+    vector<int> rowPtr(1, 0), colInd;
+    for (size_t row = 0; row < columns.size(); row++)
+    {
+      sort(columns[row].begin(), columns[row].end());
+      columns[row].erase(unique(columns[row].begin(), columns[row].end()), columns[row].end());
+      colInd.insert(colInd.end(), columns[row].begin(), columns[row].end());
+      rowPtr.push_back(colInd.size());
+    }
+    m_matrix = SparseMatrix(rowPtr, colInd);
+
+    m_scatter.resize(numElts * numNodes * numNodes);
+    for (int e = 0; e < numElts; e++)
+    {
+      const int* nodes = &m_mesh.connectivity[e * numNodes];
+      for (int m = 0; m < numNodes; m++)
+      {
+        for (int n = 0; n < numNodes; n++)
+        {
+          int row = m_mesh.interiorID[nodes[m]];
+          int col = m_mesh.interiorID[nodes[n]];
+          m_scatter[(e * numNodes + m) * numNodes + n] = (row < 0 || col < 0) ? -1 : m_matrix.find(row, col);
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Integrate every element and scatter into the global matrix.
+   */
+  void assemble()
+  {
+    PROFILE_SCOPE("templated_assembly");
+    m_matrix.zero();
+    double* values = m_matrix.values();
+    int numElts = m_mesh.getNumElts();
+    for (int e = 0; e < numElts; e++)
+    {
+      double x[numNodes][dim], kij[numNodes * numNodes];
+      m_mesh.gather(e, x);
+      ElementKernel<E>::stiffness(x, m_conductivity, kij);
+      const int* scatter = &m_scatter[e * numNodes * numNodes];
+      unroll<numNodes * numNodes>([&](auto k) {
+        if (scatter[k] >= 0)
+          values[scatter[k]] += kij[k];
+      });
+    }
+    PROFILE_COUNT("elements_integrated", numElts);
+  }
+
+  /**
+   * @brief Assemble the load vector of a source.
+   *
+   * @param a_source Source f, called with a point of dim coordinates.
+   * @param a_load Array of numRows values to fill.
+   */
+  template <class Source>
+  void assembleLoad(const Source& a_source, double* a_load) const
+  {
+    fill(a_load, a_load + m_mesh.numInteriorNodes, 0.0);
+    for (int e = 0; e < m_mesh.getNumElts(); e++)
+    {
+      double x[numNodes][dim], f[numNodes];
+      m_mesh.gather(e, x);
+      ElementKernel<E>::load(x, a_source, f);
+      const int* nodes = &m_mesh.connectivity[e * numNodes];
+      for (int m = 0; m < numNodes; m++)
+      {
+        int row = m_mesh.interiorID[nodes[m]];
+        if (row >= 0)
+          a_load[row] += f[m];
+      }
+    }
+  }
+
+  /**
+   * @brief Get the assembled matrix.
+   *
+   * @return The global stiffness matrix (rows in MeshT::interiorID numbering).
+   */
+  const SparseMatrix& matrix() const { return m_matrix; }
+
+private:
+  AssemblerT(const AssemblerT&);
+  AssemblerT& operator=(const AssemblerT&);
+
+  const MeshT<E>& m_mesh; /**< The mesh. */
+  double m_conductivity[dim * dim]; /**< Conductivity tensor. */
+  SparseMatrix m_matrix; /**< Global stiffness matrix. */
+  vector<int> m_scatter; /**< CSR slot of every element-local entry, -1 for boundary rows/columns. */
+};
+
+/**
+ * @brief Build the linear triangle mesh of an FEGrid, keeping its interior numbering.
+ *
+ * @param a_grid The grid.
+ * @param a_mesh The mesh to fill.
+ */
+void buildMesh(const FEGrid& a_grid, MeshT<ElementT<Triangle, 1> >& a_mesh);
+
+/**
+ * @brief Build the quadratic triangle mesh of an FEGrid by adding the edge midpoints.
+ *
+ * Vertices keep their interior numbering; interior midpoints are numbered after
+ * them. A midpoint is a boundary node if FEGrid::isBoundaryPosition() says so.
+ *
+ * @param a_grid The grid.
+ * @param a_mesh The mesh to fill.
+ */
+void buildMesh(const FEGrid& a_grid, MeshT<ElementT<Triangle, 2> >& a_mesh);
+
+/**
+ * @brief Build a structured mesh of the unit cube, six tetrahedra per cell.
+ *
+ * @param a_cells Number of cells per direction.
+ * @param a_mesh The mesh to fill; nodes on the faces of the cube are boundary nodes.
+ */
+void buildCube(const int& a_cells, MeshT<ElementT<Tetrahedron, 1> >& a_mesh);
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef _MIXEDPCGSOLVER_H_
+#define _MIXEDPCGSOLVER_H_
+
+#include <vector>
+#include "SparseMatrix.h"
+#include "PCGSolver.h"
+
+using namespace std;
+
+/**
+ * @class MixedPCGSolver
+ * @brief Mixed precision solver: single precision PCG inside double precision iterative refinement.
+ *
+ * The matrix values are copied to float once (the CSR pattern is shared with the
+ * double matrix), halving the bytes streamed per SpMV in the inner iterations.
+ * Each outer step computes the residual r = b - A x with the double matrix,
+ * solves A d = r approximately in float and updates x += d in double, so the
+ * final accuracy is that of the double residual, not of the float storage.
+ */
+class MixedPCGSolver
+{
+public:
+  /**
+   * @brief Constructor converting the matrix and building the preconditioner.
+   *
+   * @param a_matrix The SPD matrix; must outlive the solver and keep its values.
+   * @param a_preconditioner JACOBI or IC0 (see PCGSolver).
+   * @param a_floatPreconditioner Store the preconditioner in float (true) or double (false).
+   */
+  MixedPCGSolver(const SparseMatrix& a_matrix, const PCGSolver::Preconditioner& a_preconditioner = PCGSolver::IC0,
+                 const bool& a_floatPreconditioner = true);
+
+  /**
+   * @brief Solve A x = b to double precision accuracy.
+   *
+   * @param a_b Right hand side.
+   * @param a_x On input the initial guess, on output the solution.
+   * @param a_tolerance Relative residual ||b - A x|| / ||b|| to reach, computed in double.
+   * @param a_innerTolerance Relative residual reduction of each single precision solve.
+   * @param a_maxOuter Maximum number of refinement steps.
+   * @return The number of refinement steps performed.
+   */
+  int solve(const double* a_b, double* a_x, const double& a_tolerance = 1e-10,
+            const double& a_innerTolerance = 1e-5, const int& a_maxOuter = 50);
+
+  /**
+   * @brief Get the relative residual (in double) reached by the last solve().
+   *
+   * @return The relative residual.
+   */
+  double getResidual() const;
+
+  /**
+   * @brief Get the total number of single precision iterations of the last solve().
+   *
+   * @return The number of inner iterations.
+   */
+  int getInnerIterations() const;
+
+private:
+  /**
+   * @brief Compute a_y = A * a_x with the float matrix.
+   */
+  void multiply(const float* a_x, float* a_y) const;
+
+  /**
+   * @brief Apply the preconditioner in single precision.
+   */
+  void precondition(const float* a_r, float* a_z) const;
+
+  /**
+   * @brief Single precision PCG for A d = r, starting from d = 0.
+   *
+   * @return The number of iterations.
+   */
+  int innerSolve(const float* a_r, float* a_d, const double& a_tolerance, const int& a_maxIterations);
+
+  const SparseMatrix& m_matrix; /**< The double precision matrix (pattern and residuals). */
+  vector<float> m_values; /**< Matrix values in float. */
+  PCGSolver::Preconditioner m_preconditioner; /**< Preconditioner in use. */
+  bool m_floatPreconditioner; /**< True if the preconditioner is stored in float. */
+  vector<int> m_lRowPtr; /**< Row pointers of the strictly lower part of the IC(0) factor. */
+  vector<int> m_lColInd; /**< Column indices of the strictly lower part of the IC(0) factor. */
+  vector<float> m_lValuesF; /**< Factor values in float. */
+  vector<double> m_lValuesD; /**< Factor values in double. */
+  vector<float> m_invDiagF; /**< Inverse diagonal in float. */
+  vector<double> m_invDiagD; /**< Inverse diagonal in double. */
+  vector<double> m_rd; /**< Double residual. */
+  vector<float> m_r, m_d, m_z, m_p, m_q; /**< Single precision work vectors. */
+  double m_residual; /**< Relative residual of the last solve. */
+  int m_innerIterations; /**< Inner iterations of the last solve. */
+};
+
+#endif
@@ -25,7 +25,7 @@ public:
    * @brief Constructor with position and ID for the node.
    * 
    * @param a_position Array representing the position of the node in 2D.
-   * @param a_interiorNodeID The ID of the interior node.
+   * @param a_interiorNodeID The row of the node in the global matrix, or -1 for boundary nodes.
    * @param a_isInterior A boolean indicating if the node is interior.
    */
   Node(double a_position[DIM], const int& a_interiorNodeID, const bool& a_isInterior);
@@ -40,7 +40,7 @@ public:
   /**
    * @brief Get the interior node ID.
    * 
-   * @return The interior node ID.
+   * @return The interior node ID (row in the global matrix), or -1 for boundary nodes.
    */
   const int& getInteriorNodeID() const;
 
@@ -54,7 +54,7 @@ public:
 private:
   double m_position[DIM]; /**< Position of the node in 2D space. */
   bool m_isInterior; /**< Flag indicating if the node is an interior node. */
-  int m_interiorNodeID; /**< ID of the interior node. */
+  int m_interiorNodeID; /**< Interior numbering of the node, -1 on the boundary. */
 };
 
 #endif
@@ -0,0 +1,128 @@
+#ifndef _PCGSOLVER_H_
+#define _PCGSOLVER_H_
+
+#include <vector>
+#include "SparseMatrix.h"
+
+using namespace std;
+
+/**
+ * @class PCGSolver
+ * @brief Preconditioned conjugate gradient solver for symmetric positive definite CSR matrices.
+ *
+ * The preconditioner (Jacobi or incomplete Cholesky IC(0)) is built once in the
+ * constructor and reused by every call to solve(), so a fixed system matrix can be
+ * solved for many right hand sides (e.g. once per time step) at the cost of the
+ * iterations only.
+ */
+class PCGSolver
+{
+public:
+  /**
+   * @brief Kind of preconditioner.
+   */
+  enum Preconditioner
+  {
+    JACOBI, /**< Inverse of the diagonal. */
+    IC0 /**< Incomplete Cholesky factorization with the pattern of the lower triangle. */
+  };
+
+  /**
+   * @brief Constructor building the preconditioner.
+   *
+   * @param a_matrix The SPD matrix; must outlive the solver and keep its values.
+   * @param a_preconditioner The preconditioner to build. IC(0) falls back to Jacobi on breakdown.
+   */
+  PCGSolver(const SparseMatrix& a_matrix, const Preconditioner& a_preconditioner = IC0);
+
+  /**
+   * @brief Constructor using a precomputed preconditioner without copying it.
+   *
+   * @param a_matrix The SPD matrix; must outlive the solver and keep its values.
+   * @param a_preconditioner The kind of a_invDiag and the factor arrays (see getFactor()).
+   * @param a_lRowPtr Row pointers of the strictly lower part of L (NULL for JACOBI).
+   * @param a_lColInd Column indices of the strictly lower part of L (NULL for JACOBI).
+   * @param a_lValues Values of the strictly lower part of L (NULL for JACOBI).
+   * @param a_invDiag Inverse diagonal.
+   * The arrays must outlive the solver (e.g. a memory-mapped MatrixCache file).
+   */
+  PCGSolver(const SparseMatrix& a_matrix, const Preconditioner& a_preconditioner, const int* a_lRowPtr,
+            const int* a_lColInd, const double* a_lValues, const double* a_invDiag);
+
+  /**
+   * @brief Solve A x = b.
+   *
+   * @param a_b Right hand side.
+   * @param a_x On input the initial guess, on output the solution.
+   * @param a_tolerance Relative residual ||b - A x|| / ||b|| to reach.
+   * @param a_maxIterations Maximum number of iterations.
+   * @return The number of iterations performed.
+   */
+  int solve(const double* a_b, double* a_x, const double& a_tolerance = 1e-10, const int& a_maxIterations = 10000);
+
+  /**
+   * @brief Apply the preconditioner, a_z = M^-1 a_r.
+   *
+   * @param a_r Input vector.
+   * @param a_z Output vector.
+   */
+  void precondition(const double* a_r, double* a_z) const;
+
+  /**
+   * @brief Copy the preconditioner data.
+   *
+   * For JACOBI only a_invDiag is filled and the factor arrays are left empty.
+   * For IC0, L = D + strictly lower part, with a_invDiag = 1 / diag(L).
+   *
+   * @param a_rowPtr Row pointers of the strictly lower part of L.
+   * @param a_colInd Column indices of the strictly lower part of L.
+   * @param a_values Values of the strictly lower part of L.
+   * @param a_invDiag Inverse diagonal.
+   */
+  void getFactor(vector<int>& a_rowPtr, vector<int>& a_colInd, vector<double>& a_values, vector<double>& a_invDiag) const;
+
+  /**
+   * @brief Get the relative residual reached by the last solve().
+   *
+   * @return The relative residual.
+   */
+  double getResidual() const;
+
+  /**
+   * @brief Get the preconditioner actually in use.
+   *
+   * @return JACOBI or IC0.
+   */
+  Preconditioner getPreconditioner() const;
+
+private:
+  /**
+   * @brief Compute the IC(0) factor of the matrix.
+   *
+   * @return False if a non-positive pivot was met.
+   */
+  bool factorIC0();
+
+  /**
+   * @brief Point the preconditioner pointers at the owned vectors.
+   */
+  void bind();
+
+  PCGSolver(const PCGSolver&);
+  PCGSolver& operator=(const PCGSolver&);
+
+  const SparseMatrix& m_matrix; /**< The system matrix. */
+  Preconditioner m_preconditioner; /**< Preconditioner in use. */
+  vector<double> m_invDiag; /**< Inverse diagonal (Jacobi) or inverse diagonal of L (IC0). */
+  vector<int> m_lRowPtr; /**< Row pointers of the strictly lower part of L. */
+  vector<int> m_lColInd; /**< Column indices of the strictly lower part of L. */
+  vector<double> m_lValues; /**< Values of the strictly lower part of L. */
+  const double* m_invDiagData; /**< Inverse diagonal in use (owned or external). */
+  const int* m_lRowPtrData; /**< Factor row pointers in use. */
+  const int* m_lColIndData; /**< Factor column indices in use. */
+  const double* m_lValuesData; /**< Factor values in use. */
+  vector<double> m_r, m_z, m_p, m_q; /**< Work vectors. */
+  double m_residual; /**< Relative residual of the last solve. */
+};
+
+#endif
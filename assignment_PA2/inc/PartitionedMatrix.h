@@ -0,0 +1,131 @@
+#ifndef _PARTITIONEDMATRIX_H_
+#define _PARTITIONEDMATRIX_H_
+
+#include <memory>
+#include <vector>
+#include "MeshPartition.h"
+#include "SparseMatrix.h"
+
+using namespace std;
+
+/**
+ * @class PartitionedMatrix
+ * @brief Stiffness matrix stored, assembled and multiplied per MeshPartition.
+ *
+ * Every partition keeps the CSR rows it owns (partition numbering) and its own
+ * element list, vertex coordinates, scatter map and send buffer. All of it is
+ * allocated and first written by the thread that later works on the partition,
+ * so with OpenMP ("make OPENMP=1", OMP_PROC_BIND=close or spread and one
+ * partition per thread) the pages of a partition live on the NUMA node of its
+ * thread. Partition p is always handled by thread p mod OMP_NUM_THREADS
+ * (static schedule).
+ *
+ * Assembly reads the partition's own copy of its element coordinates, never the
+ * shared FEGrid, and integrates the elements into its own rows and, for the
+ * interface rows of other partitions, into its send buffer; the owners then
+ * add the send buffer entries of their neighbours. A multiply reads the
+ * vector entries of neighbouring partitions only through the interface columns.
+ * Vectors are in partition numbering (see MeshPartition::rowOf()).
+ */
+class PartitionedMatrix
+{
+public:
+  /**
+   * @brief Constructor building the per-partition patterns, scatter maps and exchange lists.
+   *
+   * @param a_partition The partition; must outlive the matrix.
+   * @param a_conductivity Conductivity tensor (row major DIM x DIM) of every element.
+   */
+  PartitionedMatrix(const MeshPartition& a_partition, const double a_conductivity[DIM * DIM]);
+
+  /**
+   * @brief Integrate all elements partition-locally and exchange the interface contributions.
+   */
+  void assemble();
+
+  /**
+   * @brief Compute a_y = A * a_x, each partition computing its own rows.
+   *
+   * @param a_x Input vector in partition numbering.
+   * @param a_y Output vector in partition numbering.
+   */
+  void multiply(const double* a_x, double* a_y) const;
+
+  /**
+   * @brief Zero a vector, each partition touching its own rows first.
+   *
+   * @param a_v Vector of numRows() values, freshly allocated and not yet written.
+   */
+  void firstTouch(double* a_v) const;
+
+  /**
+   * @brief Get the number of rows.
+   *
+   * @return The number of interior nodes.
+   */
+  int numRows() const;
+
+  /**
+   * @brief Get the number of stored entries over all partitions.
+   *
+   * @return The number of non-zeros.
+   */
+  int nnz() const;
+
+  /**
+   * @brief Get the number of entries exchanged by an assembly.
+   *
+   * @return The number of send buffer entries over all partitions.
+   */
+  int getNumExchanged() const;
+
+  /**
+   * @brief Largest difference to a matrix in interior node numbering.
+   *
+   * @param a_matrix The reference (e.g. FEAssembler::matrix()).
+   * @return The largest absolute difference of an entry, or -1 if the patterns differ.
+   */
+  double maxDifference(const SparseMatrix& a_matrix) const;
+
+private:
+  PartitionedMatrix(const PartitionedMatrix&);
+  PartitionedMatrix& operator=(const PartitionedMatrix&);
+
+  /**
+   * @brief Rows, elements and exchange lists of one partition.
+   */
+  struct Part
+  {
+    int rowBegin; /**< First owned row. */
+    int numRows; /**< Number of owned rows. */
+    vector<int> rowPtr; /**< Owned rows, local row index. */
+    vector<int> colInd; /**< Columns in partition numbering. */
+    vector<double> values; /**< Values. */
+    vector<int> elements; /**< Elements of the partition. */
+    vector<double> coordinates; /**< VERTICES x DIM vertex coordinates per element. */
+    vector<int> slots; /**< Per element-local entry: own slot, -1 for boundary, -2 - i for send entry i. */
+    vector<int> sendRows; /**< Row of each send entry. */
+    vector<int> sendCols; /**< Column of each send entry. */
+    vector<double> send; /**< Contributions to rows of other partitions. */
+    vector<int> recvPart; /**< For each received entry: the sending partition. */
+    vector<int> recvIndex; /**< Its index in the sender's send buffer. */
+    vector<int> recvSlot; /**< Its slot in the own values. */
+  };
+
+  /**
+   * @brief Build the rows, scatter map and send list of a partition.
+   */
+  void buildPart(const int& a_part, const vector<int>& a_nodeOffsets, const vector<int>& a_nodeElements);
+
+  /**
+   * @brief Build the receive list of a partition from its neighbours' send lists.
+   */
+  void buildReceives(const int& a_part);
+
+  const MeshPartition& m_partition; /**< The partition. */
+  const FEGrid& m_grid; /**< The grid. */
+  double m_conductivity[DIM * DIM]; /**< Conductivity tensor. */
+  vector<unique_ptr<Part> > m_parts; /**< Per-partition data, allocated by the owning thread. */
+};
+
+#endif
@@ -0,0 +1,255 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <mutex>
+
+using namespace std;
+
+/**
+ * @class Profiler
+ * @brief Process-wide phase timers, event counters and peak memory of the executables.
+ *
+ * Phases are timed by ScopedTimer objects created with PROFILE_SCOPE(name) and
+ * counters are bumped with PROFILE_COUNT(name, amount). Both macros register their
+ * name once (function-local static) and afterwards cost an index lookup, so they
+ * belong at phase granularity, never inside per-element or per-time-step loops:
+ * time a stepping loop once in its caller and count the steps instead.
+ *
+ * Reporting is chosen at run time through the environment:
+ * - FEM_PROFILE=1 prints a summary table (calls, total/mean/max time, share of the
+ *   run, counters, and for outermost phases the peak RSS and its growth during
+ *   the phase) to stderr at exit;
+ * - FEM_TRACE=<file> writes a Chrome trace (chrome://tracing, Perfetto) with one
+ *   complete event per timed scope and the final counter values.
+ * With neither set the timers and counters only test a flag. Building with -DFEM_NO_PROFILE
+ * ("make NOPROFILE=1") removes the instrumentation entirely.
+ *
+ * The profiler is thread safe (e.g. for the tasks of a ThreadPool): entering a
+ * scope is lock free, recording it and counter updates take a lock, every thread
+ * keeps its own nesting depth and becomes its own lane of the trace. Scopes
+ * inside OpenMP loop bodies would still serialize on the lock.
+ */
+class Profiler
+{
+public:
+  /**
+   * @brief Get the process-wide profiler.
+   *
+   * @return The profiler; created (and its exit report registered) on first use.
+   */
+  static Profiler& instance();
+
+  /**
+   * @brief Register a timed phase.
+   *
+   * @param a_name Phase name; must be a string literal or otherwise outlive the profiler.
+   * @return The phase index (the same index for the same name).
+   */
+  int section(const char* a_name);
+
+  /**
+   * @brief Register an event counter.
+   *
+   * @param a_name Counter name; must be a string literal or otherwise outlive the profiler.
+   * @return The counter index (the same index for the same name).
+   */
+  int counter(const char* a_name);
+
+  /**
+   * @brief Add to a counter.
+   *
+   * @param a_counter Counter index from counter().
+   * @param a_amount Amount to add.
+   */
+  void add(const int& a_counter, const long& a_amount)
+  {
+    if (!m_enabled)
+      return;
+    lock_guard<mutex> guard(m_lock);
+    m_counters[a_counter].value += a_amount;
+  }
+
+  /**
+   * @brief Check whether a report was requested; timers are inactive otherwise.
+   *
+   * @return True if FEM_PROFILE or FEM_TRACE is set.
+   */
+  bool enabled() const
+  {
+    return m_enabled;
+  }
+
+  /**
+   * @brief Microseconds since the profiler was created.
+   *
+   * @return The time stamp.
+   */
+  double now() const
+  {
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - m_origin).count();
+  }
+
+  /**
+   * @brief Mark the start of a phase (called by ScopedTimer).
+   *
+   * @param a_section Phase index.
+   * @return The peak RSS in kB at entry for an outermost phase of its thread, -1 for a nested one.
+   */
+  long enter(const int& a_section);
+
+  /**
+   * @brief Record a finished phase (called by ScopedTimer).
+   *
+   * @param a_section Phase index.
+   * @param a_start Start time stamp (now()).
+   * @param a_peakAtEntry Peak RSS in kB returned by enter(), -1 if not measured.
+   */
+  void leave(const int& a_section, const double& a_start, const long& a_peakAtEntry);
+
+  /**
+   * @brief Print the summary table and/or write the trace, as requested.
+   *
+   * Runs automatically at exit; calling it again does nothing.
+   */
+  void report();
+
+  /**
+   * @brief Peak resident set size of the process so far.
+   *
+   * @return The peak RSS in kB.
+   */
+  static long peakRSS();
+
+private:
+  /**
+   * @brief Constructor reading FEM_PROFILE and FEM_TRACE.
+   */
+  Profiler();
+
+  /**
+   * @brief Statistics of one phase.
+   */
+  struct Section
+  {
+    const char* name; /**< Phase name. */
+    int depth; /**< Nesting depth at the first call. */
+    long calls; /**< Number of calls. */
+    double total; /**< Total time in microseconds. */
+    double longest; /**< Longest call in microseconds. */
+    long peakRSS; /**< Peak RSS (kB) at the end of the phase. */
+    long growth; /**< Largest increase of the peak RSS (kB) during one call. */
+  };
+
+  /**
+   * @brief A counter.
+   */
+  struct Counter
+  {
+    const char* name; /**< Counter name. */
+    long value; /**< Current value. */
+  };
+
+  /**
+   * @brief One timed scope for the trace.
+   */
+  struct Event
+  {
+    int section; /**< Phase index. */
+    int thread; /**< Number of the thread (1 = first thread to record a scope). */
+    double start; /**< Start time stamp in microseconds. */
+    double duration; /**< Duration in microseconds. */
+  };
+
+  /**
+   * @brief Print the summary table to stderr.
+   */
+  void printSummary() const;
+
+  /**
+   * @brief Write the Chrome trace.
+   *
+   * @return False if the file could not be written.
+   */
+  bool writeTrace() const;
+
+  chrono::steady_clock::time_point m_origin; /**< Time origin of the time stamps. */
+  bool m_enabled; /**< True if a report was requested. */
+  bool m_summary; /**< Print the summary table at exit. */
+  std::string m_traceFile; /**< Chrome trace file, empty for none. */
+  bool m_reported; /**< True once report() ran. */
+  mutable mutex m_lock; /**< Guards the sections, counters and events. */
+  int m_numThreads; /**< Number of threads that have recorded scopes. */
+  vector<Section> m_sections; /**< Registered phases. */
+  vector<Counter> m_counters; /**< Registered counters. */
+  vector<Event> m_events; /**< Timed scopes in completion order (trace only). */
+  long m_droppedEvents; /**< Scopes not recorded once the trace buffer was full. */
+};
+
+/**
+ * @class ScopedTimer
+ * @brief Times the enclosing scope as one call of a profiler phase.
+ */
+class ScopedTimer
+{
+public:
+  /**
+   * @brief Start timing.
+   *
+   * @param a_section Phase index from Profiler::section().
+   */
+  explicit ScopedTimer(const int& a_section)
+    : m_section(a_section), m_active(Profiler::instance().enabled())
+  {
+    if (m_active)
+    {
+      m_peakAtEntry = Profiler::instance().enter(m_section);
+      m_start = Profiler::instance().now();
+    }
+  }
+
+  /**
+   * @brief Stop timing and record the call.
+   */
+  ~ScopedTimer()
+  {
+    if (m_active)
+      Profiler::instance().leave(m_section, m_start, m_peakAtEntry);
+  }
+
+private:
+  ScopedTimer(const ScopedTimer&);
+  ScopedTimer& operator=(const ScopedTimer&);
+
+  int m_section; /**< Phase index. */
+  bool m_active; /**< True if the profiler is enabled. */
+  double m_start; /**< Start time stamp. */
+  long m_peakAtEntry; /**< Peak RSS (kB) at entry. */
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef FEM_NO_PROFILE
+#define PROFILE_SCOPE(name)
+#define PROFILE_COUNT(name, amount) \
+  do \
+  { \
+  } while (0)
+#else
+/** Time the rest of the enclosing scope as phase "name". */
+#define PROFILE_SCOPE(name) \
+  static const int PROFILE_CONCAT(profileSection_, __LINE__) = Profiler::instance().section(name); \
+  ScopedTimer PROFILE_CONCAT(profileTimer_, __LINE__)(PROFILE_CONCAT(profileSection_, __LINE__))
+/** Add amount to counter "name". */
+#define PROFILE_COUNT(name, amount) \
+  do \
+  { \
+    static const int profileCounter = Profiler::instance().counter(name); \
+    Profiler::instance().add(profileCounter, (long)(amount)); \
+  } while (0)
+#endif
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef _SOLVERSERVICE_H_
+#define _SOLVERSERVICE_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <ostream>
+#include <sstream>
+#include "FEGrid.h"
+#include "FEAssembler.h"
+#include "PCGSolver.h"
+
+using namespace std;
+
+/**
+ * @brief Binary request sent to the solver service.
+ *
+ * The header is followed by pathLength bytes of mesh prefix (".node"/".elem" are
+ * appended; the client sends an absolute path, since the service may run in another
+ * directory) and, if numValues > 0, by numValues doubles of right hand side over
+ * the interior nodes. Without a right hand side the load of the uniform source is used.
+ */
+struct ServiceRequest
+{
+  uint32_t magic; /**< SolverService::s_requestMagic. */
+  uint32_t type; /**< SolverService::RequestType. */
+  uint32_t pathLength; /**< Length of the mesh prefix. */
+  uint32_t numValues; /**< Length of the right hand side, 0 for the uniform source. */
+  double conductivity[DIM * DIM]; /**< Conductivity tensor (row major) of every element. */
+  double source; /**< Uniform source, used when numValues is 0. */
+  double tolerance; /**< Relative residual of the PCG solve. */
+};
+
+/**
+ * @brief Binary response of the solver service.
+ *
+ * The header is followed by numValues doubles: the interior solution of a SOLVE
+ * request, or the text of a STATS request (numValues counts bytes then).
+ */
+struct ServiceResponse
+{
+  uint32_t magic; /**< SolverService::s_responseMagic. */
+  int32_t status; /**< 0 on success, negative SolverService::Status on failure. */
+  int32_t iterations; /**< PCG iterations. */
+  uint32_t numValues; /**< Length of the payload. */
+  uint32_t cacheHits; /**< Bit 0: mesh found in cache, bit 1: matrix and preconditioner found. */
+  uint32_t padding; /**< Unused, zero. */
+  double residual; /**< Relative residual reached. */
+  double seconds; /**< Service time of the request (excluding socket transfer). */
+};
+
+/**
+ * @class SolverService
+ * @brief Long-running solver that keeps meshes, matrices and preconditioners warm between jobs.
+ *
+ * Requests arrive as ServiceRequest messages over a Unix domain stream socket; a
+ * connection may carry any number of requests. Meshes are cached by a content
+ * hash of their .node/.elem files (rehashed only when size or modification time
+ * change), and the assembled matrix with its IC(0) preconditioner and unit load
+ * by mesh hash and conductivity. All cached objects share one memory budget with
+ * least-recently-used eviction. The service is single threaded: requests are
+ * handled one at a time in arrival order.
+ */
+class SolverService
+{
+public:
+  /**
+   * @brief Kind of request.
+   */
+  enum RequestType
+  {
+    SOLVE = 1, /**< Solve on a mesh; the response carries the interior solution. */
+    STATS = 2, /**< Return the cache and latency statistics as text. */
+    SHUTDOWN = 3 /**< Stop the service after responding. */
+  };
+
+  /**
+   * @brief Failure codes of ServiceResponse::status.
+   */
+  enum Status
+  {
+    OK = 0, /**< Success. */
+    BAD_REQUEST = -1, /**< Unknown type, bad magic or wrong right hand side length. */
+    MESH_NOT_FOUND = -2, /**< The mesh files could not be read. */
+    BAD_MESH = -3 /**< The mesh files are malformed (bad counts, IDs or vertex references). */
+  };
+
+  static const uint32_t s_requestMagic = 0x51454546; /**< "FEEQ" */
+  static const uint32_t s_responseMagic = 0x52454546; /**< "FEER" */
+
+  /**
+   * @brief Constructor.
+   *
+   * @param a_socketPath Path of the Unix domain socket to create.
+   * @param a_memoryBudget Bytes available to cached meshes and systems.
+   */
+  SolverService(const std::string& a_socketPath, const size_t& a_memoryBudget);
+
+  /**
+   * @brief Destructor closing and removing the socket.
+   */
+  ~SolverService();
+
+  /**
+   * @brief Accept connections and serve requests until a SHUTDOWN request.
+   *
+   * @return False if the socket could not be created.
+   */
+  bool run();
+
+  /**
+   * @brief Print cache and request latency statistics.
+   *
+   * @param a_os Output stream.
+   */
+  void printStatistics(ostream& a_os) const;
+
+  /**
+   * @brief Send a request and read the response (client side).
+   *
+   * @param a_socketPath Path of the service socket.
+   * @param a_request Request header; magic and pathLength are filled in.
+   * @param a_prefix Mesh prefix.
+   * @param a_rhs Right hand side (may be empty); numValues is filled in.
+   * @param a_response Response header.
+   * @param a_payload Response payload (solution or statistics text bytes).
+   * @return False if the service could not be reached.
+   */
+  static bool request(const std::string& a_socketPath, ServiceRequest& a_request, const std::string& a_prefix,
+                      const vector<double>& a_rhs, ServiceResponse& a_response, vector<char>& a_payload);
+
+private:
+  /**
+   * @brief Matrix, preconditioner and unit load of a mesh and conductivity.
+   */
+  struct System
+  {
+    shared_ptr<FEGrid> grid; /**< The mesh (kept alive while the system is cached). */
+    unique_ptr<FEAssembler> assembler; /**< Assembled stiffness matrix. */
+    unique_ptr<PCGSolver> solver; /**< Solver with its preconditioner. */
+    vector<double> unitLoad; /**< Load vector of a unit source. */
+  };
+
+  /**
+   * @brief Cached object, either a mesh or a system.
+   */
+  struct Entry
+  {
+    std::string key; /**< Cache key. */
+    shared_ptr<FEGrid> grid; /**< Mesh, or NULL. */
+    shared_ptr<System> system; /**< System, or NULL. */
+    size_t bytes; /**< Estimated memory footprint. */
+  };
+
+  /**
+   * @brief Content hash of a mesh, remembered per prefix with the file sizes and times.
+   */
+  struct FileHash
+  {
+    long long stamp[4]; /**< Size and modification time of the .node and .elem files. */
+    uint64_t hash; /**< FNV-1a hash of both files. */
+  };
+
+  /**
+   * @brief Serve one connection until the client closes it.
+   *
+   * @return False if a SHUTDOWN request was served.
+   */
+  bool serve(const int& a_fd);
+
+  /**
+   * @brief Handle a SOLVE request.
+   */
+  void solve(const ServiceRequest& a_request, const std::string& a_prefix, const vector<double>& a_rhs,
+             ServiceResponse& a_response, vector<double>& a_solution);
+
+  /**
+   * @brief Content hash of the mesh files of a prefix.
+   *
+   * @param a_prefix Mesh prefix.
+   * @param a_hash Hash to fill.
+   * @return False if a file could not be read.
+   */
+  bool meshHash(const std::string& a_prefix, uint64_t& a_hash);
+
+  /**
+   * @brief Find an entry and mark it most recently used.
+   *
+   * @return The entry, or NULL.
+   */
+  Entry* lookup(const std::string& a_key);
+
+  /**
+   * @brief Insert an entry as most recently used and evict down to the budget.
+   */
+  void insert(const Entry& a_entry);
+
+  std::string m_socketPath; /**< Path of the socket. */
+  int m_listenFd; /**< Listening socket, -1 before run(). */
+  size_t m_memoryBudget; /**< Bytes available to the cache. */
+  size_t m_cachedBytes; /**< Bytes held by the cache. */
+  list<Entry> m_lru; /**< Cached entries, most recently used first. */
+  unordered_map<std::string, list<Entry>::iterator> m_index; /**< Entries by key. */
+  unordered_map<std::string, FileHash> m_fileHashes; /**< Mesh hashes by prefix. */
+  long m_meshHits, m_meshMisses; /**< Mesh cache statistics. */
+  long m_systemHits, m_systemMisses; /**< System cache statistics. */
+  long m_evictions; /**< Number of evicted entries. */
+  vector<double> m_latencies; /**< Service time of the SOLVE requests in seconds (last s_maxLatencies). */
+  long m_numSolves; /**< Number of SOLVE requests served. */
+  long m_numErrors; /**< Number of failed requests. */
+};
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef _SPARSEMATRIX_H_
+#define _SPARSEMATRIX_H_
+
+#include <vector>
+#include <ostream>
+
+using namespace std;
+
+/**
+ * @class SparseMatrix
+ * @brief Square matrix in compressed sparse row (CSR) format.
+ *
+ * The sparsity pattern (row pointers and sorted column indices) is fixed at
+ * construction; only the values change afterwards. This lets an assembler
+ * compute the position of every element contribution once and re-use it.
+ *
+ * A matrix either owns its arrays or is a view of arrays owned elsewhere (e.g.
+ * a memory-mapped cache file, see MatrixCache); copying a view copies the view.
+ */
+class SparseMatrix
+{
+public:
+  /**
+   * @brief Default constructor. Creates an empty 0x0 matrix.
+   */
+  SparseMatrix();
+
+  /**
+   * @brief Constructor from a sparsity pattern. All values are set to zero.
+   *
+   * @param a_rowPtr Row pointers, of size numRows + 1.
+   * @param a_colInd Column indices, sorted within each row.
+   */
+  SparseMatrix(const vector<int>& a_rowPtr, const vector<int>& a_colInd);
+
+  /**
+   * @brief Constructor wrapping existing CSR arrays without copying them.
+   *
+   * @param a_numRows Number of rows.
+   * @param a_rowPtr Row pointers, of size numRows + 1.
+   * @param a_colInd Column indices, sorted within each row.
+   * @param a_values Values; written by zero(), add() and addDiagonal().
+   * The arrays must outlive the matrix and all its copies.
+   */
+  SparseMatrix(const int& a_numRows, const int* a_rowPtr, const int* a_colInd, double* a_values);
+
+  /**
+   * @brief Copy constructor.
+   */
+  SparseMatrix(const SparseMatrix& a_other);
+
+  /**
+   * @brief Move constructor.
+   */
+  SparseMatrix(SparseMatrix&& a_other);
+
+  /**
+   * @brief Copy assignment.
+   */
+  SparseMatrix& operator=(const SparseMatrix& a_other);
+
+  /**
+   * @brief Move assignment.
+   */
+  SparseMatrix& operator=(SparseMatrix&& a_other);
+
+  /**
+   * @brief Get the number of rows (and columns) of the matrix.
+   *
+   * @return The number of rows.
+   */
+  int numRows() const;
+
+  /**
+   * @brief Get the number of stored entries.
+   *
+   * @return The number of non-zeros in the pattern.
+   */
+  int nnz() const;
+
+  /**
+   * @brief Find the storage slot of entry (a_row, a_col).
+   *
+   * @param a_row Row index.
+   * @param a_col Column index.
+   * @return Index into values(), or -1 if the entry is not in the pattern.
+   */
+  int find(const int& a_row, const int& a_col) const;
+
+  /**
+   * @brief Set all stored values to zero, keeping the pattern.
+   */
+  void zero();
+
+  /**
+   * @brief Add a multiple of another matrix with the same pattern, A += a_alpha * a_other.
+   *
+   * @param a_alpha Scale factor.
+   * @param a_other Matrix with an identical pattern.
+   */
+  void add(const double& a_alpha, const SparseMatrix& a_other);
+
+  /**
+   * @brief Add a_diag[i] to each diagonal entry A_ii.
+   *
+   * @param a_diag Vector of size numRows(); the pattern must contain the diagonal.
+   */
+  void addDiagonal(const double* a_diag);
+
+  /**
+   * @brief Compute a_y = A * a_x.
+   *
+   * @param a_x Input vector of size numRows().
+   * @param a_y Output vector of size numRows().
+   */
+  void multiply(const double* a_x, double* a_y) const;
+
+  /**
+   * @brief Copy the diagonal of the matrix.
+   *
+   * @param a_diag Output vector of size numRows().
+   */
+  void diagonal(double* a_diag) const;
+
+  /**
+   * @brief Lower bandwidth, the largest row - col over stored entries.
+   *
+   * @return The lower bandwidth.
+   */
+  int lowerBandwidth() const;
+
+  /**
+   * @brief Upper bandwidth, the largest col - row over stored entries.
+   *
+   * @return The upper bandwidth.
+   */
+  int upperBandwidth() const;
+
+  /**
+   * @brief Write the matrix in dense, space separated form (for debugging).
+   *
+   * @param a_os Output stream.
+   */
+  void printDense(ostream& a_os) const;
+
+  const int* rowPtr() const; /**< Row pointers, numRows() + 1 entries. */
+  const int* colInd() const; /**< Column indices, nnz() entries. */
+  const double* values() const; /**< Values, nnz() entries. */
+  double* values(); /**< Writable values, nnz() entries. */
+
+private:
+  /**
+   * @brief Point the array pointers at the owned vectors, unless the matrix is a view.
+   */
+  void bind();
+
+  int m_numRows; /**< Number of rows. */
+  int m_nnz; /**< Number of stored entries. */
+  bool m_isView; /**< True if the arrays are owned elsewhere. */
+  vector<int> m_rowPtr; /**< Start of each row in m_colInd / m_values (owned storage). */
+  vector<int> m_colInd; /**< Column index of each stored entry (owned storage). */
+  vector<double> m_values; /**< Value of each stored entry (owned storage). */
+  const int* m_rowPtrData; /**< Row pointers in use. */
+  const int* m_colIndData; /**< Column indices in use. */
+  double* m_valuesData; /**< Values in use. */
+};
+
+#endif
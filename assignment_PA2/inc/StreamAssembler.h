@@ -0,0 +1,151 @@
+#ifndef _STREAMASSEMBLER_H_
+#define _STREAMASSEMBLER_H_
+
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <functional>
+#include <ostream>
+#include "Node.h"
+#include "Element.h"
+#include "SparseMatrix.h"
+
+using namespace std;
+
+/**
+ * @class StreamAssembler
+ * @brief Out-of-core assembly of the stiffness matrix from an element file read in chunks.
+ *
+ * Only the node table (coordinates and interior numbering, 20 bytes per node) is
+ * kept in memory. Elements are read in chunks from a text (.elem) or binary
+ * element file; the interior entries of each chunk are sorted, combined and
+ * spilled to a run file on disk. The runs are then combined by k-way merges
+ * with a fan-in fixed by the budget, over as many passes as needed, into the
+ * final CSR matrix. The memory budget bounds the chunk buffers and the merge
+ * buffers however many runs there are; the node table and the output matrix
+ * come on top.
+ */
+class StreamAssembler
+{
+public:
+  /**
+   * @brief Constructor reading the node file.
+   *
+   * A node file that cannot be opened, is truncated, or has a node ID out of
+   * range or repeated makes assemble() fail.
+   *
+   * @param a_nodeFileName The .node file.
+   * @param a_conductivity Conductivity tensor (row major DIM x DIM) of every element.
+   * @param a_memoryBudget Working memory in bytes for the chunk and merge buffers.
+   * @param a_tempDir Directory for the run files.
+   */
+  StreamAssembler(const std::string& a_nodeFileName, const double a_conductivity[DIM * DIM],
+                  const size_t& a_memoryBudget, const std::string& a_tempDir = ".");
+
+  /**
+   * @brief Assemble the stiffness matrix and the load vector of a uniform source.
+   *
+   * @param a_elementFileName Text .elem file or binary element file (see writeBinaryElements()).
+   * @param a_matrix Matrix to fill with the stiffness matrix over the interior nodes.
+   * @param a_load Vector to fill with the load vector.
+   * @param a_source Uniform source value f.
+   * @return False if the node file was invalid, a file could not be opened, read or written, or the element
+   * file is truncated or malformed.
+   */
+  bool assemble(const std::string& a_elementFileName, SparseMatrix& a_matrix, vector<double>& a_load,
+                const double& a_source = 1.0);
+
+  /**
+   * @brief Convert a text .elem file to the binary element format.
+   *
+   * The binary file is the magic number, the element count (int32) and then
+   * VERTICES 1-based vertex numbers (int32) per element, in file order.
+   *
+   * @param a_textFileName The .elem file to read.
+   * @param a_binaryFileName The binary file to write.
+   * @return False if a file could not be opened.
+   */
+  static bool writeBinaryElements(const std::string& a_textFileName, const std::string& a_binaryFileName);
+
+  /**
+   * @brief Print time, volume and throughput of each stage of the last assemble().
+   *
+   * @param a_os Output stream.
+   */
+  void printStatistics(ostream& a_os) const;
+
+  /**
+   * @brief Get the number of interior nodes (rows of the matrix).
+   *
+   * @return The number of interior nodes.
+   */
+  int getNumInteriorNodes() const;
+
+private:
+  /**
+   * @brief Entry of a partial matrix.
+   */
+  struct Triplet
+  {
+    int row; /**< Row (interior node) index. */
+    int col; /**< Column (interior node) index. */
+    double value; /**< Contribution. */
+  };
+
+  /**
+   * @brief Time and volume of one stage.
+   */
+  struct Stage
+  {
+    const char* name; /**< Stage name. */
+    double seconds; /**< Wall time. */
+    long items; /**< Elements or entries processed. */
+    long bytes; /**< Bytes read or written. */
+  };
+
+  /**
+   * @brief Read up to a_max elements (0-based vertices) from the open element file.
+   *
+   * @return The number of elements read, or -1 if the file is truncated or a vertex is out of range.
+   */
+  int readElements(int* a_vertices, const int& a_max);
+
+  /**
+   * @brief Merge the run files into the CSR matrix.
+   *
+   * @return False if a run file could not be read or written.
+   */
+  bool merge(SparseMatrix& a_matrix);
+
+  /**
+   * @brief Merge a group of runs in (row, col) order, summing equal keys.
+   *
+   * @param a_first First run of the group.
+   * @param a_last One past the last run.
+   * @param a_bufferSize Read buffer per run, in triplets.
+   * @param a_emit Called with every combined entry in order; returns false on a write error.
+   * @return False if a run could not be read or a_emit failed.
+   */
+  bool mergeRuns(const int& a_first, const int& a_last, const size_t& a_bufferSize,
+                 const function<bool(const Triplet&)>& a_emit);
+
+  vector<double> m_coordinates; /**< DIM coordinates per node. */
+  vector<int> m_interiorID; /**< Interior number per node, -1 on the boundary. */
+  int m_numInteriorNodes; /**< Number of interior nodes. */
+  double m_conductivity[DIM * DIM]; /**< Conductivity tensor. */
+  size_t m_memoryBudget; /**< Working memory in bytes. */
+  std::string m_tempDir; /**< Directory for the run files. */
+  vector<std::string> m_runs; /**< Names of the run files of the current assembly. */
+  vector<long> m_runLengths; /**< Number of triplets in each run. */
+  int m_numSpilledRuns; /**< Number of runs spilled by the last assemble(). */
+  int m_numMergePasses; /**< Number of merge passes of the last assemble(). */
+  bool m_nodesValid; /**< True if the node file was read completely and valid. */
+  ifstream m_textElements; /**< Open text element file. */
+  FILE* m_binaryElements; /**< Open binary element file. */
+  int m_remaining; /**< Elements left to read. */
+  Stage m_stages[5]; /**< Parse, kernel, sort, spill and merge statistics. */
+  size_t m_peakBytes; /**< Largest working memory used by a stage. */
+};
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class ThreadPool
+ * @brief Fixed set of worker threads with one task deque per worker and work stealing.
+ *
+ * A task submitted from a worker goes to the back of that worker's own deque
+ * and is taken from the back again (LIFO), so follow-up work of a task stays
+ * on the same core while its data is warm. Tasks submitted from outside are
+ * dealt round robin. An idle worker steals from the front (the oldest task)
+ * of another deque and sleeps only when every deque is empty.
+ *
+ * parallelFor() splits a loop into chunks; the calling thread runs chunks and
+ * any other queued task until its loop is done, so it may be called from
+ * inside a task (nested parallelism) without tying up a worker.
+ */
+class ThreadPool
+{
+public:
+  typedef function<void()> Task;
+
+  /**
+   * @brief Constructor starting the workers.
+   *
+   * @param a_numThreads Number of workers, 0 for the number of hardware threads.
+   */
+  explicit ThreadPool(const int& a_numThreads = 0);
+
+  /**
+   * @brief Destructor finishing all submitted tasks and joining the workers.
+   */
+  ~ThreadPool();
+
+  /**
+   * @brief Queue a task.
+   *
+   * @param a_task The task; it may submit further tasks.
+   */
+  void submit(const Task& a_task);
+
+  /**
+   * @brief Block until every submitted task (including tasks they submitted) has finished.
+   *
+   * Must not be called from a task.
+   */
+  void wait();
+
+  /**
+   * @brief Run a_body(begin, end) over chunks of [a_begin, a_end) in parallel.
+   *
+   * @param a_begin First index.
+   * @param a_end One past the last index.
+   * @param a_grain Chunk size; a range no larger than this runs inline.
+   * @param a_body Loop body called with disjoint subranges.
+   */
+  void parallelFor(const int& a_begin, const int& a_end, const int& a_grain, const function<void(int, int)>& a_body);
+
+  /**
+   * @brief Get the number of workers.
+   *
+   * @return The number of threads.
+   */
+  int numThreads() const;
+
+  /**
+   * @brief Get the number of tasks run so far.
+   *
+   * @return The number of tasks.
+   */
+  long getNumTasks() const;
+
+  /**
+   * @brief Get the number of tasks taken from another worker's deque.
+   *
+   * @return The number of steals.
+   */
+  long getNumSteals() const;
+
+private:
+  ThreadPool(const ThreadPool&);
+  ThreadPool& operator=(const ThreadPool&);
+
+  /**
+   * @brief Task deque of one worker.
+   */
+  struct Queue
+  {
+    mutex lock; /**< Guards tasks. */
+    deque<Task> tasks; /**< Own tasks at the back, stolen from the front. */
+  };
+
+  /**
+   * @brief Index of the calling thread among the workers of this pool.
+   *
+   * @return The worker index, -1 for other threads.
+   */
+  int currentWorker() const;
+
+  /**
+   * @brief Take a task: from the back of the own deque, else from the front of another.
+   *
+   * @param a_worker Worker index, -1 to only steal.
+   * @param a_task Task to fill.
+   * @return False if every deque is empty.
+   */
+  bool take(const int& a_worker, Task& a_task);
+
+  /**
+   * @brief Run one queued task if there is one.
+   *
+   * @param a_worker Worker index, -1 for other threads.
+   * @return False if no task was found.
+   */
+  bool runOne(const int& a_worker);
+
+  /**
+   * @brief Main loop of a worker.
+   *
+   * @param a_worker Worker index.
+   */
+  void work(const int& a_worker);
+
+  vector<unique_ptr<Queue> > m_queues; /**< One deque per worker. */
+  vector<thread> m_threads; /**< The workers. */
+  mutex m_lock; /**< Guards sleeping and waking. */
+  condition_variable m_wake; /**< Signalled when a task is queued or the pool stops. */
+  condition_variable m_idle; /**< Signalled when the last pending task finishes. */
+  atomic<long> m_queued; /**< Tasks waiting in the deques. */
+  atomic<long> m_pending; /**< Tasks queued or running. */
+  atomic<unsigned> m_next; /**< Round robin counter for tasks submitted from outside. */
+  atomic<long> m_numTasks; /**< Tasks run. */
+  atomic<long> m_numSteals; /**< Tasks stolen. */
+  bool m_stop; /**< True once the destructor runs (guarded by m_lock). */
+};
+
+#endif
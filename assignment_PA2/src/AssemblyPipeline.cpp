@@ -0,0 +1,363 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <thread>
+#include "AssemblyPipeline.h"
+#include "BoundedQueue.h"
+#include "Profiler.h"
+
+/**
+ * @brief Seconds elapsed since a time point.
+ */
+static double secondsSince(const chrono::steady_clock::time_point& a_start)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - a_start).count();
+}
+
+/**
+ * @brief Constructor.
+ *
+ * @param a_conductivity Conductivity tensor (row major DIM x DIM) of every element.
+ * @param a_batchSize Nodes or elements per batch.
+ * @param a_queueDepth Batches each queue holds before its producer blocks.
+ */
+AssemblyPipeline::AssemblyPipeline(const double a_conductivity[DIM * DIM], const int& a_batchSize,
+                                   const int& a_queueDepth)
+  : m_batchSize(max(1, a_batchSize)), m_queueDepth(max(1, a_queueDepth)), m_elapsed(0.0)
+{
+  for (int k = 0; k < DIM * DIM; k++)
+  {
+    m_conductivity[k] = a_conductivity[k];
+  }
+  const char* names[NUM_STAGES] = {"nodes", "number", "elems", "kernel", "scatter", "csr"};
+  for (int s = 0; s < NUM_STAGES; s++)
+  {
+    Stage stage = {names[s], 0.0, 0.0, 0};
+    m_stages[s] = stage;
+  }
+}
+
+/**
+ * @brief Read a mesh and assemble its stiffness matrix.
+ *
+ * @param a_nodeFileName The .node file.
+ * @param a_elementFileName The .elem file.
+ * @param a_grid Grid to replace with the mesh.
+ * @param a_assembler Set to an assembler of a_grid holding the assembled matrix.
+ * @return False if a file could not be opened, is truncated, or has a node or element
+ * number out of range or repeated; a_grid and a_assembler are then unchanged.
+ * The scatter stage runs on the calling thread. Each stage only touches data
+ * that its input queue or a completed stage (the futures) has handed over.
+ * The parsing stages check every item; on bad input a stage records the
+ * failure and stops, closing its queue so that the later stages drain and end.
+ */
+bool AssemblyPipeline::run(const std::string& a_nodeFileName, const std::string& a_elementFileName, FEGrid& a_grid,
+                           unique_ptr<FEAssembler>& a_assembler)
+{
+  PROFILE_SCOPE("assembly_pipeline");
+  auto start = chrono::steady_clock::now();
+  ifstream nodes(a_nodeFileName.c_str());
+  ifstream elements(a_elementFileName.c_str());
+  if (!nodes || !elements)
+    return false;
+  int numNodes = 0, numElts = 0;
+  nodes >> numNodes;
+  elements >> numElts;
+  if (!nodes || !elements || numNodes <= 0 || numElts <= 0)
+    return false;
+  for (int s = 0; s < NUM_STAGES; s++)
+  {
+    m_stages[s].seconds = m_stages[s].blocked = 0.0;
+    m_stages[s].items = 0;
+  }
+
+  vector<double> coordinates(numNodes * DIM, 0.0);
+  vector<int> interiorID(numNodes, -1);
+  int numInterior = 0;
+  atomic<bool> failed(false);
+  BoundedQueue<vector<int> > nodeQueue(m_queueDepth);
+  BoundedQueue<ElementBatch> elementQueue(m_queueDepth), kernelQueue(m_queueDepth);
+  promise<void> parsed, numbered;
+  shared_future<void> nodesParsed = parsed.get_future().share();
+  shared_future<void> nodesNumbered = numbered.get_future().share();
+
+  // Stage nodes: coordinates into the table, node numbers of each batch to the numbering
+  thread nodeStage([&]() {
+    auto begin = chrono::steady_clock::now();
+    vector<int> batch;
+    for (int i = 0; i < numNodes && !failed; i++)
+    {
+      int vertex;
+      std::string tmp[DIM];
+      nodes >> vertex >> tmp[0] >> tmp[1];
+      vertex--;
+      if (!nodes || vertex < 0 || vertex >= numNodes)
+      {
+        failed = true;
+        break;
+      }
+      coordinates[vertex * DIM] = atof(tmp[0].c_str());
+      coordinates[vertex * DIM + 1] = atof(tmp[1].c_str());
+      batch.push_back(vertex);
+      if ((int)batch.size() == m_batchSize)
+      {
+        nodeQueue.push(batch);
+        batch.clear();
+      }
+    }
+    if (!batch.empty())
+      nodeQueue.push(batch);
+    nodeQueue.close();
+    parsed.set_value();
+    m_stages[NODES].seconds = secondsSince(begin);
+    m_stages[NODES].blocked = nodeQueue.getPushWait();
+    m_stages[NODES].items = numNodes;
+  });
+
+  // Stage numbering: interior numbers in global node order over the parsed prefix
+  thread numberingStage([&]() {
+    auto begin = chrono::steady_clock::now();
+    vector<char> isParsed(numNodes, 0);
+    vector<int> batch;
+    int next = 0;
+    while (nodeQueue.pop(batch))
+    {
+      for (size_t b = 0; b < batch.size(); b++)
+      {
+        if (isParsed[batch[b]])
+          failed = true;
+        isParsed[batch[b]] = 1;
+      }
+      for (; next < numNodes && isParsed[next]; next++)
+      {
+        if (!FEGrid::isBoundaryPosition(&coordinates[next * DIM]))
+          interiorID[next] = numInterior++;
+      }
+    }
+    // Nodes missing from the file keep the origin, which is on the boundary
+    for (; next < numNodes; next++)
+    {
+      if (!FEGrid::isBoundaryPosition(&coordinates[next * DIM]))
+        interiorID[next] = numInterior++;
+    }
+    numbered.set_value();
+    m_stages[NUMBERING].seconds = secondsSince(begin);
+    m_stages[NUMBERING].blocked = nodeQueue.getPopWait();
+    m_stages[NUMBERING].items = numNodes;
+  });
+
+  // Stage elements: batches of element numbers and vertices
+  thread elementStage([&]() {
+    auto begin = chrono::steady_clock::now();
+    ElementBatch batch;
+    vector<char> isRead(numElts, 0);
+    for (int i = 0; i < numElts && !failed; i++)
+    {
+      int cellID, vert[VERTICES];
+      elements >> cellID >> vert[0] >> vert[1] >> vert[2];
+      bool valid = elements && cellID >= 1 && cellID <= numElts && !isRead[cellID - 1];
+      for (int m = 0; m < VERTICES; m++)
+      {
+        valid = valid && vert[m] >= 1 && vert[m] <= numNodes;
+      }
+      if (!valid)
+      {
+        failed = true;
+        break;
+      }
+      isRead[cellID - 1] = 1;
+      batch.ids.push_back(cellID - 1);
+      for (int m = 0; m < VERTICES; m++)
+      {
+        batch.vertices.push_back(vert[m] - 1);
+      }
+      if ((int)batch.ids.size() == m_batchSize || i == numElts - 1)
+      {
+        elementQueue.push(batch);
+        batch = ElementBatch();
+      }
+    }
+    elementQueue.close();
+    m_stages[ELEMENTS].seconds = secondsSince(begin);
+    m_stages[ELEMENTS].blocked = elementQueue.getPushWait();
+    m_stages[ELEMENTS].items = numElts;
+  });
+
+  // Stage kernel: element stiffness matrices, once all coordinates are known
+  thread kernelStage([&]() {
+    auto begin = chrono::steady_clock::now();
+    nodesParsed.wait();
+    double waitNodes = secondsSince(begin);
+    ElementBatch batch;
+    while (elementQueue.pop(batch))
+    {
+      int count = batch.ids.size();
+      batch.matrices.resize(count * VERTICES * VERTICES);
+      for (int e = 0; e < count; e++)
+      {
+        double x[VERTICES][DIM];
+        for (int m = 0; m < VERTICES; m++)
+        {
+          int vertex = batch.vertices[e * VERTICES + m];
+          x[m][0] = coordinates[vertex * DIM];
+          x[m][1] = coordinates[vertex * DIM + 1];
+        }
+        FEAssembler::elementStiffness(x, m_conductivity, &batch.matrices[e * VERTICES * VERTICES]);
+      }
+      m_stages[KERNEL].items += count;
+      kernelQueue.push(batch);
+    }
+    kernelQueue.close();
+    m_stages[KERNEL].seconds = secondsSince(begin);
+    m_stages[KERNEL].blocked = waitNodes + elementQueue.getPopWait() + kernelQueue.getPushWait();
+  });
+
+  // Stage scatter (this thread): accumulate rows, remembering each entry's position in its row
+  auto scatterBegin = chrono::steady_clock::now();
+  vector<Element> elementList(numElts);
+  vector<double> elementMatrices(numElts * VERTICES * VERTICES, 0.0);
+  vector<int> scatter(numElts * VERTICES * VERTICES, -1);
+  nodesNumbered.wait();
+  double waitNumbering = secondsSince(scatterBegin);
+  vector<vector<pair<int, double> > > rows(numInterior);
+  ElementBatch batch;
+  while (kernelQueue.pop(batch))
+  {
+    int count = batch.ids.size();
+    for (int e = 0; e < count; e++)
+    {
+      int id = batch.ids[e];
+      int vert[VERTICES];
+      copy(&batch.vertices[e * VERTICES], &batch.vertices[e * VERTICES] + VERTICES, vert);
+      const double* kij = &batch.matrices[e * VERTICES * VERTICES];
+      elementList[id] = Element(vert);
+      copy(kij, kij + VERTICES * VERTICES, &elementMatrices[id * VERTICES * VERTICES]);
+      for (int m = 0; m < VERTICES; m++)
+      {
+        int row = interiorID[vert[m]];
+        if (row < 0)
+          continue;
+        vector<pair<int, double> >& entries = rows[row];
+        for (int n = 0; n < VERTICES; n++)
+        {
+          int col = interiorID[vert[n]];
+          if (col < 0)
+            continue;
+          size_t k = 0;
+          while (k < entries.size() && entries[k].first != col)
+            k++;
+          if (k == entries.size())
+            entries.push_back(make_pair(col, 0.0));
+          entries[k].second += kij[m * VERTICES + n];
+          scatter[(id * VERTICES + m) * VERTICES + n] = k;
+        }
+      }
+    }
+    m_stages[SCATTER].items += count;
+  }
+  m_stages[SCATTER].seconds = secondsSince(scatterBegin);
+  m_stages[SCATTER].blocked = waitNumbering + kernelQueue.getPopWait();
+
+  nodeStage.join();
+  numberingStage.join();
+  elementStage.join();
+  kernelStage.join();
+  if (failed)
+  {
+    m_elapsed = secondsSince(start);
+    return false;
+  }
+
+  // Sort the rows into CSR and turn the in-row positions of the scatter map into slots
+  auto finalizeBegin = chrono::steady_clock::now();
+  vector<int> rowPtr(numInterior + 1, 0);
+  for (int row = 0; row < numInterior; row++)
+  {
+    rowPtr[row + 1] = rowPtr[row] + rows[row].size();
+  }
+  vector<int> colInd(rowPtr[numInterior]);
+  vector<double> values(rowPtr[numInterior]);
+  vector<int> slot(rowPtr[numInterior]);
+  vector<int> order;
+  for (int row = 0; row < numInterior; row++)
+  {
+    const vector<pair<int, double> >& entries = rows[row];
+    order.resize(entries.size());
+    for (size_t k = 0; k < entries.size(); k++)
+    {
+      order[k] = k;
+    }
+    sort(order.begin(), order.end(), [&entries](int a, int b) { return entries[a].first < entries[b].first; });
+    for (size_t k = 0; k < order.size(); k++)
+    {
+      colInd[rowPtr[row] + k] = entries[order[k]].first;
+      values[rowPtr[row] + k] = entries[order[k]].second;
+      slot[rowPtr[row] + order[k]] = rowPtr[row] + k;
+    }
+    vector<pair<int, double> >().swap(rows[row]);
+  }
+  for (int id = 0; id < numElts; id++)
+  {
+    for (int m = 0; m < VERTICES; m++)
+    {
+      int row = interiorID[elementList[id][m]];
+      for (int n = 0; n < VERTICES; n++)
+      {
+        int& s = scatter[(id * VERTICES + m) * VERTICES + n];
+        if (s >= 0)
+          s = slot[rowPtr[row] + s];
+      }
+    }
+  }
+  SparseMatrix matrix(rowPtr, colInd);
+  copy(values.begin(), values.end(), matrix.values());
+
+  vector<Node> nodeList(numNodes);
+  for (int i = 0; i < numNodes; i++)
+  {
+    nodeList[i] = Node(&coordinates[i * DIM], interiorID[i], interiorID[i] >= 0);
+  }
+  a_assembler.reset();
+  a_grid = FEGrid(nodeList, elementList);
+  a_assembler.reset(new FEAssembler(a_grid, m_conductivity, matrix, scatter, elementMatrices));
+  m_stages[FINALIZE].seconds = secondsSince(finalizeBegin);
+  m_stages[FINALIZE].items = numInterior;
+  m_elapsed = secondsSince(start);
+
+  PROFILE_COUNT("nodes_read", numNodes);
+  PROFILE_COUNT("elements_read", numElts);
+  PROFILE_COUNT("elements_integrated", numElts);
+  return true;
+}
+
+/**
+ * @brief Print the busy and blocked time and the throughput of each stage of the last run().
+ *
+ * @param a_os Output stream.
+ * The overlap is the sum of the stage times over the wall time: 1 means the
+ * stages ran one after another, larger values mean they ran concurrently.
+ */
+void AssemblyPipeline::printStatistics(ostream& a_os) const
+{
+  char line[160];
+  double total = 0.0;
+  for (int s = 0; s < NUM_STAGES; s++)
+  {
+    total += m_stages[s].seconds;
+  }
+  snprintf(line, sizeof(line), "Pipelined assembly: %.3f ms, batches of %d, queue depth %d, overlap %.2f\n",
+           m_elapsed * 1000, m_batchSize, m_queueDepth, total / max(m_elapsed, 1e-9));
+  a_os << line;
+  for (int s = 0; s < NUM_STAGES; s++)
+  {
+    const Stage& stage = m_stages[s];
+    double busy = max(stage.seconds - stage.blocked, 1e-9);
+    snprintf(line, sizeof(line), "  %-8s %9.3f ms %9.3f ms blocked %12ld items %12.3g items/s busy\n", stage.name,
+             stage.seconds * 1000, stage.blocked * 1000, stage.items, stage.items / busy);
+    a_os << line;
+  }
+}
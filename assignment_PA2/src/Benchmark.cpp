@@ -0,0 +1,291 @@
+#include "FEGrid.h"
+#include "FEAssembler.h"
+#include "FEHeat.h"
+#include "GridFn.h"
+#include "RDomain.h"
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * @brief Result of one benchmarked stage at one problem size.
+ */
+struct BenchResult
+{
+  string stage; /**< Stage name. */
+  string size; /**< Problem size label (mesh level or grid points). */
+  long items; /**< Elements or grid points processed per run. */
+  long dofs; /**< Degrees of freedom per run (0 if not meaningful). */
+  double bytes; /**< Estimated bytes moved per run. */
+  double best; /**< Fastest run in seconds. */
+  double median; /**< Median run in seconds. */
+};
+
+/**
+ * @brief Time a stage: one untimed warm-up run, then a_repetitions timed runs.
+ *
+ * @param a_setup Called before every run, outside the timed region.
+ * @param a_run The timed work.
+ * @param a_repetitions Number of timed runs.
+ * @param a_result Result to fill with the best and median times.
+ */
+static void timeStage(const function<void()>& a_setup, const function<void()>& a_run,
+                      const int& a_repetitions, BenchResult& a_result)
+{
+  vector<double> times;
+  for (int r = 0; r <= a_repetitions; r++)
+  {
+    a_setup();
+    auto start = chrono::steady_clock::now();
+    a_run();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (r > 0)
+      times.push_back(seconds);
+  }
+  sort(times.begin(), times.end());
+  a_result.best = times.front();
+  a_result.median = times[times.size() / 2];
+}
+
+/**
+ * @brief Size of a file in bytes, 0 if it does not exist.
+ */
+static double fileSize(const string& a_fileName)
+{
+  struct stat st;
+  return (stat(a_fileName.c_str(), &st) == 0) ? (double)st.st_size : 0.0;
+}
+
+/**
+ * @brief Split a comma separated list of integers.
+ */
+static vector<int> parseList(const string& a_list)
+{
+  vector<int> values;
+  stringstream ss(a_list);
+  string item;
+  while (getline(ss, item, ','))
+  {
+    values.push_back(atoi(item.c_str()));
+  }
+  return values;
+}
+
+static double s_sink = 0.0; /**< Accumulates kernel results so the compiler keeps the work. */
+
+/**
+ * @brief Benchmark driver for the mesh, assembly, heat stencil and output stages.
+ *
+ * Meshes are produced by uniformly refining a base mesh (fine.node/fine.elem by
+ * default) and writing it to a scratch directory, so mesh loading is measured on
+ * real files. Every stage runs once untimed to warm the caches and then a number
+ * of timed repetitions; the best and median times are reported together with
+ * elements (or points) per second, DOFs per second and an estimate of the memory
+ * or file bandwidth in GB/s. Results go to <output>.csv and <output>.json.
+ *
+ * Options: -m <mesh prefix> (default "fine"), -l <levels, e.g. 0,2,4>,
+ * -g <grid points, e.g. 1000,100000>, -n <repetitions>, -o <output prefix>.
+ *
+ * @return Returns 0 on successful execution.
+ */
+int main(int argc, char** argv)
+{
+  string meshPrefix = "fine";
+  vector<int> levels = parseList("0,2,4");
+  vector<int> gridSizes = parseList("1000,100000,1000000");
+  int repetitions = 5;
+  string output = "bench_results";
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    string arg(argv[i]);
+    if (arg == "-m")
+      meshPrefix = argv[i + 1];
+    else if (arg == "-l")
+      levels = parseList(argv[i + 1]);
+    else if (arg == "-g")
+      gridSizes = parseList(argv[i + 1]);
+    else if (arg == "-n")
+      repetitions = max(1, atoi(argv[i + 1]));
+    else if (arg == "-o")
+      output = argv[i + 1];
+    else
+    {
+      cerr << "Usage: " << argv[0] << " [-m mesh-prefix] [-l levels] [-g grid-points] [-n repetitions] [-o output-prefix]" << endl;
+      return 1;
+    }
+  }
+
+  char scratch[] = "/tmp/febenchXXXXXX";
+  if (!mkdtemp(scratch))
+  {
+    cerr << "Error: Could not create a scratch directory" << endl;
+    return 1;
+  }
+
+  vector<BenchResult> results;
+  double cMatrix[DIM * DIM] = {1, 0, 0, 1};
+  FEGrid mesh;
+  string error;
+  if (!levels.empty() && !mesh.load(meshPrefix + ".node", meshPrefix + ".elem", &error))
+  {
+    cerr << "Error: invalid mesh " << meshPrefix << " (" << error << ")" << endl;
+    rmdir(scratch);
+    return 1;
+  }
+
+  for (size_t l = 0; l < levels.size(); l++)
+  {
+    FEGrid base(mesh);
+    base.refine(levels[l]);
+    string prefix = string(scratch) + "/mesh" + to_string(levels[l]);
+    string label = "L" + to_string(levels[l]);
+    long numElts = base.getNumElts();
+    long numDofs = base.getNumInteriorNodes();
+
+    // Every timed load reads the same files, checked once here
+    FEGrid grid;
+    if (!base.write(prefix + ".node", prefix + ".elem") || !grid.load(prefix + ".node", prefix + ".elem", &error))
+    {
+      cerr << "Error: could not write and reload the level " << levels[l] << " mesh " << prefix << endl;
+      remove((prefix + ".node").c_str());
+      remove((prefix + ".elem").c_str());
+      rmdir(scratch);
+      return 1;
+    }
+    BenchResult load = {"mesh_load", label, numElts, numDofs, fileSize(prefix + ".node") + fileSize(prefix + ".elem"), 0, 0};
+    timeStage([] {}, [&] { FEGrid loaded; loaded.load(prefix + ".node", prefix + ".elem"); s_sink += loaded.getNumNodes(); },
+              repetitions, load);
+    results.push_back(load);
+
+    const double eltBytes = VERTICES * sizeof(Node) + sizeof(Element);
+
+    BenchResult gradient = {"gradient", label, numElts, numDofs, numElts * eltBytes, 0, 0};
+    timeStage([] {}, [&]
+    {
+      double g[DIM];
+      double sum = 0.0;
+      for (int i = 0; i < grid.getNumElts(); i++)
+      {
+        for (int m = 0; m < VERTICES; m++)
+        {
+          grid.gradient(g, i, m);
+          sum += g[0] + g[1];
+        }
+      }
+      s_sink += sum;
+    }, repetitions, gradient);
+    results.push_back(gradient);
+
+    BenchResult area = {"element_area", label, numElts, numDofs, numElts * eltBytes, 0, 0};
+    timeStage([] {}, [&]
+    {
+      double sum = 0.0;
+      for (int i = 0; i < grid.getNumElts(); i++)
+      {
+        sum += grid.elementArea(i);
+      }
+      s_sink += sum;
+    }, repetitions, area);
+    results.push_back(area);
+
+    // Symbolic phase (pattern and scatter map) and numeric phase are timed separately
+    FEAssembler* assembler = NULL;
+    BenchResult symbolic = {"assembly_symbolic", label, numElts, numDofs, 0, 0, 0};
+    timeStage([&] { delete assembler; assembler = NULL; },
+              [&] { assembler = new FEAssembler(grid, cMatrix); }, repetitions, symbolic);
+    BenchResult numeric = {"assembly_numeric", label, numElts, numDofs, 0, 0, 0};
+    timeStage([&] { delete assembler; assembler = new FEAssembler(grid, cMatrix); },
+              [&] { assembler->assemble(); }, repetitions, numeric);
+    double nnz = assembler->matrix().nnz();
+    symbolic.bytes = numElts * (eltBytes + VERTICES * VERTICES * sizeof(int)) + nnz * sizeof(int);
+    numeric.bytes = numElts * (eltBytes + VERTICES * VERTICES * (sizeof(int) + 2 * sizeof(double))) + nnz * sizeof(double);
+    results.push_back(symbolic);
+    results.push_back(numeric);
+
+    BenchResult spmv = {"spmv", label, numElts, numDofs, nnz * (sizeof(double) + sizeof(int)) + numDofs * 3 * sizeof(double), 0, 0};
+    vector<double> x(numDofs, 1.0), y(numDofs);
+    timeStage([] {}, [&] { assembler->matrix().multiply(x.data(), y.data()); s_sink += y[0]; }, repetitions, spmv);
+    results.push_back(spmv);
+
+    FEHeat heat(grid, *assembler, 1e-6, 0.0, FEHeat::LUMPED);
+    string snapshot = string(scratch) + "/snapshot.bin";
+    BenchResult snap = {"output_snapshot", label, numElts, numDofs, (grid.getNumNodes() + 1.0) * sizeof(double), 0, 0};
+    timeStage([] {}, [&] { heat.writeSnapshot(snapshot); }, repetitions, snap);
+    results.push_back(snap);
+    remove(snapshot.c_str());
+    delete assembler;
+
+    remove((prefix + ".node").c_str());
+    remove((prefix + ".elem").c_str());
+  }
+
+  for (size_t g = 0; g < gridSizes.size(); g++)
+  {
+    int m = max(3, gridSizes[g]);
+    string label = "N" + to_string(m);
+    const int steps = 10;
+
+    // Unit rod with m points and a stable explicit step (r = dt / dx^2 = 0.4)
+    double dx = 1.0 / (m - 1);
+    GridFn gridFn(1.0, dx, 0.4 * dx * dx);
+    gridFn.setVerbose(false);
+    gridFn.initialize();
+    BenchResult stencil = {"heat_stencil", label, (long)m * steps, (long)m * steps, 2.0 * m * steps * sizeof(double), 0, 0};
+    timeStage([] {}, [&] { for (int s = 0; s < steps; s++) gridFn.solve(); }, repetitions, stencil);
+    s_sink += gridFn.value(m / 2);
+    results.push_back(stencil);
+
+    RDomain domain(m, 1, 0.4, 0.4);
+    string gridFile = string(scratch) + "/grid.bin";
+    BenchResult grid = {"output_grid", label, m, 0, (m + 1.0) * sizeof(double), 0, 0};
+    timeStage([] {}, [&] { domain.PrintGrid(gridFile); }, repetitions, grid);
+    results.push_back(grid);
+    remove(gridFile.c_str());
+  }
+  rmdir(scratch);
+
+  FILE* csv = fopen((output + ".csv").c_str(), "w");
+  FILE* json = fopen((output + ".json").c_str(), "w");
+  if (!csv || !json)
+  {
+    cerr << "Error: Could not open " << output << ".csv/.json" << endl;
+    return 1;
+  }
+  const char* header = "stage,size,items,dofs,best_s,median_s,items_per_s,dofs_per_s,gb_per_s\n";
+  fputs(header, csv);
+  fputs(header, stdout);
+  fprintf(json, "[\n");
+  for (size_t r = 0; r < results.size(); r++)
+  {
+    const BenchResult& b = results[r];
+    double itemsPerSecond = b.items / b.best;
+    double dofsPerSecond = b.dofs / b.best;
+    double gbPerSecond = b.bytes / b.best / 1e9;
+    char line[256];
+    snprintf(line, sizeof(line), "%s,%s,%ld,%ld,%.6e,%.6e,%.6e,%.6e,%.4f\n", b.stage.c_str(), b.size.c_str(),
+             b.items, b.dofs, b.best, b.median, itemsPerSecond, dofsPerSecond, gbPerSecond);
+    fputs(line, csv);
+    fputs(line, stdout);
+    fprintf(json, "  {\"stage\": \"%s\", \"size\": \"%s\", \"items\": %ld, \"dofs\": %ld, \"best_s\": %.6e, "
+            "\"median_s\": %.6e, \"items_per_s\": %.6e, \"dofs_per_s\": %.6e, \"gb_per_s\": %.4f}%s\n",
+            b.stage.c_str(), b.size.c_str(), b.items, b.dofs, b.best, b.median, itemsPerSecond, dofsPerSecond,
+            gbPerSecond, (r + 1 < results.size()) ? "," : "");
+  }
+  fprintf(json, "]\n");
+  fclose(csv);
+  fclose(json);
+  // Printing the sink keeps the benchmarked results live and shows NaN or overflow in a kernel
+  cerr << "Checksum: " << s_sink << endl;
+  return 0;
+}
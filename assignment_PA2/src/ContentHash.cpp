@@ -0,0 +1,33 @@
+#include <cstdio>
+#include "ContentHash.h"
+
+const uint64_t ContentHash::s_offset;
+
+/**
+ * @brief Add the contents of files to a hash.
+ *
+ * @param a_files The files, in order.
+ * @param a_hash The hash so far; updated.
+ * @return False if a file could not be opened (a_hash is then undefined).
+ */
+bool ContentHash::addFiles(const vector<std::string>& a_files, uint64_t& a_hash)
+{
+  vector<unsigned char> buffer(1 << 16);
+  for (size_t f = 0; f < a_files.size(); f++)
+  {
+    FILE* fp = fopen(a_files[f].c_str(), "rb");
+    if (!fp)
+      return false;
+    size_t n;
+    while ((n = fread(buffer.data(), 1, buffer.size(), fp)) > 0)
+    {
+      for (size_t i = 0; i < n; i++)
+      {
+        a_hash = add(a_hash, buffer[i]);
+      }
+    }
+    fclose(fp);
+    a_hash = add(a_hash, 0x100);
+  }
+  return true;
+}
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cmath>
+#include "ErrorEstimator.h"
+#include "Profiler.h"
+
+/**
+ * @brief Constructor.
+ *
+ * @param a_grid The grid; must outlive the estimator.
+ */
+ErrorEstimator::ErrorEstimator(const FEGrid& a_grid) : m_grid(a_grid)
+{
+}
+
+/**
+ * @brief Gradient of the solution on an element.
+ *
+ * @param a_u Solution at the interior nodes.
+ * @param a_eltNumber The element number.
+ * @param a_gradient Array to store the gradient.
+ */
+void ErrorEstimator::elementGradient(const double* a_u, const int& a_eltNumber, double a_gradient[DIM]) const
+{
+  for (int idir = 0; idir < DIM; idir++)
+  {
+    a_gradient[idir] = 0.0;
+  }
+  for (int m = 0; m < VERTICES; m++)
+  {
+    int row = m_grid.getNode(a_eltNumber, m).getInteriorNodeID();
+    if (row < 0)
+      continue;
+    double shapeGradient[DIM];
+    m_grid.gradient(shapeGradient, a_eltNumber, m);
+    for (int idir = 0; idir < DIM; idir++)
+    {
+      a_gradient[idir] += a_u[row] * shapeGradient[idir];
+    }
+  }
+}
+
+/**
+ * @brief Compute the element indicators of a solution.
+ *
+ * @param a_u Solution at the interior nodes (boundary nodes are zero).
+ * @param a_eta Filled with the indicator of every element.
+ * @return The global estimate.
+ * G - grad u_h is linear on an element with nodal values d_i, and
+ * integral_T (sum_i phi_i d_i)^2 = area / 12 (sum_i d_i^2 + (sum_i d_i)^2)
+ * per component, so the indicators need no quadrature.
+ */
+double ErrorEstimator::estimate(const double* a_u, vector<double>& a_eta)
+{
+  PROFILE_SCOPE("zz_estimate");
+  const int numNodes = m_grid.getNumNodes();
+  const int numElts = m_grid.getNumElts();
+  vector<double> gradients(numElts * DIM), areas(numElts);
+  vector<double> weights(numNodes, 0.0);
+  m_recovered.assign(numNodes * DIM, 0.0);
+  for (int i = 0; i < numElts; i++)
+  {
+    elementGradient(a_u, i, &gradients[i * DIM]);
+    areas[i] = m_grid.elementArea(i);
+    for (int m = 0; m < VERTICES; m++)
+    {
+      int node = m_grid.element(i)[m];
+      weights[node] += areas[i];
+      for (int idir = 0; idir < DIM; idir++)
+      {
+        m_recovered[node * DIM + idir] += areas[i] * gradients[i * DIM + idir];
+      }
+    }
+  }
+  for (int node = 0; node < numNodes; node++)
+  {
+    for (int idir = 0; idir < DIM; idir++)
+    {
+      m_recovered[node * DIM + idir] /= weights[node];
+    }
+  }
+
+  a_eta.resize(numElts);
+  double total = 0.0;
+  for (int i = 0; i < numElts; i++)
+  {
+    double squared = 0.0;
+    for (int idir = 0; idir < DIM; idir++)
+    {
+      double sum = 0.0, sumSquares = 0.0;
+      for (int m = 0; m < VERTICES; m++)
+      {
+        double d = m_recovered[m_grid.element(i)[m] * DIM + idir] - gradients[i * DIM + idir];
+        sum += d;
+        sumSquares += d * d;
+      }
+      squared += areas[i] / 12.0 * (sumSquares + sum * sum);
+    }
+    a_eta[i] = sqrt(squared);
+    total += squared;
+  }
+  return sqrt(total);
+}
+
+/**
+ * @brief Get the recovered gradient at a node (valid after estimate()).
+ *
+ * @param a_node The node number.
+ * @param a_gradient Array to store the gradient.
+ */
+void ErrorEstimator::recoveredGradient(const int& a_node, double a_gradient[DIM]) const
+{
+  for (int idir = 0; idir < DIM; idir++)
+  {
+    a_gradient[idir] = m_recovered[a_node * DIM + idir];
+  }
+}
+
+/**
+ * @brief Doerfler (bulk) marking.
+ *
+ * @param a_eta Indicator of every element.
+ * @param a_theta Bulk fraction in (0, 1].
+ * @param a_marked Filled with the marked elements.
+ * @return The number of marked elements.
+ */
+int ErrorEstimator::mark(const vector<double>& a_eta, const double& a_theta, vector<int>& a_marked)
+{
+  vector<int> order(a_eta.size());
+  double total = 0.0;
+  for (size_t i = 0; i < a_eta.size(); i++)
+  {
+    order[i] = i;
+    total += a_eta[i] * a_eta[i];
+  }
+  sort(order.begin(), order.end(), [&a_eta](int a, int b) { return a_eta[a] > a_eta[b]; });
+  a_marked.clear();
+  double sum = 0.0;
+  for (size_t k = 0; k < order.size() && sum < a_theta * total; k++)
+  {
+    a_marked.push_back(order[k]);
+    sum += a_eta[order[k]] * a_eta[order[k]];
+  }
+  return a_marked.size();
+}
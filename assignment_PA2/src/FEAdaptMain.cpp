@@ -0,0 +1,282 @@
+#include "FEGrid.h"
+#include "FEAssembler.h"
+#include "ElementT.h"
+#include "ErrorEstimator.h"
+#include "PCGSolver.h"
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+using namespace std;
+
+static double s_sharpness = 400.0; /**< Decay rate alpha of the peak. */
+static const double s_peak[DIM] = {0.15, 0.1}; /**< Centre of the peak. */
+static const double s_scale = 1.0 / 0.0036; /**< Normalizes the boundary bubble to 1 at the plate centre. */
+
+/**
+ * @brief Manufactured solution with a sharp peak and its gradient.
+ *
+ * u = s x (0.6 - x) y (0.4 - y) exp(-alpha |x - x_p|^2), zero on the plate boundary.
+ *
+ * @param a_x Position.
+ * @param a_gradient If not NULL, filled with the gradient.
+ * @return The value.
+ */
+static double exactSolution(const double* a_x, double* a_gradient = NULL)
+{
+  double p = a_x[0] * (0.6 - a_x[0]), q = a_x[1] * (0.4 - a_x[1]);
+  double dx = a_x[0] - s_peak[0], dy = a_x[1] - s_peak[1];
+  double g = exp(-s_sharpness * (dx * dx + dy * dy));
+  if (a_gradient)
+  {
+    a_gradient[0] = s_scale * g * ((0.6 - 2 * a_x[0]) * q - 2 * s_sharpness * dx * p * q);
+    a_gradient[1] = s_scale * g * ((0.4 - 2 * a_x[1]) * p - 2 * s_sharpness * dy * p * q);
+  }
+  return s_scale * p * q * g;
+}
+
+/**
+ * @brief Source of the manufactured solution, -laplacian u.
+ *
+ * @param a_x Position.
+ * @return -s (g lap B + 2 grad B . grad g + B lap g) with B = p q and g the Gaussian.
+ */
+static double source(const double* a_x)
+{
+  double p = a_x[0] * (0.6 - a_x[0]), q = a_x[1] * (0.4 - a_x[1]);
+  double dx = a_x[0] - s_peak[0], dy = a_x[1] - s_peak[1];
+  double r2 = dx * dx + dy * dy;
+  double g = exp(-s_sharpness * r2);
+  double lapB = -2.0 * (p + q);
+  double gradBgradg = -2.0 * s_sharpness * (dx * (0.6 - 2 * a_x[0]) * q + dy * (0.4 - 2 * a_x[1]) * p);
+  double lapg = 4.0 * s_sharpness * (s_sharpness * r2 - 1.0);
+  return -s_scale * g * (lapB + 2.0 * gradBgradg + p * q * lapg);
+}
+
+/**
+ * @brief Seconds since a start time.
+ */
+static double secondsSince(const chrono::steady_clock::time_point& a_start)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - a_start).count();
+}
+
+/**
+ * @brief Result of one solve.
+ */
+struct Step
+{
+  int iterations; /**< PCG iterations. */
+  double estimate; /**< Global ZZ estimate, relative to the energy norm of the solution. */
+  double error; /**< True H1 seminorm error, relative to the exact seminorm. */
+  double solveSeconds; /**< Assembly and solve time. */
+};
+
+/**
+ * @brief Assemble and solve on a grid, then estimate and measure the error.
+ *
+ * @param a_grid The grid.
+ * @param a_u Initial guess on input, solution on output (one value per interior node).
+ * @param a_eta Filled with the element indicators.
+ * @return The step results.
+ */
+static Step solveAndEstimate(const FEGrid& a_grid, vector<double>& a_u, vector<double>& a_eta)
+{
+  typedef ElementT<Triangle, 1> Linear;
+  typedef ElementT<Triangle, 2> Quadratic;  // Only for its degree 4 quadrature rule
+  Step step;
+  const double identity[DIM * DIM] = {1.0, 0.0, 0.0, 1.0};
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  FEAssembler assembler(a_grid, identity);
+  assembler.assemble();
+  vector<double> load(a_grid.getNumInteriorNodes(), 0.0);
+  for (int e = 0; e < a_grid.getNumElts(); e++)
+  {
+    double x[VERTICES][DIM], f[VERTICES];
+    for (int m = 0; m < VERTICES; m++)
+    {
+      a_grid.getNode(e, m).getPosition(x[m]);
+    }
+    ElementKernel<Linear>::load(x, source, f);
+    for (int m = 0; m < VERTICES; m++)
+    {
+      int row = a_grid.getNode(e, m).getInteriorNodeID();
+      if (row >= 0)
+        load[row] += f[m];
+    }
+  }
+  PCGSolver solver(assembler.matrix(), PCGSolver::IC0);
+  step.iterations = solver.solve(load.data(), a_u.data(), 1e-10);
+  step.solveSeconds = secondsSince(start);
+
+  // Energy norm of the discrete solution, sqrt(u^T A u)
+  vector<double> au(a_u.size());
+  assembler.matrix().multiply(a_u.data(), au.data());
+  double energy = 0.0;
+  for (size_t i = 0; i < a_u.size(); i++)
+  {
+    energy += a_u[i] * au[i];
+  }
+  ErrorEstimator estimator(a_grid);
+  step.estimate = estimator.estimate(a_u.data(), a_eta) / sqrt(energy);
+
+  // |u - u_h|_H1 and |u|_H1 with the degree 4 rule
+  double error = 0.0, norm = 0.0;
+  for (int e = 0; e < a_grid.getNumElts(); e++)
+  {
+    double x[VERTICES][DIM], gradient[DIM] = {0.0, 0.0};
+    for (int m = 0; m < VERTICES; m++)
+    {
+      a_grid.getNode(e, m).getPosition(x[m]);
+      int row = a_grid.getNode(e, m).getInteriorNodeID();
+      double shapeGradient[DIM];
+      a_grid.gradient(shapeGradient, e, m);
+      for (int idir = 0; idir < DIM; idir++)
+      {
+        gradient[idir] += (row < 0 ? 0.0 : a_u[row]) * shapeGradient[idir];
+      }
+    }
+    double area = a_grid.elementArea(e);
+    for (int k = 0; k < Quadratic::numLoadPoints; k++)
+    {
+      const double* xi = Quadratic::loadPoints[k];
+      double point[DIM], exact[DIM];
+      for (int idir = 0; idir < DIM; idir++)
+      {
+        point[idir] = x[0][idir] + (x[1][idir] - x[0][idir]) * xi[0] + (x[2][idir] - x[0][idir]) * xi[1];
+      }
+      exactSolution(point, exact);
+      double weight = 2.0 * area * Quadratic::loadWeights[k];
+      for (int idir = 0; idir < DIM; idir++)
+      {
+        error += weight * (exact[idir] - gradient[idir]) * (exact[idir] - gradient[idir]);
+        norm += weight * exact[idir] * exact[idir];
+      }
+    }
+  }
+  step.error = sqrt(error / norm);
+  return step;
+}
+
+/**
+ * @brief Print one row of a refinement table.
+ */
+static void printStep(const int& a_cycle, const FEGrid& a_grid, const Step& a_step)
+{
+  cout << setw(6) << a_cycle << setw(10) << a_grid.getNumElts() << setw(10) << a_grid.getNumInteriorNodes()
+       << setw(8) << a_step.iterations << setw(12) << scientific << setprecision(3) << a_step.estimate << setw(12)
+       << a_step.error << setw(8) << fixed << setprecision(2) << a_step.estimate / a_step.error << setw(12)
+       << setprecision(3) << a_step.solveSeconds * 1e3 << " ms" << endl;
+}
+
+/**
+ * @brief Print the header of a refinement table.
+ */
+static void printHeader(const string& a_title)
+{
+  cout << endl << a_title << endl;
+  cout << setw(6) << "cycle" << setw(10) << "elements" << setw(10) << "rows" << setw(8) << "iters" << setw(12)
+       << "estimate" << setw(12) << "H1 error" << setw(8) << "eff." << setw(15) << "solve" << endl;
+}
+
+/**
+ * @brief Main function comparing adaptive and uniform refinement.
+ *
+ * Solves -laplacian u = f on the plate for a solution with a sharp peak. The
+ * adaptive loop solves, estimates with ErrorEstimator, marks (Doerfler) and
+ * bisects (FEGrid::bisect) until the relative estimate reaches the tolerance;
+ * the previous solution, interpolated to the new nodes, is the initial guess
+ * of the next solve. The uniform loop refines the whole grid until it reaches
+ * the same tolerance. Both report the true relative H1 error and the
+ * effectivity (estimate / error). The adaptive loop also stops if a cycle
+ * adds no nodes.
+ *
+ * @param argc The number of command-line arguments.
+ * @param argv mesh prefix, and optionally the relative tolerance (default 0.05),
+ * the marking fraction theta (default 0.5) and the peak sharpness alpha (default 400).
+ *
+ * @return Returns 0 on successful execution, 1 for bad arguments or an invalid mesh.
+ */
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    cerr << "Usage: " << argv[0] << " <mesh-prefix> [tolerance] [theta] [sharpness]" << endl;
+    return 1;
+  }
+  string prefix(argv[1]);
+  double tolerance = (argc > 2) ? atof(argv[2]) : 0.05;
+  double theta = (argc > 3) ? atof(argv[3]) : 0.5;
+  if (argc > 4)
+    s_sharpness = atof(argv[4]);
+  if (!(tolerance > 0.0) || !(theta > 0.0 && theta <= 1.0))
+  {
+    cerr << "Error: the tolerance must be positive and theta in (0, 1]" << endl;
+    return 1;
+  }
+  const int maxRows = 4000000;
+
+  FEGrid grid;
+  string error;
+  if (!grid.load(prefix + ".node", prefix + ".elem", &error))
+  {
+    cerr << "Error: invalid mesh " << prefix << " (" << error << ")" << endl;
+    return 1;
+  }
+  const FEGrid base(grid);
+  printHeader("Adaptive (ZZ estimate, Doerfler theta = " + to_string(theta) + ", newest-vertex bisection)");
+  vector<double> u(grid.getNumInteriorNodes(), 0.0), eta;
+  vector<int> marked, parents;
+  Step step;
+  double adaptiveSeconds = 0.0;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (int cycle = 0;; cycle++)
+  {
+    step = solveAndEstimate(grid, u, eta);
+    printStep(cycle, grid, step);
+    if (step.estimate <= tolerance || grid.getNumInteriorNodes() > maxRows)
+      break;
+    ErrorEstimator::mark(eta, theta, marked);
+    int numNodes = grid.getNumNodes();
+    grid.bisect(marked, &parents);
+    if (grid.getNumNodes() == numNodes)
+      break;
+    // Existing rows keep their numbers; new rows interpolate their edge
+    u.resize(grid.getNumInteriorNodes(), 0.0);
+    for (int k = 0; numNodes + k < grid.getNumNodes(); k++)
+    {
+      int row = grid.node(numNodes + k).getInteriorNodeID();
+      if (row < 0)
+        continue;
+      int a = grid.node(parents[2 * k]).getInteriorNodeID(), b = grid.node(parents[2 * k + 1]).getInteriorNodeID();
+      u[row] = 0.5 * ((a < 0 ? 0.0 : u[a]) + (b < 0 ? 0.0 : u[b]));
+    }
+  }
+  adaptiveSeconds = secondsSince(start);
+  int adaptiveRows = grid.getNumInteriorNodes();
+  double adaptiveSolve = step.solveSeconds;
+
+  printHeader("Uniform (red refinement)");
+  start = chrono::steady_clock::now();
+  for (int level = 0;; level++)
+  {
+    FEGrid uniform(base);
+    uniform.refine(level);
+    vector<double> v(uniform.getNumInteriorNodes(), 0.0);
+    step = solveAndEstimate(uniform, v, eta);
+    printStep(level, uniform, step);
+    if (step.estimate <= tolerance || uniform.getNumInteriorNodes() > maxRows)
+    {
+      cout << endl << "Tolerance " << tolerance << ": adaptive " << adaptiveRows << " rows (final solve "
+           << setprecision(3) << adaptiveSolve * 1e3 << " ms, whole loop " << adaptiveSeconds * 1e3 << " ms), uniform "
+           << uniform.getNumInteriorNodes() << " rows (final solve " << step.solveSeconds * 1e3 << " ms, whole loop "
+           << secondsSince(start) * 1e3 << " ms)" << endl;
+      break;
+    }
+  }
+  return 0;
+}
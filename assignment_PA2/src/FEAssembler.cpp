@@ -0,0 +1,401 @@
+#include <cassert>
+#include <algorithm>
+#include <fstream>
+#include <cmath>
+#include "FEAssembler.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#ifdef CBLAS_DGEMM
+#include <cblas.h>
+#endif
+
+/** Elements per task when the first assembly runs on a ThreadPool. */
+static const int s_elementGrain = 4096;
+
+/**
+ * @brief Constructor building the pattern and scatter map for a grid.
+ *
+ * @param a_grid The grid; must outlive the assembler.
+ * @param a_conductivity Conductivity tensor (row major DIM x DIM) given to every element.
+ * Every element starts out dirty, so the first assemble() integrates the whole grid.
+ */
+FEAssembler::FEAssembler(const FEGrid& a_grid, const double a_conductivity[DIM * DIM])
+  : m_grid(a_grid), m_assembled(false)
+{
+  PROFILE_SCOPE("assembly_symbolic");
+  int numElts = m_grid.getNumElts();
+  int numRows = m_grid.getNumInteriorNodes();
+
+  // Collect the columns coupled to each interior row
+  vector<vector<int> > columns(numRows);
+  for (int i = 0; i < numElts; i++)
+  {
+    for (int m = 0; m < VERTICES; m++)
+    {
+      int row = m_grid.getNode(i, m).getInteriorNodeID();
+      if (row < 0)
+        continue;
+      for (int n = 0; n < VERTICES; n++)
+      {
+        int col = m_grid.getNode(i, n).getInteriorNodeID();
+        if (col >= 0)
+          columns[row].push_back(col);
+      }
+    }
+  }
+
+  vector<int> rowPtr(numRows + 1, 0);
+  vector<int> colInd;
+  for (int row = 0; row < numRows; row++)
+  {
+    sort(columns[row].begin(), columns[row].end());
+    columns[row].erase(unique(columns[row].begin(), columns[row].end()), columns[row].end());
+    colInd.insert(colInd.end(), columns[row].begin(), columns[row].end());
+    rowPtr[row + 1] = colInd.size();
+    vector<int>().swap(columns[row]);
+  }
+  m_matrix = SparseMatrix(rowPtr, colInd);
+
+  // Map every element-local entry to its slot in the global matrix
+  m_scatter.resize(numElts * VERTICES * VERTICES);
+  for (int i = 0; i < numElts; i++)
+  {
+    for (int m = 0; m < VERTICES; m++)
+    {
+      int row = m_grid.getNode(i, m).getInteriorNodeID();
+      for (int n = 0; n < VERTICES; n++)
+      {
+        int col = m_grid.getNode(i, n).getInteriorNodeID();
+        m_scatter[(i * VERTICES + m) * VERTICES + n] = (row < 0 || col < 0) ? -1 : m_matrix.find(row, col);
+      }
+    }
+  }
+
+  m_elementMatrices.assign(numElts * VERTICES * VERTICES, 0.0);
+  m_conductivity.resize(numElts * DIM * DIM);
+  m_isDirty.assign(numElts, false);
+  for (int i = 0; i < numElts; i++)
+  {
+    setConductivity(i, a_conductivity);
+  }
+  PROFILE_COUNT("bytes_allocated", m_matrix.nnz() * (sizeof(int) + sizeof(double)) + m_scatter.size() * sizeof(int) +
+                                   m_elementMatrices.size() * sizeof(double) + m_conductivity.size() * sizeof(double));
+}
+
+/**
+ * @brief Constructor adopting a matrix assembled elsewhere (see AssemblyPipeline).
+ *
+ * @param a_grid The grid; must outlive the assembler.
+ * @param a_conductivity Conductivity tensor (row major DIM x DIM) the matrix was assembled with.
+ * @param a_matrix The assembled matrix; swapped in.
+ * @param a_scatter The scatter map (as m_scatter); swapped in.
+ * @param a_elementMatrices The element stiffness matrices of every element; swapped in.
+ */
+FEAssembler::FEAssembler(const FEGrid& a_grid, const double a_conductivity[DIM * DIM], SparseMatrix& a_matrix,
+                         vector<int>& a_scatter, vector<double>& a_elementMatrices)
+  : m_grid(a_grid), m_matrix(std::move(a_matrix)), m_assembled(true)
+{
+  int numElts = m_grid.getNumElts();
+  assert((int)a_scatter.size() == numElts * VERTICES * VERTICES);
+  assert(a_elementMatrices.size() == a_scatter.size());
+  m_scatter.swap(a_scatter);
+  m_elementMatrices.swap(a_elementMatrices);
+  m_conductivity.resize(numElts * DIM * DIM);
+  for (int i = 0; i < numElts; i++)
+  {
+    for (int k = 0; k < DIM * DIM; k++)
+    {
+      m_conductivity[i * DIM * DIM + k] = a_conductivity[k];
+    }
+  }
+  m_isDirty.assign(numElts, false);
+}
+
+/**
+ * @brief Set the conductivity tensor of one element and mark it dirty.
+ *
+ * @param a_eltNumber The element number.
+ * @param a_conductivity Conductivity tensor (row major DIM x DIM).
+ */
+void FEAssembler::setConductivity(const int& a_eltNumber, const double a_conductivity[DIM * DIM])
+{
+  for (int k = 0; k < DIM * DIM; k++)
+  {
+    m_conductivity[a_eltNumber * DIM * DIM + k] = a_conductivity[k];
+  }
+  if (!m_isDirty[a_eltNumber])
+  {
+    m_isDirty[a_eltNumber] = true;
+    m_dirty.push_back(a_eltNumber);
+  }
+}
+
+/**
+ * @brief Read element conductivities from a file.
+ *
+ * @param a_fileName The file name.
+ * @return The number of entries read, -1 if the file could not be opened, or -2 if it
+ * is truncated or malformed or names an element out of range.
+ * The format mirrors the .node/.elem files: a count, then "element kxx kxy kyx kyy" per line.
+ */
+int FEAssembler::readConductivities(const std::string& a_fileName)
+{
+  ifstream materials(a_fileName.c_str());
+  if (!materials)
+  {
+    return -1;
+  }
+  int count = 0;
+  materials >> count;
+  if (!materials || count < 0)
+  {
+    return -2;
+  }
+  vector<int> cellIDs(count);
+  vector<double> values(count * DIM * DIM);
+  for (int i = 0; i < count; i++)
+  {
+    materials >> cellIDs[i];
+    for (int k = 0; k < DIM * DIM; k++)
+    {
+      materials >> values[i * DIM * DIM + k];
+    }
+    cellIDs[i]--;
+    if (!materials || cellIDs[i] < 0 || cellIDs[i] >= m_grid.getNumElts())
+    {
+      return -2;
+    }
+  }
+  for (int i = 0; i < count; i++)
+  {
+    setConductivity(cellIDs[i], &values[i * DIM * DIM]);
+  }
+  return count;
+}
+
+/**
+ * @brief Bring the global matrix up to date.
+ *
+ * @param a_pool Pool that integrates chunks of elements of the first call in parallel, or NULL.
+ * @return The number of elements integrated.
+ * The first call scatters all cached element matrices in one streaming pass.
+ * Later calls add (new - old) of each dirty element at its precomputed slots.
+ */
+int FEAssembler::assemble(ThreadPool* a_pool)
+{
+  int numIntegrated = m_dirty.size();
+  double* values = m_matrix.values();
+
+  if (!m_assembled)
+  {
+    {
+      PROFILE_SCOPE("element_kernel");
+      // Each element writes only its own cached matrix, so chunks are independent
+      auto integrateRange = [this](int a_first, int a_last) {
+        for (int d = a_first; d < a_last; d++)
+        {
+          integrate(m_dirty[d], &m_elementMatrices[m_dirty[d] * VERTICES * VERTICES]);
+        }
+      };
+      if (a_pool)
+        a_pool->parallelFor(0, m_dirty.size(), s_elementGrain, integrateRange);
+      else
+        integrateRange(0, m_dirty.size());
+    }
+    PROFILE_SCOPE("scatter");
+    m_matrix.zero();
+    const int numEntries = m_scatter.size();
+    for (int k = 0; k < numEntries; k++)
+    {
+      if (m_scatter[k] >= 0)
+        values[m_scatter[k]] += m_elementMatrices[k];
+    }
+    m_assembled = true;
+  }
+  else
+  {
+    PROFILE_SCOPE("delta_reassembly");
+    double kij[VERTICES * VERTICES];
+    for (size_t d = 0; d < m_dirty.size(); d++)
+    {
+      int offset = m_dirty[d] * VERTICES * VERTICES;
+      integrate(m_dirty[d], kij);
+      for (int k = 0; k < VERTICES * VERTICES; k++)
+      {
+        if (m_scatter[offset + k] >= 0)
+          values[m_scatter[offset + k]] += kij[k] - m_elementMatrices[offset + k];
+        m_elementMatrices[offset + k] = kij[k];
+      }
+    }
+  }
+
+  for (size_t d = 0; d < m_dirty.size(); d++)
+  {
+    m_isDirty[m_dirty[d]] = false;
+  }
+  m_dirty.clear();
+  PROFILE_COUNT("elements_integrated", numIntegrated);
+  return numIntegrated;
+}
+
+/**
+ * @brief Get the assembled global matrix over the interior nodes.
+ *
+ * @return Reference to the matrix.
+ */
+const SparseMatrix& FEAssembler::matrix() const
+{
+  return m_matrix;
+}
+
+/**
+ * @brief Assemble the consistent mass matrix over the interior nodes.
+ *
+ * @param a_mass Matrix to fill; its pattern is replaced by the stiffness pattern.
+ * The linear triangle mass matrix is area / 12 * (1 + delta_mn).
+ */
+void FEAssembler::assembleMass(SparseMatrix& a_mass) const
+{
+  PROFILE_SCOPE("mass_matrix");
+  a_mass = m_matrix;
+  a_mass.zero();
+  double* values = a_mass.values();
+  for (int i = 0; i < m_grid.getNumElts(); i++)
+  {
+    double area = m_grid.elementArea(i);
+    const int* scatter = &m_scatter[i * VERTICES * VERTICES];
+    for (int m = 0; m < VERTICES; m++)
+    {
+      for (int n = 0; n < VERTICES; n++)
+      {
+        if (scatter[m * VERTICES + n] >= 0)
+          values[scatter[m * VERTICES + n]] += area / 12.0 * ((m == n) ? 2.0 : 1.0);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Assemble the lumped (row sum) mass matrix over the interior nodes.
+ *
+ * @param a_mass Vector of size getNumInteriorNodes() to fill with the diagonal.
+ * Each vertex of a linear triangle receives a third of the element area.
+ */
+void FEAssembler::assembleLumpedMass(double* a_mass) const
+{
+  assembleLoad(1.0, a_mass);
+}
+
+/**
+ * @brief Assemble the load vector of a uniform source term.
+ *
+ * @param a_source Source value f.
+ * @param a_load Vector of size getNumInteriorNodes() to fill with the integral of f N_i.
+ */
+void FEAssembler::assembleLoad(const double& a_source, double* a_load) const
+{
+  PROFILE_SCOPE("load_vector");
+  fill(a_load, a_load + m_matrix.numRows(), 0.0);
+  for (int i = 0; i < m_grid.getNumElts(); i++)
+  {
+    double share = a_source * m_grid.elementArea(i) / VERTICES;
+    for (int m = 0; m < VERTICES; m++)
+    {
+      int row = m_grid.getNode(i, m).getInteriorNodeID();
+      if (row >= 0)
+        a_load[row] += share;
+    }
+  }
+}
+
+/**
+ * @brief Get the cached element stiffness matrix of an element.
+ *
+ * @param a_eltNumber The element number.
+ * @return Pointer to VERTICES x VERTICES values (row major).
+ */
+const double* FEAssembler::elementMatrix(const int& a_eltNumber) const
+{
+  return &m_elementMatrices[a_eltNumber * VERTICES * VERTICES];
+}
+
+/**
+ * @brief Compute the element stiffness matrix area * B^T C B.
+ *
+ * @param a_eltNumber The element number.
+ * @param a_kij Array to store the VERTICES x VERTICES matrix (row major).
+ */
+void FEAssembler::integrate(const int& a_eltNumber, double a_kij[VERTICES * VERTICES]) const
+{
+  double x[VERTICES][DIM];
+  for (int m = 0; m < VERTICES; m++)
+  {
+    m_grid.getNode(a_eltNumber, m).getPosition(x[m]);
+  }
+  elementStiffness(x, &m_conductivity[a_eltNumber * DIM * DIM], a_kij);
+}
+
+/**
+ * @brief Compute the stiffness matrix area * B^T C B of a linear triangle.
+ *
+ * @param a_x Coordinates of the VERTICES vertices.
+ * @param a_conductivity Conductivity tensor (row major DIM x DIM).
+ * @param a_kij Array to store the VERTICES x VERTICES matrix (row major).
+ * B^T holds the gradients of the shape functions of all vertices (the same
+ * formula as FEGrid::gradient), so the result also contains boundary
+ * rows/columns; those are dropped by the scatter map.
+ */
+void FEAssembler::elementStiffness(const double a_x[VERTICES][DIM], const double a_conductivity[DIM * DIM],
+                                   double a_kij[VERTICES * VERTICES])
+{
+  double bMatrixTrans[VERTICES * DIM];  /**< Gradients of the shape functions, one row per vertex */
+  double kijpartial[VERTICES * DIM];  /**< B^T * C */
+  const double* cMatrix = a_conductivity;
+  double det = 0.0;
+
+  for (int m = 0; m < VERTICES; m++)
+  {
+    double dx[VERTICES-1][DIM];
+    for (int ivert = 0; ivert < VERTICES-1; ivert++)
+    {
+      for (int idir = 0; idir < DIM; idir++)
+      {
+        dx[ivert][idir] = a_x[(m + ivert + 1) % VERTICES][idir] - a_x[m][idir];
+      }
+    }
+    det = dx[0][0] * dx[1][1] - dx[1][0] * dx[0][1];
+    bMatrixTrans[m * DIM + 0] = (-(dx[1][1] - dx[0][1]) / det);
+    bMatrixTrans[m * DIM + 1] = ((dx[1][0] - dx[0][0]) / det);
+  }
+  double area = fabs(det) / 2;
+
+#ifndef CBLAS_DGEMM
+  // Compute B^T * C (VERTICES x DIM * DIM x DIM)
+  for (int m = 0; m < VERTICES; m++)
+  {
+    for (int n = 0; n < DIM; n++)
+    {
+      kijpartial[m * DIM + n] = 0.0;
+      for (int r = 0; r < DIM; r++)
+      {
+        kijpartial[m * DIM + n] += bMatrixTrans[m * DIM + r] * cMatrix[r * DIM + n];
+      }
+    }
+  }
+#else
+  cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, VERTICES, DIM, DIM, 1.0, bMatrixTrans, DIM, cMatrix, DIM, 0.0, kijpartial, DIM);
+#endif
+
+  for (int m = 0; m < VERTICES; m++)
+  {
+    for (int n = 0; n < VERTICES; n++)
+    {
+      double sum = 0.0;
+      for (int r = 0; r < DIM; r++)
+      {
+        sum += kijpartial[m * DIM + r] * bMatrixTrans[n * DIM + r];
+      }
+      a_kij[m * VERTICES + n] = area * sum;
+    }
+  }
+}
@@ -7,16 +7,18 @@
 #include<iostream>
 #include<iomanip>
 #include<limits>
+#include<algorithm>
 #include "Node.h"   
 #include "Element.h"
 #include "FEGrid.h"
+#include "Profiler.h"
 
 /**
  * @brief Default constructor for the FEGrid class.
  * 
  * Initializes the grid with default values, including setting the number of interior nodes to zero.
  */
-FEGrid::FEGrid() : m_numInteriorNodes(0)
+FEGrid::FEGrid() : m_numInteriorNodes(0), m_bisectionLabels(false)
 {
 }
 
@@ -28,7 +30,9 @@ FEGrid::FEGrid() : m_numInteriorNodes(0)
  * This constructor reads the node and element files, creates nodes, and stores them in the grid.
  */
 FEGrid::FEGrid(const std::string& a_nodeFileName, const std::string& a_elementFileName)
+  : m_bisectionLabels(false)
 {
+  PROFILE_SCOPE("mesh_parse");
   // Reading node data from the specified file
   ifstream nodes(a_nodeFileName.c_str());
   int ncount;
@@ -43,23 +47,25 @@ FEGrid::FEGrid(const std::string& a_nodeFileName, const std::string& a_elementFi
     int vertex;
     std::string tmp[DIM];
     double x[DIM];
-    bool isInterior = true;
 
     nodes >> vertex >> tmp[0] >> tmp[1];
     x[0] = atof(tmp[0].c_str());
     x[1] = atof(tmp[1].c_str());
 
-    // Determine if the node is on the boundary or an interior node
-    if (((tmp[0].compare("0.60000")) == 0) || ((tmp[1].compare("0.40000")) == 0) || (x[0] == 0) || (x[1] == 0)) {
-      isInterior = false;
-    }
-    else
+    vertex--;
+    m_nodes[vertex] = Node(x, -1, true);
+  }
+
+  // Determine which nodes are on the boundary and number the interior ones
+  {
+    PROFILE_SCOPE("boundary_detection");
+    for (int i = 0; i < ncount; i++)
     {
-      m_numInteriorNodes++;
+      double x[DIM];
+      m_nodes[i].getPosition(x);
+      m_nodes[i] = Node(x, -1, !isBoundaryPosition(x));
     }
-    
-    vertex--;
-    m_nodes[vertex] = Node(x, vertex, isInterior);
+    numberInteriorNodes();
   }
 
   // Reading element data from the specified file
@@ -78,6 +84,168 @@ FEGrid::FEGrid(const std::string& a_nodeFileName, const std::string& a_elementFi
     cellID--;
     m_elements[cellID] = Element(vert);
   }
+  PROFILE_COUNT("nodes_read", ncount);
+  PROFILE_COUNT("elements_read", ncell);
+  PROFILE_COUNT("bytes_allocated", ncount * sizeof(Node) + ncell * sizeof(Element));
+}
+
+/**
+ * @brief Read the grid from node and element files, validating their contents.
+ *
+ * @param a_nodeFileName The node file.
+ * @param a_elementFileName The element file.
+ * @param a_error If not NULL, set to a description of the first problem found.
+ * @return True if both files were read and valid; otherwise the grid is unchanged.
+ */
+bool FEGrid::load(const std::string& a_nodeFileName, const std::string& a_elementFileName, std::string* a_error)
+{
+  PROFILE_SCOPE("mesh_parse");
+  std::string error;
+  ifstream nodes(a_nodeFileName.c_str());
+  ifstream elements(a_elementFileName.c_str());
+  int ncount = 0, ncell = 0;
+  vector<Node> newNodes;
+  vector<Element> newElements;
+  if (!nodes || !elements)
+    error = "cannot open the mesh files";
+  else if (!(nodes >> ncount) || ncount <= 0)
+    error = "bad node count";
+
+  vector<char> seen;
+  if (error.empty())
+  {
+    newNodes.resize(ncount);
+    seen.assign(ncount, 0);
+  }
+  for (int i = 0; error.empty() && i < ncount; i++)
+  {
+    int vertex;
+    double x[DIM];
+    if (!(nodes >> vertex >> x[0] >> x[1]))
+      error = "truncated or malformed node file";
+    else if (vertex < 1 || vertex > ncount || seen[vertex - 1])
+      error = "node ID out of range or repeated";
+    else if (!std::isfinite(x[0]) || !std::isfinite(x[1]))
+      error = "non-finite node coordinate";
+    else
+    {
+      seen[vertex - 1] = 1;
+      newNodes[vertex - 1] = Node(x, -1, !isBoundaryPosition(x));
+    }
+  }
+
+  if (error.empty() && (!(elements >> ncell) || ncell <= 0))
+    error = "bad element count";
+  if (error.empty())
+  {
+    newElements.resize(ncell);
+    seen.assign(ncell, 0);
+  }
+  for (int i = 0; error.empty() && i < ncell; i++)
+  {
+    int cellID, vert[VERTICES];
+    if (!(elements >> cellID >> vert[0] >> vert[1] >> vert[2]))
+    {
+      error = "truncated or malformed element file";
+      break;
+    }
+    if (cellID < 1 || cellID > ncell || seen[cellID - 1])
+    {
+      error = "cell ID out of range or repeated";
+      break;
+    }
+    for (int ivert = 0; ivert < VERTICES; ivert++)
+    {
+      if (vert[ivert] < 1 || vert[ivert] > ncount)
+        error = "vertex ID out of range";
+      vert[ivert]--;
+    }
+    seen[cellID - 1] = 1;
+    newElements[cellID - 1] = Element(vert);
+  }
+
+  if (!error.empty())
+  {
+    if (a_error)
+      *a_error = error;
+    return false;
+  }
+  m_nodes.swap(newNodes);
+  m_elements.swap(newElements);
+  m_bisectionLabels = false;
+  numberInteriorNodes();
+  PROFILE_COUNT("nodes_read", ncount);
+  PROFILE_COUNT("elements_read", ncell);
+  return true;
+}
+
+/**
+ * @brief Constructor adopting nodes and elements built elsewhere (see AssemblyPipeline).
+ *
+ * @param a_nodes Nodes with their interior flags; swapped in and left empty.
+ * @param a_elements Elements; swapped in and left empty.
+ */
+FEGrid::FEGrid(vector<Node>& a_nodes, vector<Element>& a_elements)
+  : m_numInteriorNodes(0), m_bisectionLabels(false)
+{
+  m_nodes.swap(a_nodes);
+  m_elements.swap(a_elements);
+  numberInteriorNodes();
+}
+
+/**
+ * @brief Check if a position lies on the boundary of the plate [0, 0.6] x [0, 0.4].
+ *
+ * @param a_x The position.
+ * @return True on the boundary.
+ * Mesh files may write the same coordinate with different digits (fine.node
+ * uses "0.60000"), so the comparison is numeric with a small tolerance.
+ */
+bool FEGrid::isBoundaryPosition(const double a_x[DIM])
+{
+  const double tolerance = 1e-9;
+  return (fabs(a_x[0]) < tolerance) || (fabs(a_x[1]) < tolerance) ||
+         (fabs(a_x[0] - 0.6) < tolerance) || (fabs(a_x[1] - 0.4) < tolerance);
+}
+
+/**
+ * @brief Write the grid as .node/.elem files readable by the file constructor.
+ *
+ * @param a_nodeFileName The node file to write.
+ * @param a_elementFileName The element file to write.
+ * @return True on success.
+ */
+bool FEGrid::write(const std::string& a_nodeFileName, const std::string& a_elementFileName) const
+{
+  PROFILE_SCOPE("mesh_write");
+  FILE* nodes = fopen(a_nodeFileName.c_str(), "w");
+  FILE* elements = fopen(a_elementFileName.c_str(), "w");
+  if (!nodes || !elements)
+  {
+    if (nodes)
+      fclose(nodes);
+    if (elements)
+      fclose(elements);
+    return false;
+  }
+
+  fprintf(nodes, "%d\n", (int)m_nodes.size());
+  for (size_t i = 0; i < m_nodes.size(); i++)
+  {
+    double x[DIM];
+    m_nodes[i].getPosition(x);
+    fprintf(nodes, "%d %.17g %.17g\n", (int)i + 1, x[0], x[1]);
+  }
+
+  fprintf(elements, "%d\n", (int)m_elements.size());
+  for (size_t i = 0; i < m_elements.size(); i++)
+  {
+    const Element& e = m_elements[i];
+    fprintf(elements, "%d %d %d %d\n", (int)i + 1, e[0] + 1, e[1] + 1, e[2] + 1);
+  }
+  fclose(nodes);
+  fclose(elements);
+  return true;
 }
 
 /**
@@ -110,7 +278,7 @@ void FEGrid::gradient(double a_gradient[DIM], const int& a_eltNumber, const int&
   // Calculate the determinant and gradient for 2D triangles
   double det = dx[0][0] * dx[1][1] - dx[1][0] * dx[0][1];
   a_gradient[0] = (-(dx[1][1] - dx[0][1]) / det);
-  a_gradient[1] = (-(dx[1][0] - dx[0][0]) / det);
+  a_gradient[1] = ((dx[1][0] - dx[0][0]) / det);
 }
 
 /**
@@ -208,3 +376,352 @@ const Node& FEGrid::node(int i) const
   return m_nodes[i];
 }
 
+
+/**
+ * @brief Number the interior nodes in global node order.
+ *
+ * These numbers are the rows of the global matrix; boundary nodes get -1.
+ */
+void FEGrid::numberInteriorNodes()
+{
+  int interiorNodeID = 0;
+  for (size_t i = 0; i < m_nodes.size(); i++)
+  {
+    double x[DIM];
+    m_nodes[i].getPosition(x);
+    bool isInterior = m_nodes[i].isInterior();
+    m_nodes[i] = Node(x, isInterior ? interiorNodeID++ : -1, isInterior);
+  }
+  m_numInteriorNodes = interiorNodeID;
+}
+
+/**
+ * @brief Uniformly refine the grid in memory.
+ *
+ * @param a_levels The number of refinement levels.
+ */
+void FEGrid::refine(const int& a_levels)
+{
+  PROFILE_SCOPE("refine");
+  for (int level = 0; level < a_levels; level++)
+  {
+    refineOnce();
+  }
+  numberInteriorNodes();
+  if (a_levels > 0)
+    m_bisectionLabels = false;
+}
+
+/**
+ * @brief Perform one level of red refinement.
+ *
+ * Edges are numbered without hashing: every edge (a, b), a < b, is stored in the
+ * row of its lower vertex of a CSR node-to-node table. After sorting each row,
+ * the position of b in row a is the edge number, and the midpoint of edge e
+ * becomes node numNodes + e. Duplicate entries before compression count the
+ * elements sharing an edge, which gives the boundary tag of the midpoint.
+ * The loops over rows and elements are independent and run in parallel when
+ * built with OpenMP.
+ */
+void FEGrid::refineOnce()
+{
+  const int numNodes = m_nodes.size();
+  const int numElts = m_elements.size();
+
+  // Count the edge entries of each lower vertex (with duplicates)
+  vector<int> rowPtr(numNodes + 1, 0);
+  for (int i = 0; i < numElts; i++)
+  {
+    const Element& e = m_elements[i];
+    for (int ivert = 0; ivert < VERTICES; ivert++)
+    {
+      rowPtr[min(e[ivert], e[(ivert + 1) % VERTICES]) + 1]++;
+    }
+  }
+  for (int a = 0; a < numNodes; a++)
+  {
+    rowPtr[a + 1] += rowPtr[a];
+  }
+
+  vector<int> next(rowPtr.begin(), rowPtr.end() - 1);
+  vector<int> upper(rowPtr[numNodes]);
+  for (int i = 0; i < numElts; i++)
+  {
+    const Element& e = m_elements[i];
+    for (int ivert = 0; ivert < VERTICES; ivert++)
+    {
+      int a = e[ivert];
+      int b = e[(ivert + 1) % VERTICES];
+      upper[next[min(a, b)]++] = max(a, b);
+    }
+  }
+
+  // Sort each row, compress duplicates in place and record which edges are shared
+  vector<int> rowCount(numNodes);
+  vector<char> shared(upper.size(), 0);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int a = 0; a < numNodes; a++)
+  {
+    int first = rowPtr[a];
+    int last = rowPtr[a + 1];
+    sort(upper.begin() + first, upper.begin() + last);
+    int out = first;
+    for (int k = first; k < last; k++)
+    {
+      if (out > first && upper[out - 1] == upper[k])
+      {
+        shared[out - 1] = 1;
+      }
+      else
+      {
+        upper[out++] = upper[k];
+      }
+    }
+    rowCount[a] = out - first;
+  }
+
+  // Edge numbers: prefix sum of the compressed row lengths
+  vector<int> edgePtr(numNodes + 1, 0);
+  for (int a = 0; a < numNodes; a++)
+  {
+    edgePtr[a + 1] = edgePtr[a] + rowCount[a];
+  }
+  const int numEdges = edgePtr[numNodes];
+
+  // One midpoint node per edge
+  m_nodes.resize(numNodes + numEdges);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int a = 0; a < numNodes; a++)
+  {
+    double xa[DIM];
+    m_nodes[a].getPosition(xa);
+    for (int k = 0; k < rowCount[a]; k++)
+    {
+      int b = upper[rowPtr[a] + k];
+      double xb[DIM];
+      m_nodes[b].getPosition(xb);
+      double x[DIM];
+      for (int idir = 0; idir < DIM; idir++)
+      {
+        x[idir] = 0.5 * (xa[idir] + xb[idir]);
+      }
+      m_nodes[numNodes + edgePtr[a] + k] = Node(x, -1, shared[rowPtr[a] + k] != 0);
+    }
+  }
+
+  // Split every element into four, children of element i at 4i..4i+3
+  vector<Element> elements(4 * numElts);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int i = 0; i < numElts; i++)
+  {
+    const Element& e = m_elements[i];
+    int v[VERTICES];
+    int mid[VERTICES];  // mid[j] is the midpoint of edge (v[j], v[j+1])
+    e.vertices(v);
+    for (int ivert = 0; ivert < VERTICES; ivert++)
+    {
+      int a = min(v[ivert], v[(ivert + 1) % VERTICES]);
+      int b = max(v[ivert], v[(ivert + 1) % VERTICES]);
+      const int* row = &upper[rowPtr[a]];
+      int k = lower_bound(row, row + rowCount[a], b) - row;
+      mid[ivert] = numNodes + edgePtr[a] + k;
+    }
+    int child[4][VERTICES] = {{v[0], mid[0], mid[2]},
+                              {mid[0], v[1], mid[1]},
+                              {mid[2], mid[1], v[2]},
+                              {mid[0], mid[1], mid[2]}};
+    for (int c = 0; c < 4; c++)
+    {
+      elements[4 * i + c] = Element(child[c]);
+    }
+  }
+  m_elements.swap(elements);
+}
+
+/**
+ * @brief Rotate the vertices of every element so that its longest edge is the refinement edge.
+ *
+ * Vertex 0 becomes the vertex opposite the longest edge; a rotation keeps the
+ * orientation of the element.
+ */
+void FEGrid::labelLongestEdges()
+{
+  for (size_t i = 0; i < m_elements.size(); i++)
+  {
+    int v[VERTICES];
+    m_elements[i].vertices(v);
+    int peak = 0;
+    double longest = -1.0;
+    for (int ivert = 0; ivert < VERTICES; ivert++)
+    {
+      double xa[DIM], xb[DIM];
+      m_nodes[v[(ivert + 1) % VERTICES]].getPosition(xa);
+      m_nodes[v[(ivert + 2) % VERTICES]].getPosition(xb);
+      double length = 0.0;
+      for (int idir = 0; idir < DIM; idir++)
+      {
+        length += (xb[idir] - xa[idir]) * (xb[idir] - xa[idir]);
+      }
+      if (length > longest)
+      {
+        longest = length;
+        peak = ivert;
+      }
+    }
+    int rotated[VERTICES];
+    for (int ivert = 0; ivert < VERTICES; ivert++)
+    {
+      rotated[ivert] = v[(peak + ivert) % VERTICES];
+    }
+    m_elements[i] = Element(rotated);
+  }
+  m_bisectionLabels = true;
+}
+
+/**
+ * @brief Locally refine marked elements by newest-vertex bisection.
+ *
+ * @param a_marked Elements to refine.
+ * @param a_parents If not NULL, filled with the two end nodes of the bisected edge of every new node.
+ * @return The number of new nodes.
+ * Vertex 0 of every element is its newest vertex, so the refinement edge is
+ * (v1, v2). The refinement edges of the marked elements are marked first;
+ * then, as long as an element has a marked edge but an unmarked refinement
+ * edge, its refinement edge is marked too. Every element with a marked
+ * refinement edge is bisected, and each child whose refinement edge (an edge
+ * of the parent) is marked is bisected once more, so every marked edge is
+ * split from both sides and no hanging nodes remain. Edges are found by binary
+ * search in the sorted list of (lower, upper) vertex pairs, as in refineOnce().
+ */
+int FEGrid::bisect(const vector<int>& a_marked, vector<int>* a_parents)
+{
+  PROFILE_SCOPE("bisect");
+  if (!m_bisectionLabels)
+    labelLongestEdges();
+  const int numNodes = m_nodes.size();
+  const int numElts = m_elements.size();
+
+  // Local edge k of an element is the edge opposite vertex k
+  vector<unsigned long long> keys(numElts * VERTICES);
+  for (int i = 0; i < numElts; i++)
+  {
+    const Element& e = m_elements[i];
+    for (int k = 0; k < VERTICES; k++)
+    {
+      unsigned long long a = e[(k + 1) % VERTICES], b = e[(k + 2) % VERTICES];
+      keys[i * VERTICES + k] = (min(a, b) << 32) | max(a, b);
+    }
+  }
+  vector<unsigned long long> edges(keys);
+  sort(edges.begin(), edges.end());
+  edges.erase(unique(edges.begin(), edges.end()), edges.end());
+  const int numEdges = edges.size();
+  vector<int> eltEdges(numElts * VERTICES);
+  vector<int> edgeElts(2 * numEdges, -1);
+  for (int k = 0; k < numElts * VERTICES; k++)
+  {
+    int edge = lower_bound(edges.begin(), edges.end(), keys[k]) - edges.begin();
+    eltEdges[k] = edge;
+    edgeElts[2 * edge + (edgeElts[2 * edge] >= 0 ? 1 : 0)] = k / VERTICES;
+  }
+
+  // Mark the refinement edges of the marked elements, then close the marking
+  vector<char> markedEdge(numEdges, 0);
+  vector<int> work;
+  for (size_t m = 0; m < a_marked.size(); m++)
+  {
+    assert(a_marked[m] >= 0 && a_marked[m] < numElts);
+    int edge = eltEdges[a_marked[m] * VERTICES];
+    if (!markedEdge[edge])
+    {
+      markedEdge[edge] = 1;
+      work.push_back(edge);
+    }
+  }
+  while (!work.empty())
+  {
+    int edge = work.back();
+    work.pop_back();
+    for (int side = 0; side < 2; side++)
+    {
+      int elt = edgeElts[2 * edge + side];
+      if (elt < 0 || markedEdge[eltEdges[elt * VERTICES]])
+        continue;
+      markedEdge[eltEdges[elt * VERTICES]] = 1;
+      work.push_back(eltEdges[elt * VERTICES]);
+    }
+  }
+
+  // One new node per marked edge; interior nodes keep their numbers and new ones follow
+  vector<int> midpoint(numEdges, -1);
+  if (a_parents)
+    a_parents->clear();
+  for (int edge = 0; edge < numEdges; edge++)
+  {
+    if (!markedEdge[edge])
+      continue;
+    int a = edges[edge] >> 32, b = edges[edge] & 0xffffffffULL;
+    double xa[DIM], xb[DIM], x[DIM];
+    m_nodes[a].getPosition(xa);
+    m_nodes[b].getPosition(xb);
+    for (int idir = 0; idir < DIM; idir++)
+    {
+      x[idir] = 0.5 * (xa[idir] + xb[idir]);
+    }
+    bool isInterior = edgeElts[2 * edge + 1] >= 0;
+    midpoint[edge] = m_nodes.size();
+    m_nodes.push_back(Node(x, isInterior ? m_numInteriorNodes++ : -1, isInterior));
+    if (a_parents)
+    {
+      a_parents->push_back(a);
+      a_parents->push_back(b);
+    }
+  }
+
+  // (v0, v1, v2) becomes (m, v0, v1) and (m, v2, v0); the first child keeps the element number
+  vector<int> pending;
+  for (int i = 0; i < numElts; i++)
+  {
+    if (!markedEdge[eltEdges[i * VERTICES]])
+      continue;
+    int v[VERTICES];
+    m_elements[i].vertices(v);
+    pending.assign(v, v + VERTICES);
+    bool first = true;
+    while (!pending.empty())
+    {
+      int t[VERTICES];
+      copy(pending.end() - VERTICES, pending.end(), t);
+      pending.resize(pending.size() - VERTICES);
+      int m = -1;
+      if (t[1] < numNodes && t[2] < numNodes)
+      {
+        unsigned long long a = t[1], b = t[2];
+        m = midpoint[lower_bound(edges.begin(), edges.end(), (min(a, b) << 32) | max(a, b)) - edges.begin()];
+      }
+      if (m >= 0)
+      {
+        int children[2][VERTICES] = {{m, t[2], t[0]}, {m, t[0], t[1]}};
+        pending.insert(pending.end(), children[0], children[0] + VERTICES);
+        pending.insert(pending.end(), children[1], children[1] + VERTICES);
+      }
+      else if (first)
+      {
+        m_elements[i] = Element(t);
+        first = false;
+      }
+      else
+      {
+        m_elements.push_back(Element(t));
+      }
+    }
+  }
+  PROFILE_COUNT("elements_bisected", m_elements.size() - numElts);
+  return m_nodes.size() - numNodes;
+}
@@ -0,0 +1,213 @@
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include "FEHeat.h"
+#include "Profiler.h"
+
+/**
+ * @brief Constructor building the system matrix and its preconditioner.
+ *
+ * @param a_grid The grid; must outlive this object.
+ * @param a_assembler Assembler holding the assembled stiffness matrix; must outlive this object.
+ * @param a_dt Time step.
+ * @param a_theta Implicitness, 0 (explicit) to 1 (backward Euler).
+ * @param a_massType Lumped or consistent mass matrix.
+ * @param a_source Uniform heat source f.
+ */
+FEHeat::FEHeat(const FEGrid& a_grid, const FEAssembler& a_assembler, const double& a_dt,
+               const double& a_theta, const MassType& a_massType, const double& a_source)
+  : m_grid(a_grid), m_stiffness(a_assembler.matrix()), m_dt(a_dt), m_theta(a_theta),
+    m_massType(a_massType), m_time(0.0), m_numSteps(0)
+{
+  int n = m_stiffness.numRows();
+  m_u.assign(n, 0.0);
+  m_rhs.resize(n);
+  m_ku.resize(n);
+  m_load.resize(n);
+  a_assembler.assembleLoad(a_source * m_dt, m_load.data());
+
+  m_lumpedMass.resize(n);
+  a_assembler.assembleLumpedMass(m_lumpedMass.data());
+  if (m_massType == CONSISTENT)
+  {
+    a_assembler.assembleMass(m_mass);
+  }
+
+  if (m_massType == LUMPED && m_theta == 0.0)
+  {
+    return;
+  }
+
+  // System matrix M + theta dt K, preconditioned once for all steps
+  m_system = m_stiffness;
+  m_system.zero();
+  m_system.add(m_theta * m_dt, m_stiffness);
+  if (m_massType == CONSISTENT)
+    m_system.add(1.0, m_mass);
+  else
+    m_system.addDiagonal(m_lumpedMass.data());
+  m_solver.reset(new PCGSolver(m_system, PCGSolver::IC0));
+}
+
+/**
+ * @brief Set the temperature at every interior node from a function of position.
+ *
+ * @param a_function Initial temperature u0(x).
+ */
+void FEHeat::initialize(double (*a_function)(const double a_x[DIM]))
+{
+  for (int i = 0; i < m_grid.getNumNodes(); i++)
+  {
+    const Node& node = m_grid.node(i);
+    if (node.isInterior())
+    {
+      double x[DIM];
+      node.getPosition(x);
+      m_u[node.getInteriorNodeID()] = a_function(x);
+    }
+  }
+  m_time = 0.0;
+  m_numSteps = 0;
+}
+
+/**
+ * @brief Advance the solution by one time step.
+ *
+ * @return The number of solver iterations used (0 for the diagonal explicit step).
+ * The previous solution is the initial guess of the iterative solve.
+ */
+int FEHeat::step()
+{
+  int n = m_u.size();
+  int iterations = 0;
+  m_stiffness.multiply(m_u.data(), m_ku.data());
+
+  if (!m_solver)
+  {
+    for (int i = 0; i < n; i++)
+    {
+      m_u[i] += (m_load[i] - m_dt * m_ku[i]) / m_lumpedMass[i];
+    }
+  }
+  else
+  {
+    if (m_massType == CONSISTENT)
+    {
+      m_mass.multiply(m_u.data(), m_rhs.data());
+    }
+    else
+    {
+      for (int i = 0; i < n; i++)
+      {
+        m_rhs[i] = m_lumpedMass[i] * m_u[i];
+      }
+    }
+    for (int i = 0; i < n; i++)
+    {
+      m_rhs[i] += m_load[i] - (1.0 - m_theta) * m_dt * m_ku[i];
+    }
+    iterations = m_solver->solve(m_rhs.data(), m_u.data(), 1e-10);
+  }
+
+  m_time += m_dt;
+  m_numSteps++;
+  return iterations;
+}
+
+/**
+ * @brief Estimate the largest stable time step of the theta scheme with the mass matrix in use.
+ *
+ * @return 2 / ((1 - 2 theta) lambda_max) for theta < 1/2, infinity otherwise (unconditionally stable).
+ * Gershgorin bounds lambda_max(M_L^-1 K) by the largest row sum of |K| over the
+ * lumped mass. The consistent element mass area/12 (1 + delta_ij) has smallest
+ * eigenvalue area/12, a quarter of the lumped element mass area/3, so M >= M_L / 4
+ * and lambda_max(M^-1 K) <= 4 lambda_max(M_L^-1 K).
+ */
+double FEHeat::stableTimeStep() const
+{
+  if (m_theta >= 0.5)
+    return numeric_limits<double>::infinity();
+  const int* rowPtr = m_stiffness.rowPtr();
+  const double* values = m_stiffness.values();
+  double lambdaMax = 0.0;
+  for (int i = 0; i < m_stiffness.numRows(); i++)
+  {
+    double rowSum = 0.0;
+    for (int k = rowPtr[i]; k < rowPtr[i + 1]; k++)
+    {
+      rowSum += fabs(values[k]);
+    }
+    lambdaMax = max(lambdaMax, rowSum / m_lumpedMass[i]);
+  }
+  if (m_massType == CONSISTENT)
+    lambdaMax *= 4.0;
+  return (lambdaMax > 0.0) ? 2.0 / ((1.0 - 2.0 * m_theta) * lambdaMax) : 0.0;
+}
+
+/**
+ * @brief Write the nodal temperatures to a binary file.
+ *
+ * @param a_fileName The output file.
+ * @return True on success.
+ */
+bool FEHeat::writeSnapshot(const std::string& a_fileName) const
+{
+  PROFILE_SCOPE("output");
+  FILE* fp = fopen(a_fileName.c_str(), "wb");
+  if (!fp)
+  {
+    return false;
+  }
+  vector<double> u(m_grid.getNumNodes());
+  nodalValues(u.data());
+  fwrite(&m_time, sizeof(double), 1, fp);
+  fwrite(u.data(), sizeof(double), u.size(), fp);
+  fclose(fp);
+  PROFILE_COUNT("bytes_written", (u.size() + 1) * sizeof(double));
+  return true;
+}
+
+/**
+ * @brief Copy the temperature at every node of the grid (zero on the boundary).
+ *
+ * @param a_u Array of size getNumNodes().
+ */
+void FEHeat::nodalValues(double* a_u) const
+{
+  for (int i = 0; i < m_grid.getNumNodes(); i++)
+  {
+    int row = m_grid.node(i).getInteriorNodeID();
+    a_u[i] = (row >= 0) ? m_u[row] : 0.0;
+  }
+}
+
+/**
+ * @brief Get the temperature at the interior nodes.
+ *
+ * @return Reference to the interior solution vector.
+ */
+const vector<double>& FEHeat::solution() const
+{
+  return m_u;
+}
+
+/**
+ * @brief Get the current simulation time.
+ *
+ * @return The time.
+ */
+double FEHeat::getTime() const
+{
+  return m_time;
+}
+
+/**
+ * @brief Get the number of steps taken.
+ *
+ * @return The number of steps.
+ */
+int FEHeat::getNumSteps() const
+{
+  return m_numSteps;
+}
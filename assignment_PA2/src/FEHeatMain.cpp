@@ -0,0 +1,155 @@
+#include "FEGrid.h"
+#include "FEAssembler.h"
+#include "FEHeat.h"
+#include "Profiler.h"
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <sys/stat.h>
+
+using namespace std;
+
+static double s_lower[DIM]; /**< Lower corner of the bounding box of the grid. */
+static double s_upper[DIM]; /**< Upper corner of the bounding box of the grid. */
+
+/**
+ * @brief Initial temperature: the lowest Fourier mode of the bounding box.
+ *
+ * @param a_x Position.
+ * @return sin(pi x / Lx) sin(pi y / Ly), measured from the lower corner.
+ */
+static double initialTemperature(const double a_x[DIM])
+{
+  double u = 1.0;
+  for (int idir = 0; idir < DIM; idir++)
+  {
+    u *= sin(M_PI * (a_x[idir] - s_lower[idir]) / (s_upper[idir] - s_lower[idir]));
+  }
+  return u;
+}
+
+/**
+ * @brief Main function for transient heat conduction on a triangle mesh.
+ *
+ * Reads the mesh, assembles the stiffness and mass matrices and advances
+ * du/dt = div(k grad u) + f with the theta method from a sine initial condition.
+ * Snapshots of the nodal temperatures are written to bin/heat_NNNNNN.bin.
+ * At the end the peak temperature is compared with the decay exp(-lambda t) of the
+ * continuous problem on the bounding box and the stepping throughput is reported.
+ *
+ * @param argc The number of command-line arguments.
+ * @param argv prefix, time step, number of steps, and optionally theta (default 1),
+ * mass type ("lumped" or "consistent", default "consistent"), snapshot interval
+ * (default 0 = final state only), conductivity (default 1) and source (default 0).
+ *
+ * @return Returns 0 on successful execution, 1 for bad arguments, an invalid mesh or a failed write.
+ */
+int main(int argc, char** argv)
+{
+  if (argc < 4)
+  {
+    cerr << "Usage: " << argv[0] << " <mesh-prefix> <time-step> <num-steps> [theta] [lumped|consistent] [snapshot-interval] [conductivity] [source]" << endl;
+    return 1;
+  }
+
+  string prefix(argv[1]);
+  double dt = atof(argv[2]);
+  int numSteps = atoi(argv[3]);
+  double theta = (argc > 4) ? atof(argv[4]) : 1.0;
+  FEHeat::MassType massType = (argc > 5 && string(argv[5]) == "lumped") ? FEHeat::LUMPED : FEHeat::CONSISTENT;
+  int interval = (argc > 6) ? atoi(argv[6]) : 0;
+  double k = (argc > 7) ? atof(argv[7]) : 1.0;
+  double source = (argc > 8) ? atof(argv[8]) : 0.0;
+  if (!(dt > 0.0) || numSteps <= 0)
+  {
+    cerr << "Error: the time step and the number of steps must be positive" << endl;
+    return 1;
+  }
+
+  auto start = chrono::steady_clock::now();
+  FEGrid grid;
+  string error;
+  if (!grid.load(prefix + ".node", prefix + ".elem", &error))
+  {
+    cerr << "Error: invalid mesh " << prefix << " (" << error << ")" << endl;
+    return 1;
+  }
+  double cMatrix[DIM * DIM] = {k, 0, 0, k};
+  FEAssembler assembler(grid, cMatrix);
+  assembler.assemble();
+
+  for (int idir = 0; idir < DIM; idir++)
+  {
+    s_lower[idir] = 1e300;
+    s_upper[idir] = -1e300;
+  }
+  for (int i = 0; i < grid.getNumNodes(); i++)
+  {
+    double x[DIM];
+    grid.node(i).getPosition(x);
+    for (int idir = 0; idir < DIM; idir++)
+    {
+      s_lower[idir] = min(s_lower[idir], x[idir]);
+      s_upper[idir] = max(s_upper[idir], x[idir]);
+    }
+  }
+
+  FEHeat heat(grid, assembler, dt, theta, massType, source);
+  heat.initialize(initialTemperature);
+  double setupTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  if (theta < 0.5 && dt > heat.stableTimeStep())
+  {
+    cerr << "Warning: time step " << dt << " exceeds the stability estimate " << heat.stableTimeStep() << endl;
+  }
+
+  mkdir("bin", 0755);
+  char fileName[64];
+  long totalIterations = 0;
+  double ioTime = 0.0;
+  start = chrono::steady_clock::now();
+  {
+    PROFILE_SCOPE("time_stepping");
+    for (int s = 1; s <= numSteps; s++)
+    {
+      totalIterations += heat.step();
+      if ((interval > 0 && s % interval == 0) || s == numSteps)
+      {
+        auto ioStart = chrono::steady_clock::now();
+        snprintf(fileName, sizeof(fileName), "bin/heat_%06d.bin", s);
+        if (!heat.writeSnapshot(fileName))
+        {
+          cerr << "Error: Could not open file " << fileName << endl;
+          return 1;
+        }
+        ioTime += chrono::duration<double>(chrono::steady_clock::now() - ioStart).count();
+      }
+    }
+    PROFILE_COUNT("time_steps", numSteps);
+  }
+  double stepTime = chrono::duration<double>(chrono::steady_clock::now() - start).count() - ioTime;
+
+  double peak = 0.0;
+  for (size_t i = 0; i < heat.solution().size(); i++)
+  {
+    peak = max(peak, heat.solution()[i]);
+  }
+  double lambda = 0.0;
+  for (int idir = 0; idir < DIM; idir++)
+  {
+    lambda += k * M_PI * M_PI / ((s_upper[idir] - s_lower[idir]) * (s_upper[idir] - s_lower[idir]));
+  }
+
+  int numDofs = grid.getNumInteriorNodes();
+  printf("Elements: %d, DOFs: %d, steps: %d, t = %g\n", grid.getNumElts(), numDofs, heat.getNumSteps(), heat.getTime());
+  printf("Peak temperature: %g (continuous decay exp(-lambda t) = %g)\n", peak, exp(-lambda * heat.getTime()));
+  printf("Setup (load, assemble, precondition): %.3f s\n", setupTime);
+  printf("Stepping: %.3f s, %.1f steps/s, %.3g DOF-steps/s, %.2f solver iterations/step\n",
+         stepTime, numSteps / stepTime, (double)numDofs * numSteps / stepTime, (double)totalIterations / max(numSteps, 1));
+  printf("Snapshot output: %.3f s\n", ioTime);
+  return 0;
+}
@@ -1,209 +1,549 @@
 #include "FEGrid.h"
+#include "FEAssembler.h"
+#include "SparseMatrix.h"
+#include "PCGSolver.h"
+#include "MixedPCGSolver.h"
+#include "StreamAssembler.h"
+#include "MatrixCache.h"
+#include "ThreadPool.h"
+#include "AssemblyPipeline.h"
+#include "MeshPartition.h"
+#include "PartitionedMatrix.h"
+#include "Profiler.h"
 #include <vector>
+#include <algorithm>
 #include <string>
 #include <cmath>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <cstdlib>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <sys/stat.h>
 #define K 30
 
 using namespace std;
 
+/**
+ * @brief Print the answers to Q3 and Q4 about the global matrix.
+ *
+ * @param a_globalK The global stiffness matrix; the bandwidths are measured on it.
+ */
+static void printAnswers(const SparseMatrix& a_globalK) {
+  string q3Answer;
+  int q4AnswerA, q4AnswerB;
+
+  // Q3: The structure of the global matrix globalK
+  q3Answer = "Banded";  /**< The structure of globalK matrix is banded */
+
+  // Q4: Lower and upper bandwidth of the matrix
+  q4AnswerA = a_globalK.lowerBandwidth();  /**< Lower bandwidth of globalK */
+  q4AnswerB = a_globalK.upperBandwidth();  /**< Upper bandwidth of globalK */
+
+  // Output the answers for Q3 and Q4
+  cout << q3Answer << endl;
+  cout << "Lower Bandwidth: " << q4AnswerA << endl;
+  cout << "Upper Bandwidth: " << q4AnswerB << endl;
+}
+
+/**
+ * @brief Solve K u = F for a unit heat source with zero boundary temperature.
+ *
+ * The reference solve is PCG with an IC(0) preconditioner in double precision.
+ * With "-p mixed" the system is solved again with float matrix/preconditioner
+ * storage and double precision iterative refinement, and both are compared.
+ * The compared times are the solves alone: the double preconditioner may come
+ * ready from the cache, so neither time includes the factorization.
+ *
+ * @param a_globalK The global stiffness matrix over the interior nodes.
+ * @param a_load The load vector F.
+ * @param a_mixedPrecision Also run the mixed precision solver.
+ * @param a_solver Solver with a ready preconditioner (e.g. from the matrix cache), or NULL to factor here.
+ */
+static void solve(const SparseMatrix& a_globalK, const double* a_load, const bool& a_mixedPrecision, PCGSolver* a_solver = NULL) {
+  int numRows = a_globalK.numRows();
+  vector<double> u(numRows, 0.0);
+
+  unique_ptr<PCGSolver> ownSolver;
+  if(!a_solver) {
+    ownSolver.reset(new PCGSolver(a_globalK, PCGSolver::IC0));
+    a_solver = ownSolver.get();
+  }
+  PCGSolver& solver = *a_solver;
+  auto start = chrono::steady_clock::now();
+  int iterations;
+  {
+    PROFILE_SCOPE("pcg_solve");
+    iterations = solver.solve(a_load, u.data());
+  }
+  double doubleTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  double maxTemperature = numRows > 0 ? *max_element(u.begin(), u.end()) : 0.0;
+  cout << "Solve: " << iterations << " PCG iterations, relative residual " << solver.getResidual()
+       << ", max temperature " << maxTemperature << endl;
+
+  if(a_mixedPrecision) {
+    vector<double> uMixed(numRows, 0.0);
+    MixedPCGSolver mixedSolver(a_globalK, PCGSolver::IC0);
+    start = chrono::steady_clock::now();
+    int refinements = mixedSolver.solve(a_load, uMixed.data());
+    double mixedTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double maxDifference = 0.0;
+    for(int i = 0; i < numRows; i++)
+      maxDifference = max(maxDifference, fabs(uMixed[i] - u[i]));
+    cout << "Mixed precision: " << refinements << " refinement steps, " << mixedSolver.getInnerIterations()
+         << " float PCG iterations, relative residual " << mixedSolver.getResidual()
+         << ", max difference to double " << maxDifference << endl;
+    cout << "Solve time (without factorization) double: " << doubleTime * 1000 << " ms, mixed: " << mixedTime * 1000
+         << " ms, speedup " << doubleTime / mixedTime << endl;
+  }
+}
+
+/**
+ * @brief State and timings of one mesh of a batch run.
+ */
+struct BatchJob {
+  string prefix;  /**< Mesh prefix */
+  int levels;  /**< Uniform refinement levels */
+  double estimate;  /**< Size of the element file, used to start large meshes first */
+  unique_ptr<FEGrid> grid;  /**< The grid, released after assembly */
+  unique_ptr<FEAssembler> assembler;  /**< The assembled matrix, released after the solve */
+  vector<double> load;  /**< The load vector */
+  int numNodes, numElts;  /**< Size of the (refined) mesh */
+  int iterations;  /**< PCG iterations */
+  double loadTime, assembleTime, solveTime;  /**< Stage times in seconds */
+  double start, finish;  /**< Seconds since the batch started */
+  double maxTemperature;  /**< Largest temperature of the solution */
+  bool failed;  /**< The mesh files could not be opened or are invalid */
+  string error;  /**< Why the mesh failed, empty if the files could not be opened */
+};
+
+/**
+ * @brief Solve every mesh of a manifest on a work-stealing thread pool.
+ *
+ * Each manifest line holds a mesh prefix, optionally followed by refinement levels;
+ * blank lines and lines starting with '#' are skipped. Every mesh runs as a chain
+ * of three tasks, load (read and refine), assemble and solve, each queueing the next
+ * on its own worker, so idle workers steal whole stages of other meshes. Meshes are
+ * started largest element file first, and the element kernels of a mesh are split
+ * over the pool, so a large mesh spreads out while small ones fill the gaps.
+ * A table of per-mesh stage times and the aggregate throughput is printed at the end.
+ *
+ * @param a_manifest The manifest file.
+ * @param a_numThreads Number of workers, 0 for all hardware threads.
+ * @return 0 if every mesh was solved, 1 otherwise.
+ */
+static int runBatch(const string& a_manifest, const int& a_numThreads) {
+  ifstream manifest(a_manifest.c_str());
+  if(!manifest) {
+    cerr << "Error opening manifest " << a_manifest << endl;
+    return 1;
+  }
+  vector<unique_ptr<BatchJob> > jobs;
+  string line;
+  while(getline(manifest, line)) {
+    istringstream fields(line);
+    string prefix;
+    if(!(fields >> prefix) || prefix[0] == '#')
+      continue;
+    unique_ptr<BatchJob> job(new BatchJob());
+    job->prefix = prefix;
+    job->levels = 0;
+    fields >> job->levels;
+    struct stat st;
+    job->estimate = (stat((prefix + ".elem").c_str(), &st) == 0) ? st.st_size * pow(4.0, job->levels) : 0.0;
+    job->numNodes = job->numElts = job->iterations = 0;
+    job->loadTime = job->assembleTime = job->solveTime = job->start = job->finish = 0.0;
+    job->maxTemperature = 0.0;
+    job->failed = false;
+    jobs.push_back(std::move(job));
+  }
+
+  PROFILE_SCOPE("batch");
+  ThreadPool pool(a_numThreads);
+  auto origin = chrono::steady_clock::now();
+  auto seconds = [origin]() { return chrono::duration<double>(chrono::steady_clock::now() - origin).count(); };
+  double cMatrix[DIM * 2] = {K, 0, 0, K};
+
+  vector<BatchJob*> order;
+  for(size_t j = 0; j < jobs.size(); j++)
+    order.push_back(jobs[j].get());
+  stable_sort(order.begin(), order.end(), [](const BatchJob* a, const BatchJob* b) { return a->estimate > b->estimate; });
+
+  for(size_t j = 0; j < order.size(); j++) {
+    BatchJob* job = order[j];
+    pool.submit([job, &pool, &seconds, &cMatrix]() {
+      job->start = seconds();
+      ifstream nodes((job->prefix + ".node").c_str()), elements((job->prefix + ".elem").c_str());
+      if(!nodes || !elements) {
+        job->failed = true;
+        job->finish = seconds();
+        return;
+      }
+      job->grid.reset(new FEGrid());
+      if(!job->grid->load(job->prefix + ".node", job->prefix + ".elem", &job->error)) {
+        job->grid.reset();
+        job->failed = true;
+        job->finish = seconds();
+        return;
+      }
+      if(job->levels > 0)
+        job->grid->refine(job->levels);
+      job->numNodes = job->grid->getNumNodes();
+      job->numElts = job->grid->getNumElts();
+      job->loadTime = seconds() - job->start;
+
+      pool.submit([job, &pool, &seconds, &cMatrix]() {
+        double start = seconds();
+        job->assembler.reset(new FEAssembler(*job->grid, cMatrix));
+        job->assembler->assemble(&pool);
+        job->load.resize(job->assembler->matrix().numRows());
+        job->assembler->assembleLoad(1.0, job->load.data());
+        job->assembleTime = seconds() - start;
+
+        pool.submit([job, &seconds]() {
+          PROFILE_SCOPE("pcg_solve");
+          double start = seconds();
+          const SparseMatrix& globalK = job->assembler->matrix();
+          vector<double> u(globalK.numRows(), 0.0);
+          PCGSolver solver(globalK, PCGSolver::IC0);
+          job->iterations = solver.solve(job->load.data(), u.data());
+          job->maxTemperature = u.empty() ? 0.0 : *max_element(u.begin(), u.end());
+          job->assembler.reset();
+          job->grid.reset();
+          vector<double>().swap(job->load);
+          job->solveTime = seconds() - start;
+          job->finish = seconds();
+        });
+      });
+    });
+  }
+  pool.wait();
+  double wallTime = seconds();
+
+  cout << setw(24) << left << "mesh" << right << setw(10) << "nodes" << setw(10) << "elements" << setw(11) << "load ms"
+       << setw(12) << "assemble ms" << setw(10) << "solve ms" << setw(11) << "total ms" << setw(7) << "iters"
+       << setw(14) << "max temp" << endl;
+  int numFailed = 0;
+  long totalElements = 0;
+  double busyTime = 0.0;
+  for(size_t j = 0; j < jobs.size(); j++) {
+    const BatchJob& job = *jobs[j];
+    cout << setw(24) << left << job.prefix << right;
+    if(job.failed) {
+      if(job.error.empty())
+        cout << "  error: could not open the mesh files" << endl;
+      else
+        cout << "  error: invalid mesh (" << job.error << ")" << endl;
+      numFailed++;
+      continue;
+    }
+    double total = job.loadTime + job.assembleTime + job.solveTime;
+    cout << setw(10) << job.numNodes << setw(10) << job.numElts << fixed << setprecision(2) << setw(11)
+         << job.loadTime * 1000 << setw(12) << job.assembleTime * 1000 << setw(10) << job.solveTime * 1000
+         << setw(11) << total * 1000 << setw(7) << job.iterations << defaultfloat << setprecision(6) << setw(14)
+         << job.maxTemperature << endl;
+    totalElements += job.numElts;
+    busyTime += total;
+  }
+  int numSolved = jobs.size() - numFailed;
+  cout << "Batch: " << numSolved << " meshes (" << numFailed << " failed) on " << pool.numThreads() << " threads in "
+       << wallTime * 1000 << " ms, " << numSolved / wallTime << " meshes/s, " << totalElements / wallTime
+       << " elements/s, concurrency " << busyTime / wallTime << ", " << pool.getNumTasks() << " tasks, "
+       << pool.getNumSteals() << " steals" << endl;
+  return numFailed > 0 ? 1 : 0;
+}
+
 /**
  * @brief Main function for performing finite element analysis (FEM) on a grid.
- * 
+ *
  * This program computes the global stiffness matrix for a grid defined by nodes and elements.
  * It processes the node and element files provided as input, calculates the element stiffness matrices,
  * assembles them into the global matrix, and computes the Poisson operator over the grid elements.
  * The results are then output in both textual and binary formats.
- * 
+ *
+ * With "-r <levels>" the mesh is uniformly refined in memory (FEGrid::refine) before assembly.
+ * Every element starts with the isotropic conductivity K. Each optional material file
+ * (see FEAssembler::readConductivities) is applied in turn and the matrix is re-assembled;
+ * only the elements whose conductivity changed are re-integrated.
+ * With "-s <MB>" the matrix is instead assembled out of core within that working memory,
+ * and "-B" first converts prefix.elem to the binary prefix.elemb used by streaming runs.
+ * With "-n <parts>" the matrix is also assembled and multiplied per mesh partition ("-z": Morton order).
+ * With "-P" (and no refinement) the mesh is read and assembled by a pipeline of concurrent
+ * stages (see AssemblyPipeline), so assembly overlaps reading the element file.
+ * Finally K u = F is solved for a unit source; "-p mixed" adds a mixed precision solve.
+ * With "-c <dir>" the assembled matrix, load vector and IC(0) factor are kept in a
+ * content-addressed cache file in that directory (see MatrixCache); a later run on the
+ * same mesh, material files and refinement maps it instead of reading and assembling.
+ * "part1 -b <manifest> [-t <threads>]" instead solves a batch of meshes on a thread pool (see runBatch()).
+ * Set FEM_PROFILE=1 for a per-phase time/memory summary or FEM_TRACE=<file> for a Chrome trace (see Profiler).
+ *
  * @param argc The number of command-line arguments.
- * @param argv The command-line arguments passed to the program. The first argument is the common prefix of the node and element files.
- * 
+ * @param argv The command-line arguments passed to the program. The first argument is the common prefix of the node and element files,
+ * optionally followed by "-r <levels>", "-p mixed", "-s <MB>", "-B", "-P", "-n <parts>", "-z", "-c <cache dir>" and zero or more material files.
+ *
  * @return Returns 0 on successful execution.
  */
 int main(int argc, char** argv) {
-  // Ensure the program is run with exactly one argument
-  if(argc != 2)
+  PROFILE_SCOPE("part1");
+  // Ensure the program is run with the mesh prefix
+  if(argc < 2)
     {
-      cout << "this program takes just one argument that is the common name prefix of .node and .elem files. (Note: do not give the file extension) ";
+      cout << "this program takes the common name prefix of .node and .elem files (Note: do not give the file extension), optionally followed by -r <refinement levels>, -p mixed, -s <streaming memory MB>, -B, -P, -n <partitions>, -z, -c <cache dir> and material files, or -b <manifest> [-t <threads>] for a batch of meshes. ";
       return 1;
     }
 
+  if(string(argv[1]) == "-b") {
+    if(argc < 3) {
+      cout << "batch mode takes a manifest of mesh prefixes: -b <manifest> [-t <threads>]" << endl;
+      return 1;
+    }
+    int numThreads = 0;  /**< Pool workers, 0 = all hardware threads */
+    for(int i = 3; i < argc; i++) {
+      string arg(argv[i]);
+      if(arg == "-t" && i + 1 < argc)
+        numThreads = atoi(argv[++i]);
+      else {
+        cout << "batch mode takes a manifest of mesh prefixes: -b <manifest> [-t <threads>]" << endl;
+        return 1;
+      }
+    }
+    return runBatch(argv[2], numThreads);
+  }
+
   string prefix(argv[1]);
   string nodeFile = prefix + ".node";  /**< File path for node data */
   string eleFile = prefix + ".elem";  /**< File path for element data */
-  string q3Answer, q4AnswerA, q4AnswerB;
-
-  /**
-   * @brief Creates a grid using the node and element files
-   * 
-   * The grid is created by reading the node and element files and initializing the necessary 
-   * data structures for performing finite element analysis.
-   */
-  FEGrid grid(nodeFile, eleFile);
-
-  // Get the total number of nodes and interior nodes in the grid
-  int numInteriorNodes = grid.getNumInteriorNodes();
-  int numNodes = grid.getNumNodes();
+  int levels = 0;  /**< Uniform refinement levels */
+  bool mixedPrecision = false;  /**< Also solve with float storage and iterative refinement */
+  double streamBudget = 0;  /**< Working memory (MB) of out-of-core assembly, 0 = in memory */
+  bool writeBinary = false;  /**< Write prefix.elemb for later streaming runs */
+  bool pipelined = false;  /**< Read and assemble in overlapping stages */
+  int numParts = 0;  /**< Partitions of the partitioned assembly, 0 = none */
+  bool morton = false;  /**< Partition by Morton order instead of RCB */
+  string cacheDir;  /**< Directory of the matrix cache, empty = no caching */
+  vector<string> materialFiles;
+  for(int i = 2; i < argc; i++) {
+    string arg(argv[i]);
+    if(arg == "-r" && i + 1 < argc)
+      levels = atoi(argv[++i]);
+    else if(arg == "-p" && i + 1 < argc)
+      mixedPrecision = (string(argv[++i]) == "mixed");
+    else if(arg == "-s" && i + 1 < argc)
+      streamBudget = atof(argv[++i]);
+    else if(arg == "-B")
+      writeBinary = true;
+    else if(arg == "-P")
+      pipelined = true;
+    else if(arg == "-n" && i + 1 < argc)
+      numParts = atoi(argv[++i]);
+    else if(arg == "-z")
+      morton = true;
+    else if(arg == "-c" && i + 1 < argc)
+      cacheDir = argv[++i];
+    else
+      materialFiles.push_back(arg);
+  }
 
-  /**
-   * @brief Global stiffness matrix and matrix index arrays
-   * 
-   * The global stiffness matrix (`globalK`) stores the Kij values of all interior nodes.
-   * The `globalMatrixIndex` array stores the index of the interior node in the global matrix.
-   * These arrays are used in the assembly of the global stiffness matrix.
-   */
-  int* globalMatrixIndex = (int*)malloc(sizeof(int) * numNodes);
-  int interiorNodeIndex = 0;
+  if(writeBinary && !StreamAssembler::writeBinaryElements(eleFile, prefix + ".elemb")) {
+    cerr << "Error writing " << prefix << ".elemb" << endl;
+    return 1;
+  }
 
   /**
-   * @brief Assign indices to interior nodes in the global matrix.
-   * 
-   * This loop assigns indices to the interior nodes for constructing the global stiffness matrix.
-   * The global matrix is populated using the interior node indices.
+   * @brief Out-of-core assembly
+   *
+   * With "-s <MB>" the elements are streamed in chunks from prefix.elemb (if present)
+   * or prefix.elem, spilled as sorted runs and merged into the global matrix, so the
+   * element list is never held in memory. Refinement and material files need the
+   * in-memory grid and are not available in this mode.
    */
-  for(int i = 0; i < numNodes; i++) {
-    const Node& n = grid.node(i);
-    if(n.isInterior())
-      globalMatrixIndex[i] = interiorNodeIndex++;
-    else
-      globalMatrixIndex[i] = -1;
+  if(streamBudget > 0) {
+    double cMatrix[DIM * 2] = {K, 0, 0, K};
+    StreamAssembler streamer(nodeFile, cMatrix, (size_t)(streamBudget * 1e6));
+    string streamFile = ifstream((prefix + ".elemb").c_str()) ? prefix + ".elemb" : eleFile;
+    SparseMatrix globalK;
+    vector<double> load;
+    if(!streamer.assemble(streamFile, globalK, load)) {
+      cerr << "Error during streaming assembly of " << nodeFile << " and " << streamFile << endl;
+      return 1;
+    }
+    streamer.printStatistics(cout);
+    printAnswers(globalK);
+    solve(globalK, load.data(), mixedPrecision);
+    return 0;
   }
 
-  // Initialize the global stiffness matrix to zero
-  double *globalK = (double *)malloc(sizeof(double) * numInteriorNodes * numInteriorNodes);
-  memset(globalK, 0, sizeof(double) * numInteriorNodes * numInteriorNodes); 
-
-  double kij[VERTICES * VERTICES];  /**< Array for storing B^T * C * B */
-  double kijpartial[VERTICES * VERTICES];  /**< Array for storing B^T * C */
-  double cMatrix[DIM * 2] = {K, 0, 0, K};  /**< Material property matrix (thermal conductivity) */
-
   /**
-   * @brief Loop over each element in the grid to compute the Poisson operator.
-   * 
-   * For each element in the grid, the program calculates the element stiffness matrix and assembles 
-   * it into the global stiffness matrix using the Poisson operator. 
-   * The gradient of the shape functions is computed and used in the matrix assembly process.
+   * @brief Matrix cache
+   *
+   * The key hashes the contents of the mesh and material files with the conductivity
+   * and the refinement levels. On a hit the matrix, load vector and preconditioner are
+   * mapped from the cache file and the grid is never read.
    */
-  for(int i = 0; i < grid.getNumElts(); i++) {
-    Element e = grid.element(i);
-
-    // Count the number of interior nodes in the current element
-    std::vector<int> elementInteriorNodeID;
-    for(int j = 0; j < VERTICES; j++) {
-      const Node& n = grid.getNode(i, j);
-      if(n.isInterior()) {
-        elementInteriorNodeID.push_back(j);  // Storing node local number of the interior node
+  uint64_t cacheKey = 0;
+  string cacheFile;
+  if(!cacheDir.empty()) {
+    vector<string> keyFiles(1, nodeFile);
+    keyFiles.push_back(eleFile);
+    keyFiles.insert(keyFiles.end(), materialFiles.begin(), materialFiles.end());
+    double keyParameters[] = {K, 0, 0, K, (double)levels};
+    if(MatrixCache::computeKey(keyFiles, vector<double>(keyParameters, keyParameters + 5), cacheKey)) {
+      cacheFile = MatrixCache::fileName(cacheDir, cacheKey);
+      MatrixCache cache;
+      if(cache.open(cacheFile, cacheKey)) {
+        cout << "Cache hit: " << cacheFile << " (" << cache.mappedBytes() << " bytes mapped)" << endl;
+        printAnswers(cache.matrix());
+        unique_ptr<PCGSolver> solver(cache.makeSolver());
+        solve(cache.matrix(), cache.load(), mixedPrecision, solver.get());
+        return 0;
       }
     }
-    int numInteriorNodesOfElement = elementInteriorNodeID.size();
+  }
 
-    // Allocate memory for the gradient of shape functions for each interior node of the element 
-    double* bMatrixTrans = (double *)malloc(sizeof(double) * numInteriorNodesOfElement * DIM);
+  /**
+   * @brief Creates a grid using the node and element files
+   *
+   * The grid is created by reading the node and element files and initializing the necessary
+   * data structures for performing finite element analysis. The grid also numbers the
+   * interior nodes; that numbering gives the rows of the global matrix.
+   */
+  double cMatrix[DIM * 2] = {K, 0, 0, K};  /**< Material property matrix (thermal conductivity) */
+  FEGrid grid;
+  unique_ptr<FEAssembler> assemblerPtr;
 
-    // Get the gradient of the shape functions for all interior nodes of the element
-    for(int j = 0; j < numInteriorNodesOfElement; j++) {
-      grid.gradient(bMatrixTrans + j * DIM, i, elementInteriorNodeID[j]);
+  if(pipelined && levels == 0) {
+    /**
+     * @brief Pipelined reading and assembly
+     *
+     * Parsing, numbering, element kernels and scatter run as concurrent stages, so
+     * assembly starts while the element file is still being read (see AssemblyPipeline).
+     */
+    AssemblyPipeline pipeline(cMatrix);
+    if(!pipeline.run(nodeFile, eleFile, grid, assemblerPtr)) {
+      cerr << "Error opening or reading " << nodeFile << " or " << eleFile << endl;
+      return 1;
     }
+    pipeline.printStatistics(cout);
+  }
+  else {
+    if(pipelined)
+      cout << "-P is ignored with -r: the refined mesh is assembled after refinement" << endl;
+    grid = FEGrid(nodeFile, eleFile);
 
-#ifndef CBLAS_DGEMM
-    // Compute B^T * C (3x2 * 2x2) OR (2x2 * 2x2) or (1x2 * 2x2)
-    for(int m = 0; m < numInteriorNodesOfElement; m++) {
-      for(int n = 0; n < DIM; n++) {
-        kijpartial[m * DIM + n] = 0.0;
-        for(int r = 0; r < DIM; r++) {
-          kijpartial[m * DIM + n] += bMatrixTrans[m * DIM + r] * cMatrix[r * DIM + n];
-        }
-      }
+    if(levels > 0) {
+      auto start = chrono::steady_clock::now();
+      grid.refine(levels);
+      double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      cout << "Refined " << levels << " levels: " << grid.getNumNodes() << " nodes, " << grid.getNumElts() << " elements in " << elapsed * 1000 << " ms" << endl;
     }
-#else
-    /**
-     * @brief Use cblas_dgemm for matrix multiplication if CBLAS is available.
-     * 
-     * This line calls the cblas_dgemm function to efficiently perform matrix multiplication.
-     * The result is stored in kijpartial, which will later be used to calculate the element stiffness matrix.
-     */
-    cblas_dgemm(CblasRowMajor, CblasTrans, CblasNoTrans, numInteriorNodesOfElement, DIM, DIM, 1.0, bMatrixTrans, DIM, cMatrix, DIM, 0.0, kijpartial, numInteriorNodesOfElement);
-#endif
 
     /**
-     * @brief Dump kijpartial to a binary file for later analysis.
-     * 
-     * The kijpartial matrix is written to the binary file `kijdump.bin` for storage and inspection.
-     * This allows for later verification and analysis of the computed stiffness values.
+     * @brief Global stiffness matrix
+     *
+     * The assembler computes the sparsity pattern of the global stiffness matrix over the
+     * interior nodes and the element-to-matrix scatter map once. Each assemble() call then
+     * only streams the element matrices into their precomputed slots.
      */
-    FILE *fp = fopen("kijdump.bin", "wb");  // Open file for writing in binary mode
-    if (fp != nullptr) {
-      fwrite(kijpartial, sizeof(double), VERTICES * VERTICES, fp);  // Write kijpartial to the binary file
-      fclose(fp);  // Close the file after writing
-    } else {
-      cerr << "Error opening file for writing!" << endl;
-    }
+    assemblerPtr.reset(new FEAssembler(grid, cMatrix));
+    assemblerPtr->assemble();
+  }
+  FEAssembler& assembler = *assemblerPtr;
 
-    // Creating B from B^T
-    double *bMatrix = (double *)malloc(sizeof(double) * DIM * numInteriorNodesOfElement);
-    for(int m = 0; m < DIM; m++) {
-      for(int n = 0; n < numInteriorNodesOfElement; n++) {
-        bMatrix[m * numInteriorNodesOfElement + n] = bMatrixTrans[n * DIM + m];
-      }
-    }
+  /**
+   * @brief Partitioned assembly and SpMV
+   *
+   * With "-n <parts>" the elements and rows are split by coordinates (RCB, or Morton
+   * order with "-z"), assembled partition-locally with an interface exchange and
+   * compared with the global matrix; the SpMV of both layouts is then timed.
+   * Build with OPENMP=1 and set OMP_PROC_BIND to keep each partition on its thread.
+   */
+  if(numParts > 0) {
+    MeshPartition partition(grid, numParts, morton ? MeshPartition::MORTON : MeshPartition::RCB);
+    partition.printStatistics(cout);
+    PartitionedMatrix partitioned(partition, cMatrix);
+    auto start = chrono::steady_clock::now();
+    partitioned.assemble();
+    double assembleTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Partitioned assembly: " << assembleTime * 1000 << " ms, " << partitioned.getNumExchanged()
+         << " interface entries exchanged, max difference to the global matrix "
+         << partitioned.maxDifference(assembler.matrix()) << endl;
 
-    free(bMatrixTrans);  // Free the temporary matrix after use
+    const int numProducts = 100;
+    int n = partitioned.numRows();
+    unique_ptr<double[]> x(new double[n]), y(new double[n]);
+    partitioned.firstTouch(x.get());
+    partitioned.firstTouch(y.get());
+    for(int i = 0; i < n; i++)
+      x[i] = 1.0;
+    start = chrono::steady_clock::now();
+    for(int k = 0; k < numProducts; k++)
+      partitioned.multiply(x.get(), y.get());
+    double partitionedTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    vector<double> xGlobal(n, 1.0), yGlobal(n);
+    start = chrono::steady_clock::now();
+    for(int k = 0; k < numProducts; k++)
+      assembler.matrix().multiply(xGlobal.data(), yGlobal.data());
+    double globalTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "SpMV: partitioned " << partitionedTime / numProducts * 1e6 << " us, global "
+         << globalTime / numProducts * 1e6 << " us per product" << endl;
+  }
 
-    // Multiply with B to get the element stiffness matrix
-    for(int m = 0; m < numInteriorNodesOfElement; m++) {
-      for(int n = 0; n < numInteriorNodesOfElement; n++) {
-        kij[m * numInteriorNodesOfElement + n] = 0.0;
-        for(int r = 0; r < DIM; r++) {
-          kij[m * numInteriorNodesOfElement + n] += kijpartial[m * DIM + r] * bMatrix[r * numInteriorNodesOfElement + n];
-        }
-      }
+  for(size_t i = 0; i < materialFiles.size(); i++) {
+    int numRead = assembler.readConductivities(materialFiles[i]);
+    if(numRead == -1) {
+      cerr << "Error opening material file " << materialFiles[i] << endl;
+      return 1;
     }
-
-    free(bMatrix);  // Free the matrix after multiplication
-
-    // Insert element matrix contents into the global matrix
-    for(int m = 0; m < numInteriorNodesOfElement; m++) {
-      int nodeGlobalNumber = e[elementInteriorNodeID[m]];
-      assert(globalMatrixIndex[nodeGlobalNumber] != -1);  // Ensure the node is interior
-      int rowNumber = globalMatrixIndex[nodeGlobalNumber];
-      for(int n = 0; n < numInteriorNodesOfElement; n++) {
-        int colNumber = globalMatrixIndex[e[elementInteriorNodeID[n]]];
-        globalK[rowNumber * numInteriorNodes + colNumber] += kij[m * numInteriorNodesOfElement + n];
-      }
+    if(numRead < 0) {
+      cerr << "Error: material file " << materialFiles[i] << " is truncated or names an element out of range" << endl;
+      return 1;
     }
+    int numIntegrated = assembler.assemble();
+    cout << materialFiles[i] << ": re-integrated " << numIntegrated << " of " << grid.getNumElts() << " elements" << endl;
   }
 
-  // Q3: The structure of the global matrix globalK
-  q3Answer = "Banded";  /**< The structure of globalK matrix is banded */
-
-  // Q4: Lower and upper bandwidth of the matrix
-  q4AnswerA = "Tridiagonal";  /**< Lower bandwidth of globalK */
-  q4AnswerB = "Tridiagonal";  /**< Upper bandwidth of globalK */
-
-  // Output the answers for Q3 and Q4
-  cout << q3Answer << endl;
-  cout << "Lower Bandwidth: " << q4AnswerA << endl;
-  cout << "Upper Bandwidth: " << q4AnswerB << endl;
+  printAnswers(assembler.matrix());
 
 #ifdef DEBUG
+  {
+  PROFILE_SCOPE("output");
   // Write the global matrix into a file for visualization in debug mode
   ofstream myoutputfile;
   myoutputfile.open("GlobalKMatrixFile.txt");
-  for(int m = 0; m < numInteriorNodes; m++) {
-    for(int n = 0; n < numInteriorNodes; n++) {
-      myoutputfile << globalK[m * numInteriorNodes + n];
-      if(n != numInteriorNodes - 1)
-        myoutputfile << " ";
-      else
-        myoutputfile << "\n";
-    }
+  assembler.matrix().printDense(myoutputfile);
+
+  /**
+   * @brief Dump the element stiffness matrices to a binary file for later analysis.
+   *
+   * All VERTICES x VERTICES element matrices are written to `kijdump.bin` in element order.
+   */
+  FILE *fp = fopen("kijdump.bin", "wb");  // Open file for writing in binary mode
+  if (fp != nullptr) {
+    fwrite(assembler.elementMatrix(0), sizeof(double), grid.getNumElts() * VERTICES * VERTICES, fp);
+    fclose(fp);  // Close the file after writing
+    PROFILE_COUNT("bytes_written", grid.getNumElts() * VERTICES * VERTICES * sizeof(double));
+  } else {
+    cerr << "Error opening file for writing!" << endl;
+  }
   }
 #endif
 
-  // Jacobi solver would go here (if implemented)
+  int numRows = assembler.matrix().numRows();
+  vector<double> load(numRows);
+  assembler.assembleLoad(1.0, load.data());
+  if(cacheFile.empty()) {
+    solve(assembler.matrix(), load.data(), mixedPrecision);
+    return 0;
+  }
+  PCGSolver solver(assembler.matrix(), PCGSolver::IC0);
+  solve(assembler.matrix(), load.data(), mixedPrecision, &solver);
+  if(MatrixCache::write(cacheFile, cacheKey, assembler.matrix(), load.data(), &solver))
+    cout << "Cache written: " << cacheFile << endl;
+  else
+    cerr << "Error writing cache file " << cacheFile << endl;
 
   return 0;
 }
-
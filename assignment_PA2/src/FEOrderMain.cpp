@@ -0,0 +1,220 @@
+#include "FEGrid.h"
+#include "FEAssembler.h"
+#include "MeshT.h"
+#include "PCGSolver.h"
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+using namespace std;
+
+static const double s_width = 0.6; /**< Width of the plate of FEGrid::isBoundaryPosition(). */
+static const double s_height = 0.4; /**< Height of the plate. */
+
+/**
+ * @brief Manufactured solution on the plate.
+ *
+ * @param a_x Position.
+ * @return sin(pi x / 0.6) sin(pi y / 0.4).
+ */
+static double plateSolution(const double* a_x)
+{
+  return sin(M_PI * a_x[0] / s_width) * sin(M_PI * a_x[1] / s_height);
+}
+
+/**
+ * @brief Source of the manufactured solution on the plate, -laplacian u.
+ *
+ * @param a_x Position.
+ * @return pi^2 (1 / 0.6^2 + 1 / 0.4^2) u.
+ */
+static double plateSource(const double* a_x)
+{
+  return M_PI * M_PI * (1.0 / (s_width * s_width) + 1.0 / (s_height * s_height)) * plateSolution(a_x);
+}
+
+/**
+ * @brief Manufactured solution on the unit cube.
+ *
+ * @param a_x Position.
+ * @return sin(pi x) sin(pi y) sin(pi z).
+ */
+static double cubeSolution(const double* a_x)
+{
+  return sin(M_PI * a_x[0]) * sin(M_PI * a_x[1]) * sin(M_PI * a_x[2]);
+}
+
+/**
+ * @brief Source of the manufactured solution on the cube.
+ *
+ * @param a_x Position.
+ * @return 3 pi^2 u.
+ */
+static double cubeSource(const double* a_x)
+{
+  return 3.0 * M_PI * M_PI * cubeSolution(a_x);
+}
+
+/**
+ * @brief Seconds since a start time.
+ */
+static double secondsSince(const chrono::steady_clock::time_point& a_start)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - a_start).count();
+}
+
+/**
+ * @brief Assemble and solve the Poisson problem of a mesh and print one line of results.
+ *
+ * @param a_mesh The mesh.
+ * @param a_source Source f.
+ * @param a_exact Exact solution, compared at every node.
+ * @param a_previous Error of the previous (twice coarser) mesh, or 0; updated.
+ */
+template <class E, class Source, class Exact>
+static void convergenceStep(const MeshT<E>& a_mesh, const Source& a_source, const Exact& a_exact, double& a_previous)
+{
+  double conductivity[E::dim * E::dim] = {};
+  for (int r = 0; r < E::dim; r++)
+  {
+    conductivity[r * E::dim + r] = 1.0;
+  }
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  AssemblerT<E> assembler(a_mesh, conductivity);
+  assembler.assemble();
+  double assemblySeconds = secondsSince(start);
+  vector<double> load(a_mesh.numInteriorNodes), u(a_mesh.numInteriorNodes, 0.0);
+  assembler.assembleLoad(a_source, load.data());
+  PCGSolver solver(assembler.matrix(), PCGSolver::IC0);
+  int iterations = solver.solve(load.data(), u.data(), 1e-12);
+
+  double error = 0.0;
+  for (int i = 0; i < a_mesh.getNumNodes(); i++)
+  {
+    int row = a_mesh.interiorID[i];
+    double value = (row < 0) ? 0.0 : u[row];
+    error = max(error, fabs(value - a_exact(&a_mesh.coordinates[i * E::dim])));
+  }
+  cout << setw(10) << a_mesh.getNumElts() << setw(10) << a_mesh.numInteriorNodes << setw(12)
+       << assembler.matrix().nnz() << setw(8) << iterations << setw(14) << scientific << setprecision(3) << error;
+  if (a_previous > 0.0)
+    cout << setw(8) << fixed << setprecision(2) << log2(a_previous / error);
+  cout << setw(12) << fixed << setprecision(3) << assemblySeconds * 1e3 << " ms" << endl;
+  a_previous = error;
+}
+
+/**
+ * @brief Print the header of a convergence table.
+ */
+static void printHeader(const string& a_title)
+{
+  cout << endl << a_title << endl;
+  cout << setw(10) << "elements" << setw(10) << "rows" << setw(12) << "nnz" << setw(8) << "iters" << setw(14)
+       << "max error" << setw(8) << "order" << setw(15) << "assembly" << endl;
+}
+
+/**
+ * @brief Main function exercising the templated elements.
+ *
+ * Checks that the linear triangle instantiation reproduces FEAssembler entry by
+ * entry and compares the assembly times of the two, then runs convergence
+ * studies with manufactured solutions: linear and quadratic triangles on the
+ * refined grid, and linear tetrahedra on the unit cube.
+ *
+ * @param argc The number of command-line arguments.
+ * @param argv mesh prefix, and optionally the number of refinement levels (default 4)
+ * and the largest number of cube cells per direction (default 16).
+ *
+ * @return Returns 0 on success, 1 if the mesh is invalid or the linear triangle matrices differ.
+ */
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    cerr << "Usage: " << argv[0] << " <mesh-prefix> [refinement-levels] [cube-cells]" << endl;
+    return 1;
+  }
+  string prefix(argv[1]);
+  int levels = (argc > 2) ? max(0, atoi(argv[2])) : 4;
+  int maxCells = (argc > 3) ? max(1, atoi(argv[3])) : 16;
+
+  FEGrid base;
+  string error;
+  if (!base.load(prefix + ".node", prefix + ".elem", &error))
+  {
+    cerr << "Error: invalid mesh " << prefix << " (" << error << ")" << endl;
+    return 1;
+  }
+
+  // Linear triangles: same matrix as FEAssembler, same cost
+  FEGrid grid(base);
+  grid.refine(levels);
+  const double identity[DIM * DIM] = {1.0, 0.0, 0.0, 1.0};
+  MeshT<ElementT<Triangle, 1> > linear;
+  buildMesh(grid, linear);
+  FEAssembler reference(grid, identity);
+  AssemblerT<ElementT<Triangle, 1> > templated(linear, identity);
+  const int repetitions = 5;
+  double referenceSeconds = 1e300, templatedSeconds = 1e300;
+  for (int rep = 0; rep < repetitions; rep++)
+  {
+    FEAssembler fresh(grid, identity);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    fresh.assemble();
+    referenceSeconds = min(referenceSeconds, secondsSince(start));
+    start = chrono::steady_clock::now();
+    templated.assemble();
+    templatedSeconds = min(templatedSeconds, secondsSince(start));
+  }
+  reference.assemble();
+  const SparseMatrix& a = reference.matrix();
+  const SparseMatrix& b = templated.matrix();
+  double difference = (a.nnz() == b.nnz() && equal(a.colInd(), a.colInd() + a.nnz(), b.colInd())) ? 0.0 : -1.0;
+  for (int k = 0; difference >= 0.0 && k < a.nnz(); k++)
+  {
+    difference = max(difference, fabs(a.values()[k] - b.values()[k]));
+  }
+  cout << "P1 triangles (" << grid.getNumElts() << " elements): max difference to FEAssembler ";
+  if (difference < 0.0)
+    cout << "(patterns differ)";
+  else
+    cout << scientific << setprecision(3) << difference;
+  cout << fixed << setprecision(3) << ", numeric assembly " << referenceSeconds * 1e3 << " ms (FEAssembler) vs "
+       << templatedSeconds * 1e3 << " ms (ElementT)" << endl;
+
+  printHeader("Linear triangles on the plate, u = sin(pi x / 0.6) sin(pi y / 0.4)");
+  double previous = 0.0;
+  for (int level = 0; level <= levels; level++)
+  {
+    FEGrid refined(base);
+    refined.refine(level);
+    MeshT<ElementT<Triangle, 1> > mesh;
+    buildMesh(refined, mesh);
+    convergenceStep(mesh, plateSource, plateSolution, previous);
+  }
+
+  printHeader("Quadratic triangles on the plate");
+  previous = 0.0;
+  for (int level = 0; level < levels; level++)
+  {
+    FEGrid refined(base);
+    refined.refine(level);
+    MeshT<ElementT<Triangle, 2> > mesh;
+    buildMesh(refined, mesh);
+    convergenceStep(mesh, plateSource, plateSolution, previous);
+  }
+
+  printHeader("Linear tetrahedra on the unit cube, u = sin(pi x) sin(pi y) sin(pi z)");
+  previous = 0.0;
+  for (int cells = 2; cells <= maxCells; cells *= 2)
+  {
+    MeshT<ElementT<Tetrahedron, 1> > mesh;
+    buildCube(cells, mesh);
+    convergenceStep(mesh, cubeSource, cubeSolution, previous);
+  }
+  return (difference < 0.0 || difference > 1e-12) ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+#include "SolverService.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+/**
+ * @brief Print the usage of the service executable.
+ */
+static void usage(const char* a_name)
+{
+  cerr << "Usage: " << a_name << " serve <socket> [budget-MB=1024]" << endl
+       << "       " << a_name << " solve <socket> <mesh-prefix> [conductivity=30] [source=1] [repeat=1]" << endl
+       << "       " << a_name << " stats <socket>" << endl
+       << "       " << a_name << " shutdown <socket>" << endl;
+}
+
+/**
+ * @brief Persistent solver service and its command line client.
+ *
+ * "serve" runs a SolverService on a Unix domain socket: meshes, assembled matrices
+ * and IC(0) preconditioners stay cached between requests (see SolverService).
+ * "solve" sends SOLVE requests for the isotropic conductivity and uniform source of
+ * part1 and prints the iterations, the maximum temperature and the round-trip and
+ * service latencies; with repeat > 1 the same job is sent repeatedly, showing the
+ * cost of a warm request. "stats" and "shutdown" print the service statistics, the
+ * latter also stopping the service.
+ *
+ * @return Returns 0 on successful execution.
+ */
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+  string command(argv[1]);
+  string socketPath(argv[2]);
+
+  if (command == "serve")
+  {
+    double budget = (argc > 3) ? atof(argv[3]) : 1024.0;
+    SolverService service(socketPath, (size_t)(budget * 1e6));
+    if (!service.run())
+    {
+      cerr << "Error: Could not listen on " << socketPath << endl;
+      return 1;
+    }
+    service.printStatistics(cout);
+    return 0;
+  }
+
+  ServiceRequest request;
+  memset(&request, 0, sizeof(request));
+  ServiceResponse response;
+  vector<char> payload;
+  vector<double> rhs;
+
+  if (command == "stats" || command == "shutdown")
+  {
+    request.type = (command == "stats") ? SolverService::STATS : SolverService::SHUTDOWN;
+    if (!SolverService::request(socketPath, request, "", rhs, response, payload))
+    {
+      cerr << "Error: Could not reach the service at " << socketPath << endl;
+      return 1;
+    }
+    cout << string(payload.begin(), payload.end());
+    return 0;
+  }
+
+  if (command != "solve" || argc < 4)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+  // The service resolves paths against its own working directory, so send an absolute
+  // prefix; only the directory is resolved, so that .node and .elem stay side by side
+  string prefix(argv[3]);
+  size_t slash = prefix.rfind('/');
+  string directory = (slash == string::npos) ? "." : (slash == 0) ? "/" : prefix.substr(0, slash);
+  char resolved[PATH_MAX];
+  if (!realpath(directory.c_str(), resolved))
+  {
+    cerr << "Error: Could not resolve the mesh directory " << directory << endl;
+    return 1;
+  }
+  prefix = string(resolved) + (string(resolved) == "/" ? "" : "/") + prefix.substr(slash == string::npos ? 0 : slash + 1);
+  double k = (argc > 4) ? atof(argv[4]) : 30.0;
+  request.type = SolverService::SOLVE;
+  request.conductivity[0] = k;
+  request.conductivity[3] = k;
+  request.source = (argc > 5) ? atof(argv[5]) : 1.0;
+  request.tolerance = 1e-10;
+  int repeat = (argc > 6) ? max(1, atoi(argv[6])) : 1;
+
+  for (int r = 0; r < repeat; r++)
+  {
+    auto start = chrono::steady_clock::now();
+    if (!SolverService::request(socketPath, request, prefix, rhs, response, payload))
+    {
+      cerr << "Error: Could not reach the service at " << socketPath << endl;
+      return 1;
+    }
+    double roundTrip = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (response.status != SolverService::OK)
+    {
+      cerr << "Error: request failed with status " << response.status << endl;
+      return 1;
+    }
+    const double* u = reinterpret_cast<const double*>(payload.data());
+    double maxTemperature = (response.numValues > 0) ? *max_element(u, u + response.numValues) : 0.0;
+    cout << "Solve: " << response.iterations << " PCG iterations, relative residual " << response.residual
+         << ", max temperature " << maxTemperature << ", cache " << ((response.cacheHits & 2) ? "hit" : (response.cacheHits & 1) ? "mesh hit" : "miss")
+         << ", service " << response.seconds * 1e3 << " ms, round trip " << roundTrip * 1e3 << " ms" << endl;
+  }
+  return 0;
+}
@@ -1,4 +1,5 @@
 #include "GridFn.h"
+#include "Profiler.h"
 #include <iostream>
 #include <cmath>
 
@@ -6,24 +7,77 @@ GridFn::GridFn(int m, int n) : m(m), n(n) {
     gridValues.resize(m, std::vector<double>(n, 0));  // Initialize grid values to zero
 }
 
+// dx is adjusted so that the last of the m points lies exactly at x = l
+GridFn::GridFn(double l, double dx, double dt, double alpha)
+    : m(static_cast<int>(std::lround(l / dx)) + 1), n(1), alpha(alpha), dx(l / (m - 1)), dt(dt), l(l) {
+    gridValues.resize(m, std::vector<double>(n, 0));  // Initialize grid values to zero
+}
+
 void GridFn::initialize() {
+    PROFILE_SCOPE("initialize");
     // Initialize grid values with given initial conditions (f(x) = x * sqrt((l - x)^3))
     for (int i = 0; i < m; i++) {
         double x = i * dx;
         for (int j = 0; j < n; j++) {
             gridValues[i][j] = x * sqrt((l - x) * (l - x) * (l - x));  // f(x) = x * sqrt((l - x)^3)
-            printf("Initial Temperature at x=%f: %f\n", x, gridValues[i][j]);  // Print initial condition for debugging
+            if (verbose)
+                printf("Initial Temperature at x=%f: %f\n", x, gridValues[i][j]);  // Print initial condition for debugging
         }
     }
 }
 
 void GridFn::solve() {
-    // Implement the 1D heat diffusion equation solution using the three-point stencil method
-    for (int i = 1; i < m - 1; i++) {
-        double newTemperature = gridValues[i][0] + alpha * dt / (dx * dx) * (gridValues[i - 1][0] - 2 * gridValues[i][0] + gridValues[i + 1][0]);
-        printf("T[%d] updated from %f to %f\n", i, gridValues[i][0], newTemperature);  // Print updated temperature values
-        gridValues[i][0] = newTemperature;
+    // One step of the three-point stencil with the theta method and fixed end temperatures:
+    // (1 + 2 r theta) T'_i - r theta (T'_{i-1} + T'_{i+1}) = T_i + r (1 - theta) (T_{i-1} - 2 T_i + T_{i+1})
+    // with r = alpha dt / dx^2; theta = 0 is explicit, 1 implicit and 1/2 Crank-Nicolson.
+    double r = alpha * dt / (dx * dx);
+    double theta = (integrator == EXPLICIT) ? 0.0 : (integrator == IMPLICIT) ? 1.0 : 0.5;
+    previous.resize(m);
+    for (int i = 0; i < m; i++) {
+        previous[i] = gridValues[i][0];
     }
+
+    if (theta == 0.0) {
+        // Explicit update from the old values only
+        for (int i = 1; i < m - 1; i++) {
+            gridValues[i][0] = previous[i] + r * (previous[i - 1] - 2 * previous[i] + previous[i + 1]);
+        }
+    } else if (m > 2) {
+        // Thomas algorithm for the tridiagonal system of the interior points
+        diag.resize(m);
+        rhs.resize(m);
+        double offDiag = -r * theta;
+        for (int i = 1; i < m - 1; i++) {
+            rhs[i] = previous[i] + r * (1 - theta) * (previous[i - 1] - 2 * previous[i] + previous[i + 1]);
+        }
+        rhs[1] -= offDiag * previous[0];
+        rhs[m - 2] -= offDiag * previous[m - 1];
+        diag[1] = 1 + 2 * r * theta;
+        for (int i = 2; i < m - 1; i++) {
+            double w = offDiag / diag[i - 1];
+            diag[i] = 1 + 2 * r * theta - w * offDiag;
+            rhs[i] -= w * rhs[i - 1];
+        }
+        gridValues[m - 2][0] = rhs[m - 2] / diag[m - 2];
+        for (int i = m - 3; i >= 1; i--) {
+            gridValues[i][0] = (rhs[i] - offDiag * gridValues[i + 1][0]) / diag[i];
+        }
+    }
+
+    if (verbose) {
+        for (int i = 1; i < m - 1; i++) {
+            printf("T[%d] updated from %f to %f\n", i, previous[i], gridValues[i][0]);  // Print updated temperature values
+        }
+    }
+    time += dt;
+}
+
+void GridFn::setVerbose(bool v) {
+    verbose = v;
+}
+
+void GridFn::setIntegrator(Integrator integrator) {
+    this->integrator = integrator;
 }
 
 void GridFn::printGrid() {
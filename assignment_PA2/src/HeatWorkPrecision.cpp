@@ -0,0 +1,223 @@
+#include "GridFn.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Work-precision harness for the 1D heat solver (GridFn).
+//
+// u_t = alpha u_xx on [0, l] with u(0) = u(l) = 0 and u(x, 0) = f(x) = x (l - x)^(3/2)
+// has the exact solution
+//     u(x, t) = sum_k b_k sin(k pi x / l) exp(-alpha (k pi / l)^2 t),
+//     b_k = 2 / l * integral_0^l f(x) sin(k pi x / l) dx.
+// For every integrator, space step and time step the harness runs GridFn to the final
+// time, compares with the series and records the L2 / Linf errors against the wall time.
+
+// Fourier sine coefficients of f on [0, l]
+static std::vector<double> sineCoefficients(double l, int numTerms) {
+    // x = l - s^2 removes the (l - x)^(3/2) singularity of the derivatives:
+    // b_k = 2 / l * integral_0^sqrt(l) (l - s^2) s^3 sin(k pi (l - s^2) / l) 2 s ds,
+    // integrated with composite 5-point Gauss-Legendre on panels resolving the oscillation.
+    const double nodes[5] = {0.0, -0.5384693101056831, 0.5384693101056831, -0.9061798459386640, 0.9061798459386640};
+    const double weights[5] = {0.5688888888888889, 0.4786286704993665, 0.4786286704993665,
+                               0.2369268850561891, 0.2369268850561891};
+    std::vector<double> b(numTerms + 1, 0.0);
+    double upper = sqrt(l);
+    for (int k = 1; k <= numTerms; k++) {
+        int panels = 64 + 8 * k;
+        double h = upper / panels;
+        double sum = 0.0;
+        for (int p = 0; p < panels; p++) {
+            double mid = (p + 0.5) * h;
+            for (int q = 0; q < 5; q++) {
+                double s = mid + 0.5 * h * nodes[q];
+                double x = l - s * s;
+                sum += weights[q] * x * s * s * s * sin(k * M_PI * x / l) * 2 * s;
+            }
+        }
+        b[k] = 2.0 / l * 0.5 * h * sum;
+    }
+    return b;
+}
+
+// Exact temperature at x and time t from the first numTerms coefficients
+static double exactSolution(const std::vector<double>& b, double l, double alpha, double x, double t) {
+    double u = 0.0;
+    for (size_t k = 1; k < b.size(); k++) {
+        double wave = k * M_PI / l;
+        u += b[k] * sin(wave * x) * exp(-alpha * wave * wave * t);
+    }
+    return u;
+}
+
+// One point of the work-precision data
+struct Run {
+    const char* integrator;
+    double dx, dt, r;
+    int points, steps;
+    double seconds, l2, linf;
+};
+
+// Parse a positive number; false for anything else (empty, trailing characters, <= 0, inf/nan)
+static bool parsePositive(const std::string& text, double& value) {
+    const char* begin = text.c_str();
+    char* end = nullptr;
+    value = strtod(begin, &end);
+    return end != begin && *end == '\0' && std::isfinite(value) && value > 0;
+}
+
+// Parse a positive integer; false for anything else
+static bool parsePositive(const std::string& text, int& value) {
+    const char* begin = text.c_str();
+    char* end = nullptr;
+    long parsed = strtol(begin, &end, 10);
+    if (end == begin || *end != '\0' || parsed <= 0 || parsed > 1000000000)
+        return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+// Parse a comma-separated list of positive numbers; false if an entry is invalid or the list is empty
+template <typename T>
+static bool parseList(const std::string& list, std::vector<T>& values) {
+    values.clear();
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos)
+            end = list.size();
+        T value;
+        if (!parsePositive(list.substr(start, end - start), value))
+            return false;
+        values.push_back(value);
+        start = end + 1;
+    }
+    return !values.empty();
+}
+
+// Options: -L <length> (1.2), -a <alpha> (1), -T <final time> (0.1),
+// -x <space steps, e.g. 0.1,0.05>, -s <step counts, e.g. 10,100,1000>, -n <repetitions> (3),
+// -e <L2 error target> (1e-4), -o <csv file> (heat_workprecision.csv).
+// All numbers must be positive; on a bad option the usage is printed and 1 returned.
+int main(int argc, char* argv[]) {
+    double l = 1.2;
+    double alpha = 1.0;
+    double finalTime = 0.1;
+    std::vector<double> spaceSteps;
+    parseList("0.1,0.05,0.025,0.0125,0.00625,0.003125", spaceSteps);
+    std::vector<int> stepCounts;
+    parseList("10,20,40,80,160,320,640,1280,2560,5120,10240", stepCounts);
+    int repetitions = 3;
+    double target = 1e-4;
+    std::string output = "heat_workprecision.csv";
+    for (int i = 1; i < argc; i += 2) {
+        std::string arg(argv[i]);
+        bool valid = true;
+        if (i + 1 >= argc) valid = false;
+        else if (arg == "-L") valid = parsePositive(argv[i + 1], l);
+        else if (arg == "-a") valid = parsePositive(argv[i + 1], alpha);
+        else if (arg == "-T") valid = parsePositive(argv[i + 1], finalTime);
+        else if (arg == "-x") valid = parseList(argv[i + 1], spaceSteps);
+        else if (arg == "-s") valid = parseList(argv[i + 1], stepCounts);
+        else if (arg == "-n") valid = parsePositive(argv[i + 1], repetitions);
+        else if (arg == "-e") valid = parsePositive(argv[i + 1], target);
+        else if (arg == "-o") output = argv[i + 1];
+        else valid = false;
+        if (!valid) {
+            std::cerr << "Usage: " << argv[0] << " [-L length] [-a alpha] [-T final-time] [-x dx-list] [-s steps-list]"
+                      << " [-n repetitions] [-e l2-target] [-o csv-file]" << std::endl
+                      << "All numbers must be positive, lists are comma-separated" << std::endl;
+            return 1;
+        }
+    }
+    for (size_t ix = 0; ix < spaceSteps.size(); ix++) {
+        if (spaceSteps[ix] >= l) {
+            std::cerr << "Error: the space step " << spaceSteps[ix] << " must be smaller than the length " << l << std::endl;
+            return 1;
+        }
+    }
+
+    // Keep the terms whose decay factor at the final time is above 1e-17 (|b_k| < 1)
+    int numTerms = 1;
+    while (numTerms < 100000 && alpha * pow(numTerms * M_PI / l, 2) * finalTime < 39.0)
+        numTerms++;
+    std::vector<double> b = sineCoefficients(l, numTerms);
+
+    const GridFn::Integrator integrators[3] = {GridFn::EXPLICIT, GridFn::IMPLICIT, GridFn::CRANK_NICOLSON};
+    const char* names[3] = {"explicit", "implicit", "crank-nicolson"};
+    std::vector<Run> runs;
+    for (int s = 0; s < 3; s++) {
+        for (size_t ix = 0; ix < spaceSteps.size(); ix++) {
+            for (size_t it = 0; it < stepCounts.size(); it++) {
+                int steps = stepCounts[it];
+                double dt = finalTime / steps;
+                GridFn grid(l, spaceSteps[ix], dt, alpha);
+                double dx = grid.position(1);
+                double r = alpha * dt / (dx * dx);
+                // Forward Euler is unstable beyond r = 1/2
+                if (integrators[s] == GridFn::EXPLICIT && r > 0.5)
+                    continue;
+
+                double best = 1e300;
+                for (int rep = 0; rep < repetitions; rep++) {
+                    auto start = std::chrono::steady_clock::now();
+                    grid = GridFn(l, spaceSteps[ix], dt, alpha);
+                    grid.setVerbose(false);
+                    grid.setIntegrator(integrators[s]);
+                    grid.initialize();
+                    {
+                        PROFILE_SCOPE("time_stepping");
+                        for (int step = 0; step < steps; step++)
+                            grid.solve();
+                    }
+                    PROFILE_COUNT("time_steps", steps);
+                    best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+                }
+
+                double sum = 0.0, linf = 0.0;
+                for (int i = 0; i < grid.size(); i++) {
+                    double error = fabs(grid.value(i) - exactSolution(b, l, alpha, grid.position(i), grid.getTime()));
+                    sum += error * error;
+                    linf = std::max(linf, error);
+                }
+                Run run = {names[s], dx, dt, r, grid.size(), steps, best, sqrt(sum * dx), linf};
+                runs.push_back(run);
+            }
+        }
+    }
+
+    FILE* fp = fopen(output.c_str(), "w");
+    if (!fp) {
+        std::cerr << "Error: Could not open file " << output << std::endl;
+        return 1;
+    }
+    fprintf(fp, "integrator,dx,dt,r,points,steps,seconds,l2_error,linf_error\n");
+    for (size_t i = 0; i < runs.size(); i++) {
+        const Run& run = runs[i];
+        fprintf(fp, "%s,%.6e,%.6e,%.4e,%d,%d,%.6e,%.6e,%.6e\n", run.integrator, run.dx, run.dt, run.r, run.points,
+                run.steps, run.seconds, run.l2, run.linf);
+    }
+    fclose(fp);
+
+    // Per integrator, the cheapest configuration reaching the L2 target
+    printf("%d runs written to %s (%d series terms, T = %g)\n", (int)runs.size(), output.c_str(), numTerms, finalTime);
+    printf("Cheapest configuration with L2 error <= %g:\n", target);
+    for (int s = 0; s < 3; s++) {
+        const Run* cheapest = NULL;
+        for (size_t i = 0; i < runs.size(); i++) {
+            if (runs[i].integrator == names[s] && runs[i].l2 <= target && (!cheapest || runs[i].seconds < cheapest->seconds))
+                cheapest = &runs[i];
+        }
+        if (cheapest)
+            printf("  %-15s dx = %-10g dt = %-10g L2 = %.3e Linf = %.3e time = %.3e s\n", names[s], cheapest->dx,
+                   cheapest->dt, cheapest->l2, cheapest->linf, cheapest->seconds);
+        else
+            printf("  %-15s none of the runs reached the target\n", names[s]);
+    }
+    return 0;
+}
@@ -0,0 +1,313 @@
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "MatrixCache.h"
+#include "ContentHash.h"
+#include "Profiler.h"
+
+/** Alignment of the arrays in a cache file. */
+static const uint64_t s_alignment = 64;
+
+/**
+ * @brief Checksum of a buffer, FNV-1a over 64-bit words.
+ *
+ * @param a_data Buffer; a_bytes must be a multiple of 8.
+ * @param a_bytes Size in bytes.
+ * @return The checksum.
+ */
+static uint64_t checksum(const void* a_data, const size_t& a_bytes)
+{
+  const uint64_t* words = static_cast<const uint64_t*>(a_data);
+  uint64_t hash = ContentHash::s_offset;
+  for (size_t i = 0; i < a_bytes / sizeof(uint64_t); i++)
+  {
+    hash = ContentHash::add(hash, words[i]);
+  }
+  return hash;
+}
+
+/**
+ * @brief Round up to the array alignment.
+ */
+static uint64_t aligned(const uint64_t& a_offset)
+{
+  return (a_offset + s_alignment - 1) / s_alignment * s_alignment;
+}
+
+/**
+ * @brief Constructor of an empty (unmapped) cache entry.
+ */
+MatrixCache::MatrixCache() : m_mapping(NULL), m_bytes(0), m_header(NULL)
+{
+}
+
+/**
+ * @brief Destructor unmapping the file.
+ */
+MatrixCache::~MatrixCache()
+{
+  close();
+}
+
+/**
+ * @brief Unmap the current file.
+ */
+void MatrixCache::close()
+{
+  m_matrix = SparseMatrix();
+  if (m_mapping)
+    munmap(m_mapping, m_bytes);
+  m_mapping = NULL;
+  m_bytes = 0;
+  m_header = NULL;
+}
+
+/**
+ * @brief Hash the contents of input files together with numeric parameters.
+ *
+ * @param a_files Files whose contents determine the system (mesh, materials).
+ * @param a_parameters Parameters of the assembly (conductivity, refinement levels, ...).
+ * @param a_key Resulting key.
+ * @return False if a file could not be read.
+ * The file format version is hashed too, so a format change invalidates all files.
+ */
+bool MatrixCache::computeKey(const vector<std::string>& a_files, const vector<double>& a_parameters, uint64_t& a_key)
+{
+  uint64_t hash = ContentHash::add(ContentHash::s_offset, s_version);
+  if (!ContentHash::addFiles(a_files, hash))
+    return false;
+  for (size_t p = 0; p < a_parameters.size(); p++)
+  {
+    uint64_t bits;
+    memcpy(&bits, &a_parameters[p], sizeof(bits));
+    hash = ContentHash::add(hash, bits);
+  }
+  a_key = hash;
+  return true;
+}
+
+/**
+ * @brief Name of the cache file of a key.
+ *
+ * @param a_directory Cache directory.
+ * @param a_key The key.
+ * @return a_directory/<16 hex digits>.femc
+ */
+std::string MatrixCache::fileName(const std::string& a_directory, const uint64_t& a_key)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "/%016llx.femc", (unsigned long long)a_key);
+  return a_directory + name;
+}
+
+/**
+ * @brief Map and validate a cache file.
+ *
+ * @param a_fileName The cache file.
+ * @param a_key Key the file must have been written with.
+ * @return False on a miss: missing, truncated, corrupt or stale file.
+ * The mapping is private and writable, so changes to the matrix values (e.g.
+ * zero()) stay in memory and never reach the file.
+ */
+bool MatrixCache::open(const std::string& a_fileName, const uint64_t& a_key)
+{
+  PROFILE_SCOPE("cache_open");
+  close();
+  int fd = ::open(a_fileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header))
+  {
+    ::close(fd);
+    return false;
+  }
+  m_bytes = st.st_size;
+  m_mapping = mmap(NULL, m_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (m_mapping == MAP_FAILED)
+  {
+    m_mapping = NULL;
+    m_bytes = 0;
+    return false;
+  }
+  m_header = static_cast<const Header*>(m_mapping);
+  const Header& h = *m_header;
+
+  // Header: identity, sizes and checksum
+  bool valid = h.magic == s_magic && h.version == s_version && h.headerBytes == sizeof(Header) && h.key == a_key &&
+               h.fileBytes == m_bytes && h.headerChecksum == checksum(&h, offsetof(Header, headerChecksum)) &&
+               h.numRows >= 0 && h.nnz >= 0 && h.factorNnz >= 0 && m_bytes % sizeof(uint64_t) == 0;
+
+  // Every array must lie inside the file and be aligned
+  const uint64_t lengths[NUM_ARRAYS] = {
+    (h.numRows + 1) * sizeof(int), h.nnz * sizeof(int), h.nnz * sizeof(double), h.numRows * sizeof(double),
+    (h.numRows + 1) * sizeof(int), h.factorNnz * sizeof(int), h.factorNnz * sizeof(double),
+    h.numRows * sizeof(double)};
+  for (int a = 0; valid && a < NUM_ARRAYS; a++)
+  {
+    bool present = a < L_ROW_PTR || (h.preconditioner == PCGSolver::IC0 && a != INV_DIAG) ||
+                   (h.preconditioner >= 0 && a == INV_DIAG);
+    if (present)
+      valid = h.offsets[a] >= sizeof(Header) && h.offsets[a] % s_alignment == 0 &&
+              h.offsets[a] + lengths[a] <= m_bytes;
+  }
+
+  // Payload integrity and CSR structure
+  valid = valid && h.payloadChecksum == checksum(static_cast<char*>(m_mapping) + sizeof(Header), m_bytes - sizeof(Header));
+  if (valid)
+  {
+    const int* rowPtr = array<int>(ROW_PTR);
+    valid = rowPtr[0] == 0 && rowPtr[h.numRows] == h.nnz;
+    for (int i = 0; valid && i < h.numRows; i++)
+    {
+      valid = rowPtr[i] <= rowPtr[i + 1];
+    }
+    if (valid && h.preconditioner == PCGSolver::IC0)
+    {
+      const int* lRowPtr = array<int>(L_ROW_PTR);
+      valid = lRowPtr[0] == 0 && lRowPtr[h.numRows] == h.factorNnz;
+    }
+  }
+  if (!valid)
+  {
+    close();
+    return false;
+  }
+
+  m_matrix = SparseMatrix(h.numRows, array<int>(ROW_PTR), array<int>(COL_IND), array<double>(VALUES));
+  PROFILE_COUNT("bytes_mapped", m_bytes);
+  return true;
+}
+
+/**
+ * @brief Write a cache file.
+ *
+ * @param a_fileName The cache file.
+ * @param a_key The key.
+ * @param a_matrix The assembled matrix.
+ * @param a_load The load vector.
+ * @param a_solver Solver whose preconditioner is stored, or NULL.
+ * @return False if the file could not be written.
+ */
+bool MatrixCache::write(const std::string& a_fileName, const uint64_t& a_key, const SparseMatrix& a_matrix,
+                        const double* a_load, const PCGSolver* a_solver)
+{
+  PROFILE_SCOPE("cache_write");
+  int n = a_matrix.numRows();
+  vector<int> lRowPtr, lColInd;
+  vector<double> lValues, invDiag;
+  if (a_solver)
+    a_solver->getFactor(lRowPtr, lColInd, lValues, invDiag);
+
+  Header h;
+  memset(&h, 0, sizeof(h));
+  h.magic = s_magic;
+  h.version = s_version;
+  h.headerBytes = sizeof(Header);
+  h.key = a_key;
+  h.numRows = n;
+  h.nnz = a_matrix.nnz();
+  h.preconditioner = a_solver ? (int)a_solver->getPreconditioner() : -1;
+  h.factorNnz = lColInd.size();
+
+  const void* data[NUM_ARRAYS] = {a_matrix.rowPtr(), a_matrix.colInd(), a_matrix.values(), a_load,
+                                  lRowPtr.data(), lColInd.data(), lValues.data(), invDiag.data()};
+  const uint64_t lengths[NUM_ARRAYS] = {
+    (n + 1) * sizeof(int), h.nnz * sizeof(int), h.nnz * sizeof(double), n * sizeof(double),
+    lRowPtr.size() * sizeof(int), lColInd.size() * sizeof(int), lValues.size() * sizeof(double),
+    invDiag.size() * sizeof(double)};
+
+  // Lay out the payload in memory, so that its checksum goes into the header
+  uint64_t offset = sizeof(Header);
+  for (int a = 0; a < NUM_ARRAYS; a++)
+  {
+    if (lengths[a] == 0)
+      continue;
+    offset = aligned(offset);
+    h.offsets[a] = offset;
+    offset += lengths[a];
+  }
+  h.fileBytes = aligned(offset);
+  vector<uint64_t> file(h.fileBytes / sizeof(uint64_t), 0);
+  char* bytes = reinterpret_cast<char*>(file.data());
+  for (int a = 0; a < NUM_ARRAYS; a++)
+  {
+    if (lengths[a] > 0)
+      memcpy(bytes + h.offsets[a], data[a], lengths[a]);
+  }
+  h.payloadChecksum = checksum(bytes + sizeof(Header), h.fileBytes - sizeof(Header));
+  h.headerChecksum = checksum(&h, offsetof(Header, headerChecksum));
+  memcpy(bytes, &h, sizeof(h));
+
+  std::string temporary = a_fileName + ".tmp" + std::to_string((long)getpid());
+  FILE* fp = fopen(temporary.c_str(), "wb");
+  if (!fp)
+    return false;
+  bool ok = fwrite(bytes, 1, h.fileBytes, fp) == h.fileBytes;
+  ok = (fclose(fp) == 0) && ok;
+  ok = ok && rename(temporary.c_str(), a_fileName.c_str()) == 0;
+  if (!ok)
+    remove(temporary.c_str());
+  PROFILE_COUNT("bytes_written", h.fileBytes);
+  return ok;
+}
+
+/**
+ * @brief The mapped matrix (valid after a successful open()).
+ *
+ * @return A view into the mapping.
+ */
+const SparseMatrix& MatrixCache::matrix() const
+{
+  return m_matrix;
+}
+
+/**
+ * @brief The mapped load vector.
+ *
+ * @return numRows() values.
+ */
+const double* MatrixCache::load() const
+{
+  return array<double>(LOAD);
+}
+
+/**
+ * @brief Check whether the file holds a preconditioner.
+ *
+ * @return True if makeSolver() does not need to factor.
+ */
+bool MatrixCache::hasPreconditioner() const
+{
+  return m_header && m_header->preconditioner >= 0;
+}
+
+/**
+ * @brief Create a solver for the mapped matrix.
+ *
+ * @return A solver using the mapped preconditioner, or building IC(0) if none was stored.
+ */
+PCGSolver* MatrixCache::makeSolver() const
+{
+  if (!hasPreconditioner())
+    return new PCGSolver(m_matrix, PCGSolver::IC0);
+  PCGSolver::Preconditioner preconditioner = (PCGSolver::Preconditioner)m_header->preconditioner;
+  if (preconditioner == PCGSolver::IC0)
+    return new PCGSolver(m_matrix, preconditioner, array<int>(L_ROW_PTR), array<int>(L_COL_IND),
+                         array<double>(L_VALUES), array<double>(INV_DIAG));
+  return new PCGSolver(m_matrix, preconditioner, NULL, NULL, NULL, array<double>(INV_DIAG));
+}
+
+/**
+ * @brief Get the size of the mapping.
+ *
+ * @return The size in bytes.
+ */
+size_t MatrixCache::mappedBytes() const
+{
+  return m_bytes;
+}
@@ -0,0 +1,384 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include "MeshPartition.h"
+#include "Profiler.h"
+
+/**
+ * @brief Spread the low 16 bits of a value to the even bit positions.
+ */
+static uint32_t spreadBits(uint32_t a_value)
+{
+  a_value &= 0xffff;
+  a_value = (a_value | (a_value << 8)) & 0x00ff00ff;
+  a_value = (a_value | (a_value << 4)) & 0x0f0f0f0f;
+  a_value = (a_value | (a_value << 2)) & 0x33333333;
+  a_value = (a_value | (a_value << 1)) & 0x55555555;
+  return a_value;
+}
+
+/**
+ * @brief Constructor partitioning a grid.
+ *
+ * @param a_grid The grid; must outlive the partition.
+ * @param a_numParts Number of partitions.
+ * @param a_method Partitioning method.
+ */
+MeshPartition::MeshPartition(const FEGrid& a_grid, const int& a_numParts, const Method& a_method)
+  : m_grid(a_grid), m_numParts(max(1, a_numParts)), m_method(a_method)
+{
+  PROFILE_SCOPE("partition");
+  int numElts = m_grid.getNumElts();
+  m_centroids.assign(numElts * DIM, 0.0);
+  for (int e = 0; e < numElts; e++)
+  {
+    for (int m = 0; m < VERTICES; m++)
+    {
+      double x[DIM];
+      m_grid.getNode(e, m).getPosition(x);
+      for (int d = 0; d < DIM; d++)
+      {
+        m_centroids[e * DIM + d] += x[d] / VERTICES;
+      }
+    }
+  }
+
+  vector<int> order(numElts);
+  for (int e = 0; e < numElts; e++)
+  {
+    order[e] = e;
+  }
+  m_partOfElement.assign(numElts, 0);
+  if (m_method == RCB)
+  {
+    bisect(order, 0, numElts, 0, m_numParts);
+  }
+  else
+  {
+    // Quantize the centroids to 16 bits per axis over the bounding box and cut the curve
+    double lo[DIM], hi[DIM];
+    for (int d = 0; d < DIM; d++)
+    {
+      lo[d] = 1e300;
+      hi[d] = -1e300;
+    }
+    for (int e = 0; e < numElts; e++)
+    {
+      for (int d = 0; d < DIM; d++)
+      {
+        lo[d] = min(lo[d], m_centroids[e * DIM + d]);
+        hi[d] = max(hi[d], m_centroids[e * DIM + d]);
+      }
+    }
+    vector<uint32_t> codes(numElts);
+    for (int e = 0; e < numElts; e++)
+    {
+      uint32_t q[DIM];
+      for (int d = 0; d < DIM; d++)
+      {
+        double extent = max(hi[d] - lo[d], 1e-300);
+        q[d] = (uint32_t)((m_centroids[e * DIM + d] - lo[d]) / extent * 65535.0);
+      }
+      codes[e] = spreadBits(q[0]) | (spreadBits(q[1]) << 1);
+    }
+    stable_sort(order.begin(), order.end(), [&codes](int a, int b) { return codes[a] < codes[b]; });
+    for (int i = 0; i < numElts; i++)
+    {
+      m_partOfElement[order[i]] = (long)i * m_numParts / max(1, numElts);
+    }
+  }
+
+  m_elements.assign(m_numParts, vector<int>());
+  for (int e = 0; e < numElts; e++)
+  {
+    m_elements[m_partOfElement[e]].push_back(e);
+  }
+  buildRows();
+}
+
+/**
+ * @brief Recursive coordinate bisection of a range of elements.
+ *
+ * @param a_order Element numbers; the range is reordered so that each partition is contiguous.
+ * @param a_begin First position of the range.
+ * @param a_end One past the last position.
+ * @param a_firstPart First partition of the range.
+ * @param a_numParts Number of partitions of the range.
+ * The cut is placed so that both sides get elements in proportion to their
+ * number of partitions, which also handles partition counts that are not powers of two.
+ */
+void MeshPartition::bisect(vector<int>& a_order, const int& a_begin, const int& a_end, const int& a_firstPart,
+                           const int& a_numParts)
+{
+  if (a_numParts == 1)
+  {
+    for (int i = a_begin; i < a_end; i++)
+    {
+      m_partOfElement[a_order[i]] = a_firstPart;
+    }
+    return;
+  }
+  double lo[DIM], hi[DIM];
+  for (int d = 0; d < DIM; d++)
+  {
+    lo[d] = 1e300;
+    hi[d] = -1e300;
+  }
+  for (int i = a_begin; i < a_end; i++)
+  {
+    for (int d = 0; d < DIM; d++)
+    {
+      lo[d] = min(lo[d], m_centroids[a_order[i] * DIM + d]);
+      hi[d] = max(hi[d], m_centroids[a_order[i] * DIM + d]);
+    }
+  }
+  int axis = 0;
+  for (int d = 1; d < DIM; d++)
+  {
+    if (hi[d] - lo[d] > hi[axis] - lo[axis])
+      axis = d;
+  }
+  int leftParts = a_numParts / 2;
+  int middle = a_begin + (long)(a_end - a_begin) * leftParts / a_numParts;
+  const vector<double>& centroids = m_centroids;
+  nth_element(a_order.begin() + a_begin, a_order.begin() + middle, a_order.begin() + a_end,
+              [&centroids, axis](int a, int b) {
+                double xa = centroids[a * DIM + axis], xb = centroids[b * DIM + axis];
+                return xa < xb || (xa == xb && a < b);
+              });
+  bisect(a_order, a_begin, middle, a_firstPart, leftParts);
+  bisect(a_order, middle, a_end, a_firstPart + leftParts, a_numParts - leftParts);
+}
+
+/**
+ * @brief Number the rows and build the interface lists from the element partitions.
+ */
+void MeshPartition::buildRows()
+{
+  int numRows = m_grid.getNumInteriorNodes();
+  vector<int> ownerOfNode(numRows, m_numParts);
+  for (int p = 0; p < m_numParts; p++)
+  {
+    for (size_t i = 0; i < m_elements[p].size(); i++)
+    {
+      for (int m = 0; m < VERTICES; m++)
+      {
+        int id = m_grid.getNode(m_elements[p][i], m).getInteriorNodeID();
+        if (id >= 0)
+          ownerOfNode[id] = min(ownerOfNode[id], p);
+      }
+    }
+  }
+
+  // Contiguous rows per partition, in interior node order within a partition
+  m_rowBegin.assign(m_numParts + 1, 0);
+  for (int id = 0; id < numRows; id++)
+  {
+    if (ownerOfNode[id] == m_numParts)
+      ownerOfNode[id] = 0;
+    m_rowBegin[ownerOfNode[id] + 1]++;
+  }
+  for (int p = 0; p < m_numParts; p++)
+  {
+    m_rowBegin[p + 1] += m_rowBegin[p];
+  }
+  vector<int> next(m_rowBegin.begin(), m_rowBegin.end() - 1);
+  m_rowOf.resize(numRows);
+  m_interiorNodeOf.resize(numRows);
+  for (int id = 0; id < numRows; id++)
+  {
+    int row = next[ownerOfNode[id]]++;
+    m_rowOf[id] = row;
+    m_interiorNodeOf[row] = id;
+  }
+
+  m_interfaceRows.assign(m_numParts, vector<int>());
+  m_neighbors.assign(m_numParts, vector<int>());
+  for (int p = 0; p < m_numParts; p++)
+  {
+    vector<int>& rows = m_interfaceRows[p];
+    for (size_t i = 0; i < m_elements[p].size(); i++)
+    {
+      for (int m = 0; m < VERTICES; m++)
+      {
+        int id = m_grid.getNode(m_elements[p][i], m).getInteriorNodeID();
+        if (id >= 0 && ownerOfNode[id] != p)
+          rows.push_back(m_rowOf[id]);
+      }
+    }
+    sort(rows.begin(), rows.end());
+    rows.erase(unique(rows.begin(), rows.end()), rows.end());
+    for (size_t r = 0; r < rows.size(); r++)
+    {
+      m_neighbors[p].push_back(owner(rows[r]));
+    }
+    m_neighbors[p].erase(unique(m_neighbors[p].begin(), m_neighbors[p].end()), m_neighbors[p].end());
+  }
+}
+
+/**
+ * @brief Get the number of partitions.
+ *
+ * @return The number of partitions.
+ */
+int MeshPartition::numParts() const
+{
+  return m_numParts;
+}
+
+/**
+ * @brief Get the grid.
+ *
+ * @return The partitioned grid.
+ */
+const FEGrid& MeshPartition::grid() const
+{
+  return m_grid;
+}
+
+/**
+ * @brief Elements of a partition, in increasing order.
+ *
+ * @param a_part The partition.
+ * @return The element numbers.
+ */
+const vector<int>& MeshPartition::elements(const int& a_part) const
+{
+  return m_elements[a_part];
+}
+
+/**
+ * @brief First row owned by a partition (partition numbering).
+ *
+ * @param a_part The partition.
+ * @return The first row; the rows up to rowBegin(a_part + 1) are owned.
+ */
+int MeshPartition::rowBegin(const int& a_part) const
+{
+  return m_rowBegin[a_part];
+}
+
+/**
+ * @brief Partition of a row.
+ *
+ * @param a_row Row in partition numbering.
+ * @return The owning partition.
+ */
+int MeshPartition::owner(const int& a_row) const
+{
+  return upper_bound(m_rowBegin.begin(), m_rowBegin.end(), a_row) - m_rowBegin.begin() - 1;
+}
+
+/**
+ * @brief Partition numbering of the interior nodes.
+ *
+ * @return The row of every interior node ID.
+ */
+const vector<int>& MeshPartition::rowOf() const
+{
+  return m_rowOf;
+}
+
+/**
+ * @brief Interior node ID of every row, the inverse of rowOf().
+ *
+ * @return The interior node ID of every row.
+ */
+const vector<int>& MeshPartition::interiorNodeOf() const
+{
+  return m_interiorNodeOf;
+}
+
+/**
+ * @brief Rows of other partitions that the elements of a partition contribute to.
+ *
+ * @param a_part The partition.
+ * @return The rows in increasing order.
+ */
+const vector<int>& MeshPartition::interfaceRows(const int& a_part) const
+{
+  return m_interfaceRows[a_part];
+}
+
+/**
+ * @brief Partitions owning the interface rows of a partition.
+ *
+ * @param a_part The partition.
+ * @return The neighbours in increasing order.
+ */
+const vector<int>& MeshPartition::neighbors(const int& a_part) const
+{
+  return m_neighbors[a_part];
+}
+
+/**
+ * @brief Elements adjacent to each interior node (CSR, by interior node ID).
+ *
+ * @param a_offsets Filled with numInteriorNodes + 1 offsets.
+ * @param a_elements Filled with the element numbers.
+ */
+void MeshPartition::nodeElements(vector<int>& a_offsets, vector<int>& a_elements) const
+{
+  int numRows = m_grid.getNumInteriorNodes();
+  int numElts = m_grid.getNumElts();
+  a_offsets.assign(numRows + 1, 0);
+  for (int e = 0; e < numElts; e++)
+  {
+    for (int m = 0; m < VERTICES; m++)
+    {
+      int id = m_grid.getNode(e, m).getInteriorNodeID();
+      if (id >= 0)
+        a_offsets[id + 1]++;
+    }
+  }
+  for (int id = 0; id < numRows; id++)
+  {
+    a_offsets[id + 1] += a_offsets[id];
+  }
+  a_elements.resize(a_offsets[numRows]);
+  vector<int> next(a_offsets.begin(), a_offsets.end() - 1);
+  for (int e = 0; e < numElts; e++)
+  {
+    for (int m = 0; m < VERTICES; m++)
+    {
+      int id = m_grid.getNode(e, m).getInteriorNodeID();
+      if (id >= 0)
+        a_elements[next[id]++] = e;
+    }
+  }
+}
+
+/**
+ * @brief Print sizes, balance and interface size of the partitions.
+ *
+ * @param a_os Output stream.
+ * The imbalance is the largest partition over the mean (1 is perfect); the
+ * interface is the number of distinct rows receiving contributions from
+ * partitions other than their owner.
+ */
+void MeshPartition::printStatistics(ostream& a_os) const
+{
+  char line[160];
+  size_t maxElements = 0;
+  vector<int> interface;
+  for (int p = 0; p < m_numParts; p++)
+  {
+    maxElements = max(maxElements, m_elements[p].size());
+    interface.insert(interface.end(), m_interfaceRows[p].begin(), m_interfaceRows[p].end());
+  }
+  sort(interface.begin(), interface.end());
+  interface.erase(unique(interface.begin(), interface.end()), interface.end());
+  double mean = (double)m_grid.getNumElts() / m_numParts;
+  snprintf(line, sizeof(line), "Partition (%s): %d parts, element imbalance %.3f, %d of %d rows on the interface\n",
+           (m_method == RCB) ? "RCB" : "Morton", m_numParts, maxElements / max(mean, 1e-300),
+           (int)interface.size(), m_rowBegin[m_numParts]);
+  a_os << line;
+  for (int p = 0; p < m_numParts; p++)
+  {
+    snprintf(line, sizeof(line), "  part %-4d %10d elements %10d rows %8d interface rows %4d neighbours\n", p,
+             (int)m_elements[p].size(), m_rowBegin[p + 1] - m_rowBegin[p], (int)m_interfaceRows[p].size(),
+             (int)m_neighbors[p].size());
+    a_os << line;
+  }
+}
@@ -0,0 +1,134 @@
+#include <map>
+#include "MeshT.h"
+
+/**
+ * @brief Build the linear triangle mesh of an FEGrid, keeping its interior numbering.
+ *
+ * @param a_grid The grid.
+ * @param a_mesh The mesh to fill.
+ */
+void buildMesh(const FEGrid& a_grid, MeshT<ElementT<Triangle, 1> >& a_mesh)
+{
+  int numNodes = a_grid.getNumNodes();
+  a_mesh.coordinates.resize(numNodes * DIM);
+  a_mesh.interiorID.resize(numNodes);
+  for (int i = 0; i < numNodes; i++)
+  {
+    a_grid.node(i).getPosition(&a_mesh.coordinates[i * DIM]);
+    a_mesh.interiorID[i] = a_grid.node(i).getInteriorNodeID();
+  }
+  a_mesh.connectivity.resize(a_grid.getNumElts() * VERTICES);
+  for (int e = 0; e < a_grid.getNumElts(); e++)
+  {
+    a_grid.element(e).vertices(&a_mesh.connectivity[e * VERTICES]);
+  }
+  a_mesh.numInteriorNodes = a_grid.getNumInteriorNodes();
+}
+
+/**
+ * @brief Build the quadratic triangle mesh of an FEGrid by adding the edge midpoints.
+ *
+ * @param a_grid The grid.
+ * @param a_mesh The mesh to fill.
+ */
+void buildMesh(const FEGrid& a_grid, MeshT<ElementT<Triangle, 2> >& a_mesh)
+{
+  MeshT<ElementT<Triangle, 1> > linear;
+  buildMesh(a_grid, linear);
+  a_mesh.coordinates = linear.coordinates;
+  a_mesh.interiorID = linear.interiorID;
+  a_mesh.numInteriorNodes = linear.numInteriorNodes;
+
+  // Edges of each element in ElementT<Triangle, 2> order: 0-1, 1-2, 2-0
+  const int edges[3][2] = {{0, 1}, {1, 2}, {2, 0}};
+  map<pair<int, int>, int> midpoints;
+  int numElts = linear.getNumElts();
+  a_mesh.connectivity.resize(numElts * 6);
+  for (int e = 0; e < numElts; e++)
+  {
+    const int* vertices = &linear.connectivity[e * 3];
+    int* nodes = &a_mesh.connectivity[e * 6];
+    for (int m = 0; m < 3; m++)
+    {
+      nodes[m] = vertices[m];
+    }
+    for (int k = 0; k < 3; k++)
+    {
+      int a = vertices[edges[k][0]], b = vertices[edges[k][1]];
+      pair<int, int> key(min(a, b), max(a, b));
+      map<pair<int, int>, int>::iterator found = midpoints.find(key);
+      if (found != midpoints.end())
+      {
+        nodes[3 + k] = found->second;
+        continue;
+      }
+      int node = a_mesh.getNumNodes();
+      double x[DIM];
+      for (int r = 0; r < DIM; r++)
+      {
+        x[r] = 0.5 * (linear.coordinates[a * DIM + r] + linear.coordinates[b * DIM + r]);
+        a_mesh.coordinates.push_back(x[r]);
+      }
+      a_mesh.interiorID.push_back(FEGrid::isBoundaryPosition(x) ? -1 : a_mesh.numInteriorNodes++);
+      midpoints[key] = node;
+      nodes[3 + k] = node;
+    }
+  }
+}
+
+/**
+ * @brief Build a structured mesh of the unit cube, six tetrahedra per cell.
+ *
+ * @param a_cells Number of cells per direction.
+ * @param a_mesh The mesh to fill; nodes on the faces of the cube are boundary nodes.
+ * Every cell is split along its main diagonal into the six tetrahedra
+ * following the paths from corner (0,0,0) to (1,1,1) along the axes (Kuhn
+ * subdivision); all cells are split alike, so the mesh is conforming.
+ */
+void buildCube(const int& a_cells, MeshT<ElementT<Tetrahedron, 1> >& a_mesh)
+{
+  int n = a_cells + 1;
+  a_mesh.coordinates.resize(n * n * n * 3);
+  a_mesh.interiorID.resize(n * n * n);
+  a_mesh.numInteriorNodes = 0;
+  for (int k = 0; k < n; k++)
+  {
+    for (int j = 0; j < n; j++)
+    {
+      for (int i = 0; i < n; i++)
+      {
+        int node = (k * n + j) * n + i;
+        a_mesh.coordinates[node * 3] = double(i) / a_cells;
+        a_mesh.coordinates[node * 3 + 1] = double(j) / a_cells;
+        a_mesh.coordinates[node * 3 + 2] = double(k) / a_cells;
+        bool boundary = i == 0 || j == 0 || k == 0 || i == a_cells || j == a_cells || k == a_cells;
+        a_mesh.interiorID[node] = boundary ? -1 : a_mesh.numInteriorNodes++;
+      }
+    }
+  }
+
+  const int permutations[6][3] = {{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}};
+  const int stride[3] = {1, n, n * n};
+  a_mesh.connectivity.clear();
+  a_mesh.connectivity.reserve(a_cells * a_cells * a_cells * 6 * 4);
+  for (int k = 0; k < a_cells; k++)
+  {
+    for (int j = 0; j < a_cells; j++)
+    {
+      for (int i = 0; i < a_cells; i++)
+      {
+        int corner = (k * n + j) * n + i;
+        for (int p = 0; p < 6; p++)
+        {
+          int node = corner;
+          a_mesh.connectivity.push_back(node);
+          for (int a = 0; a < 3; a++)
+          {
+            node += stride[permutations[p][a]];
+            a_mesh.connectivity.push_back(node);
+          }
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,258 @@
+#include <cmath>
+#include <algorithm>
+#include "MixedPCGSolver.h"
+#include "Profiler.h"
+
+/**
+ * @brief Apply a Jacobi or IC(0) preconditioner stored in type P to single precision vectors.
+ *
+ * @param a_n Number of rows.
+ * @param a_lRowPtr Row pointers of the strictly lower factor (empty for Jacobi).
+ * @param a_lColInd Column indices of the strictly lower factor.
+ * @param a_lValues Values of the strictly lower factor.
+ * @param a_invDiag Inverse diagonal.
+ * @param a_r Input vector.
+ * @param a_z Output vector.
+ */
+template <class P>
+static void applyPreconditioner(const int& a_n, const vector<int>& a_lRowPtr, const vector<int>& a_lColInd,
+                                const vector<P>& a_lValues, const vector<P>& a_invDiag, const float* a_r, float* a_z)
+{
+  if (a_lRowPtr.empty())
+  {
+    for (int i = 0; i < a_n; i++)
+    {
+      a_z[i] = a_invDiag[i] * a_r[i];
+    }
+    return;
+  }
+  for (int i = 0; i < a_n; i++)
+  {
+    P sum = a_r[i];
+    for (int k = a_lRowPtr[i]; k < a_lRowPtr[i + 1]; k++)
+    {
+      sum -= a_lValues[k] * a_z[a_lColInd[k]];
+    }
+    a_z[i] = sum * a_invDiag[i];
+  }
+  for (int i = a_n - 1; i >= 0; i--)
+  {
+    a_z[i] *= a_invDiag[i];
+    for (int k = a_lRowPtr[i]; k < a_lRowPtr[i + 1]; k++)
+    {
+      a_z[a_lColInd[k]] -= a_lValues[k] * a_z[i];
+    }
+  }
+}
+
+/**
+ * @brief Constructor converting the matrix and building the preconditioner.
+ *
+ * @param a_matrix The SPD matrix; must outlive the solver and keep its values.
+ * @param a_preconditioner JACOBI or IC0 (see PCGSolver).
+ * @param a_floatPreconditioner Store the preconditioner in float (true) or double (false).
+ * The preconditioner is computed in double by PCGSolver and then converted.
+ */
+MixedPCGSolver::MixedPCGSolver(const SparseMatrix& a_matrix, const PCGSolver::Preconditioner& a_preconditioner,
+                               const bool& a_floatPreconditioner)
+  : m_matrix(a_matrix), m_floatPreconditioner(a_floatPreconditioner), m_residual(0.0), m_innerIterations(0)
+{
+  int n = m_matrix.numRows();
+  m_values.assign(m_matrix.values(), m_matrix.values() + m_matrix.nnz());
+
+  PCGSolver factor(m_matrix, a_preconditioner);
+  m_preconditioner = factor.getPreconditioner();
+  factor.getFactor(m_lRowPtr, m_lColInd, m_lValuesD, m_invDiagD);
+  if (m_floatPreconditioner)
+  {
+    m_lValuesF.assign(m_lValuesD.begin(), m_lValuesD.end());
+    m_invDiagF.assign(m_invDiagD.begin(), m_invDiagD.end());
+    vector<double>().swap(m_lValuesD);
+    vector<double>().swap(m_invDiagD);
+  }
+
+  m_rd.resize(n);
+  m_r.resize(n);
+  m_d.resize(n);
+  m_z.resize(n);
+  m_p.resize(n);
+  m_q.resize(n);
+}
+
+/**
+ * @brief Compute a_y = A * a_x with the float matrix.
+ */
+void MixedPCGSolver::multiply(const float* a_x, float* a_y) const
+{
+  const int* rowPtr = m_matrix.rowPtr();
+  const int* colInd = m_matrix.colInd();
+  for (int i = 0; i < m_matrix.numRows(); i++)
+  {
+    float sum = 0.0f;
+    for (int k = rowPtr[i]; k < rowPtr[i + 1]; k++)
+    {
+      sum += m_values[k] * a_x[colInd[k]];
+    }
+    a_y[i] = sum;
+  }
+}
+
+/**
+ * @brief Apply the preconditioner in single precision.
+ */
+void MixedPCGSolver::precondition(const float* a_r, float* a_z) const
+{
+  if (m_floatPreconditioner)
+    applyPreconditioner(m_matrix.numRows(), m_lRowPtr, m_lColInd, m_lValuesF, m_invDiagF, a_r, a_z);
+  else
+    applyPreconditioner(m_matrix.numRows(), m_lRowPtr, m_lColInd, m_lValuesD, m_invDiagD, a_r, a_z);
+}
+
+/**
+ * @brief Single precision PCG for A d = r, starting from d = 0.
+ *
+ * @return The number of iterations.
+ * Dot products are accumulated in double to keep the recurrences stable.
+ */
+int MixedPCGSolver::innerSolve(const float* a_r, float* a_d, const double& a_tolerance, const int& a_maxIterations)
+{
+  int n = m_matrix.numRows();
+  float* r = m_r.data();
+  float* z = m_z.data();
+  float* p = m_p.data();
+  float* q = m_q.data();
+
+  double r0 = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    a_d[i] = 0.0f;
+    r[i] = a_r[i];
+    r0 += (double)r[i] * r[i];
+  }
+  r0 = sqrt(r0);
+
+  precondition(r, z);
+  double rz = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    p[i] = z[i];
+    rz += (double)r[i] * z[i];
+  }
+
+  int iter = 0;
+  while (iter < a_maxIterations)
+  {
+    iter++;
+    multiply(p, q);
+    double pq = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+      pq += (double)p[i] * q[i];
+    }
+    float alpha = rz / pq;
+    double rnorm = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+      a_d[i] += alpha * p[i];
+      r[i] -= alpha * q[i];
+      rnorm += (double)r[i] * r[i];
+    }
+    if (sqrt(rnorm) <= a_tolerance * r0)
+      break;
+
+    precondition(r, z);
+    double rzNew = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+      rzNew += (double)r[i] * z[i];
+    }
+    float beta = rzNew / rz;
+    rz = rzNew;
+    for (int i = 0; i < n; i++)
+    {
+      p[i] = z[i] + beta * p[i];
+    }
+  }
+  return iter;
+}
+
+/**
+ * @brief Solve A x = b to double precision accuracy by iterative refinement.
+ *
+ * @param a_b Right hand side.
+ * @param a_x On input the initial guess, on output the solution.
+ * @param a_tolerance Relative residual ||b - A x|| / ||b|| to reach, computed in double.
+ * @param a_innerTolerance Relative residual reduction of each single precision solve.
+ * @param a_maxOuter Maximum number of refinement steps.
+ * @return The number of refinement steps performed.
+ */
+int MixedPCGSolver::solve(const double* a_b, double* a_x, const double& a_tolerance,
+                          const double& a_innerTolerance, const int& a_maxOuter)
+{
+  PROFILE_SCOPE("mixed_solve");
+  int n = m_matrix.numRows();
+  m_innerIterations = 0;
+
+  double bnorm = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    bnorm += a_b[i] * a_b[i];
+  }
+  bnorm = sqrt(bnorm);
+  if (bnorm == 0.0)
+  {
+    fill(a_x, a_x + n, 0.0);
+    m_residual = 0.0;
+    return 0;
+  }
+
+  int outer = 0;
+  while (true)
+  {
+    m_matrix.multiply(a_x, m_rd.data());
+    double rnorm = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+      m_rd[i] = a_b[i] - m_rd[i];
+      rnorm += m_rd[i] * m_rd[i];
+    }
+    m_residual = sqrt(rnorm) / bnorm;
+    if (m_residual <= a_tolerance || outer == a_maxOuter)
+      break;
+
+    // Scale the residual to unit norm so that it is well inside the float range
+    double scale = sqrt(rnorm);
+    for (int i = 0; i < n; i++)
+    {
+      m_r[i] = m_rd[i] / scale;
+    }
+    m_innerIterations += innerSolve(m_r.data(), m_d.data(), a_innerTolerance, 10 * n + 100);
+    for (int i = 0; i < n; i++)
+    {
+      a_x[i] += scale * m_d[i];
+    }
+    outer++;
+  }
+  PROFILE_COUNT("float_pcg_iterations", m_innerIterations);
+  return outer;
+}
+
+/**
+ * @brief Get the relative residual (in double) reached by the last solve().
+ *
+ * @return The relative residual.
+ */
+double MixedPCGSolver::getResidual() const
+{
+  return m_residual;
+}
+
+/**
+ * @brief Get the total number of single precision iterations of the last solve().
+ *
+ * @return The number of inner iterations.
+ */
+int MixedPCGSolver::getInnerIterations() const
+{
+  return m_innerIterations;
+}
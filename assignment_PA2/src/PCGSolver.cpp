@@ -0,0 +1,307 @@
+#include <cmath>
+#include <algorithm>
+#include "PCGSolver.h"
+#include "Profiler.h"
+
+/**
+ * @brief Constructor building the preconditioner.
+ *
+ * @param a_matrix The SPD matrix; must outlive the solver and keep its values.
+ * @param a_preconditioner The preconditioner to build. IC(0) falls back to Jacobi on breakdown.
+ */
+PCGSolver::PCGSolver(const SparseMatrix& a_matrix, const Preconditioner& a_preconditioner)
+  : m_matrix(a_matrix), m_preconditioner(a_preconditioner), m_residual(0.0)
+{
+  PROFILE_SCOPE("preconditioner_setup");
+  int n = m_matrix.numRows();
+  m_r.resize(n);
+  m_z.resize(n);
+  m_p.resize(n);
+  m_q.resize(n);
+  m_invDiag.resize(n);
+
+  if (m_preconditioner == IC0 && factorIC0())
+  {
+    bind();
+    return;
+  }
+
+  m_preconditioner = JACOBI;
+  m_matrix.diagonal(m_invDiag.data());
+  for (int i = 0; i < n; i++)
+  {
+    m_invDiag[i] = (m_invDiag[i] != 0.0) ? 1.0 / m_invDiag[i] : 1.0;
+  }
+  bind();
+}
+
+/**
+ * @brief Constructor using a precomputed preconditioner without copying it.
+ *
+ * @param a_matrix The SPD matrix; must outlive the solver and keep its values.
+ * @param a_preconditioner The kind of a_invDiag and the factor arrays (see getFactor()).
+ * @param a_lRowPtr Row pointers of the strictly lower part of L (NULL for JACOBI).
+ * @param a_lColInd Column indices of the strictly lower part of L (NULL for JACOBI).
+ * @param a_lValues Values of the strictly lower part of L (NULL for JACOBI).
+ * @param a_invDiag Inverse diagonal.
+ */
+PCGSolver::PCGSolver(const SparseMatrix& a_matrix, const Preconditioner& a_preconditioner, const int* a_lRowPtr,
+                     const int* a_lColInd, const double* a_lValues, const double* a_invDiag)
+  : m_matrix(a_matrix), m_preconditioner(a_preconditioner), m_invDiagData(a_invDiag), m_lRowPtrData(a_lRowPtr),
+    m_lColIndData(a_lColInd), m_lValuesData(a_lValues), m_residual(0.0)
+{
+  int n = m_matrix.numRows();
+  m_r.resize(n);
+  m_z.resize(n);
+  m_p.resize(n);
+  m_q.resize(n);
+}
+
+/**
+ * @brief Point the preconditioner pointers at the owned vectors.
+ */
+void PCGSolver::bind()
+{
+  m_invDiagData = m_invDiag.data();
+  m_lRowPtrData = m_lRowPtr.data();
+  m_lColIndData = m_lColInd.data();
+  m_lValuesData = m_lValues.data();
+}
+
+/**
+ * @brief Compute the IC(0) factor of the matrix.
+ *
+ * @return False if a non-positive pivot was met.
+ * L keeps the pattern of the lower triangle of A. Row i of L is computed from
+ * L_ij = (A_ij - sum_k L_ik L_jk) / L_jj, the sum running over the common columns k < j.
+ */
+bool PCGSolver::factorIC0()
+{
+  int n = m_matrix.numRows();
+  const int* rowPtr = m_matrix.rowPtr();
+  const int* colInd = m_matrix.colInd();
+  const double* values = m_matrix.values();
+
+  m_lRowPtr.assign(n + 1, 0);
+  m_lColInd.clear();
+  m_lValues.clear();
+  vector<double> diag(n);
+
+  for (int i = 0; i < n; i++)
+  {
+    double aii = 0.0;
+    for (int k = rowPtr[i]; k < rowPtr[i + 1]; k++)
+    {
+      int j = colInd[k];
+      if (j > i)
+        break;
+      if (j == i)
+      {
+        aii = values[k];
+        break;
+      }
+      // Sparse dot product of the already computed parts of rows i and j
+      double sum = values[k];
+      int p = m_lRowPtr[i];
+      int q = m_lRowPtr[j];
+      int pEnd = m_lColInd.size();
+      int qEnd = m_lRowPtr[j + 1];
+      while (p < pEnd && q < qEnd)
+      {
+        if (m_lColInd[p] < m_lColInd[q])
+          p++;
+        else if (m_lColInd[p] > m_lColInd[q])
+          q++;
+        else
+          sum -= m_lValues[p++] * m_lValues[q++];
+      }
+      m_lColInd.push_back(j);
+      m_lValues.push_back(sum / diag[j]);
+    }
+    for (int k = m_lRowPtr[i]; k < (int)m_lValues.size(); k++)
+    {
+      aii -= m_lValues[k] * m_lValues[k];
+    }
+    if (aii <= 0.0)
+    {
+      return false;
+    }
+    diag[i] = sqrt(aii);
+    m_invDiag[i] = 1.0 / diag[i];
+    m_lRowPtr[i + 1] = m_lColInd.size();
+  }
+  return true;
+}
+
+/**
+ * @brief Apply the preconditioner, a_z = M^-1 a_r.
+ *
+ * @param a_r Input vector.
+ * @param a_z Output vector. For IC0, a forward solve with L followed by a backward solve with L^T.
+ */
+void PCGSolver::precondition(const double* a_r, double* a_z) const
+{
+  int n = m_matrix.numRows();
+  if (m_preconditioner == JACOBI)
+  {
+    for (int i = 0; i < n; i++)
+    {
+      a_z[i] = m_invDiagData[i] * a_r[i];
+    }
+    return;
+  }
+
+  for (int i = 0; i < n; i++)
+  {
+    double sum = a_r[i];
+    for (int k = m_lRowPtrData[i]; k < m_lRowPtrData[i + 1]; k++)
+    {
+      sum -= m_lValuesData[k] * a_z[m_lColIndData[k]];
+    }
+    a_z[i] = sum * m_invDiagData[i];
+  }
+  for (int i = n - 1; i >= 0; i--)
+  {
+    a_z[i] *= m_invDiagData[i];
+    for (int k = m_lRowPtrData[i]; k < m_lRowPtrData[i + 1]; k++)
+    {
+      a_z[m_lColIndData[k]] -= m_lValuesData[k] * a_z[i];
+    }
+  }
+}
+
+/**
+ * @brief Solve A x = b with preconditioned conjugate gradients.
+ *
+ * @param a_b Right hand side.
+ * @param a_x On input the initial guess, on output the solution.
+ * @param a_tolerance Relative residual ||b - A x|| / ||b|| to reach.
+ * @param a_maxIterations Maximum number of iterations.
+ * @return The number of iterations performed.
+ */
+int PCGSolver::solve(const double* a_b, double* a_x, const double& a_tolerance, const int& a_maxIterations)
+{
+  int n = m_matrix.numRows();
+  double* r = m_r.data();
+  double* z = m_z.data();
+  double* p = m_p.data();
+  double* q = m_q.data();
+
+  double bnorm = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    bnorm += a_b[i] * a_b[i];
+  }
+  bnorm = sqrt(bnorm);
+  if (bnorm == 0.0)
+  {
+    fill(a_x, a_x + n, 0.0);
+    m_residual = 0.0;
+    return 0;
+  }
+
+  m_matrix.multiply(a_x, r);
+  double rnorm = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    r[i] = a_b[i] - r[i];
+    rnorm += r[i] * r[i];
+  }
+  m_residual = sqrt(rnorm) / bnorm;
+  if (m_residual <= a_tolerance)
+  {
+    return 0;
+  }
+
+  precondition(r, z);
+  double rz = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    p[i] = z[i];
+    rz += r[i] * z[i];
+  }
+
+  int iter = 0;
+  while (iter < a_maxIterations)
+  {
+    iter++;
+    m_matrix.multiply(p, q);
+    double pq = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+      pq += p[i] * q[i];
+    }
+    double alpha = rz / pq;
+    rnorm = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+      a_x[i] += alpha * p[i];
+      r[i] -= alpha * q[i];
+      rnorm += r[i] * r[i];
+    }
+    m_residual = sqrt(rnorm) / bnorm;
+    if (m_residual <= a_tolerance)
+      break;
+
+    precondition(r, z);
+    double rzNew = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+      rzNew += r[i] * z[i];
+    }
+    double beta = rzNew / rz;
+    rz = rzNew;
+    for (int i = 0; i < n; i++)
+    {
+      p[i] = z[i] + beta * p[i];
+    }
+  }
+  PROFILE_COUNT("pcg_iterations", iter);
+  return iter;
+}
+
+/**
+ * @brief Copy the preconditioner data.
+ *
+ * @param a_rowPtr Row pointers of the strictly lower part of L.
+ * @param a_colInd Column indices of the strictly lower part of L.
+ * @param a_values Values of the strictly lower part of L.
+ * @param a_invDiag Inverse diagonal.
+ */
+void PCGSolver::getFactor(vector<int>& a_rowPtr, vector<int>& a_colInd, vector<double>& a_values, vector<double>& a_invDiag) const
+{
+  int n = m_matrix.numRows();
+  a_invDiag.assign(m_invDiagData, m_invDiagData + n);
+  if (m_preconditioner == IC0)
+  {
+    a_rowPtr.assign(m_lRowPtrData, m_lRowPtrData + n + 1);
+    a_colInd.assign(m_lColIndData, m_lColIndData + m_lRowPtrData[n]);
+    a_values.assign(m_lValuesData, m_lValuesData + m_lRowPtrData[n]);
+  }
+  else
+  {
+    a_rowPtr.clear();
+    a_colInd.clear();
+    a_values.clear();
+  }
+}
+
+/**
+ * @brief Get the relative residual reached by the last solve().
+ *
+ * @return The relative residual.
+ */
+double PCGSolver::getResidual() const
+{
+  return m_residual;
+}
+
+/**
+ * @brief Get the preconditioner actually in use.
+ *
+ * @return JACOBI or IC0.
+ */
+PCGSolver::Preconditioner PCGSolver::getPreconditioner() const
+{
+  return m_preconditioner;
+}
@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <cmath>
+#include "PartitionedMatrix.h"
+#include "FEAssembler.h"
+#include "Profiler.h"
+
+/**
+ * @brief Constructor building the per-partition patterns, scatter maps and exchange lists.
+ *
+ * @param a_partition The partition; must outlive the matrix.
+ * @param a_conductivity Conductivity tensor (row major DIM x DIM) of every element.
+ * The node-to-element adjacency is built once and shared; everything owned by a
+ * partition is allocated inside the parallel loop by the thread of the partition.
+ */
+PartitionedMatrix::PartitionedMatrix(const MeshPartition& a_partition, const double a_conductivity[DIM * DIM])
+  : m_partition(a_partition), m_grid(a_partition.grid())
+{
+  PROFILE_SCOPE("partition_symbolic");
+  for (int k = 0; k < DIM * DIM; k++)
+  {
+    m_conductivity[k] = a_conductivity[k];
+  }
+  vector<int> nodeOffsets, nodeElements;
+  m_partition.nodeElements(nodeOffsets, nodeElements);
+  int numParts = m_partition.numParts();
+  m_parts.resize(numParts);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1)
+#endif
+  for (int p = 0; p < numParts; p++)
+  {
+    buildPart(p, nodeOffsets, nodeElements);
+  }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1)
+#endif
+  for (int p = 0; p < numParts; p++)
+  {
+    buildReceives(p);
+  }
+}
+
+/**
+ * @brief Build the rows, scatter map and send list of a partition.
+ *
+ * @param a_part The partition.
+ * @param a_nodeOffsets Node-to-element adjacency offsets (by interior node ID).
+ * @param a_nodeElements Node-to-element adjacency.
+ * A row's pattern comes from all elements around its node, including those of
+ * other partitions, so every received contribution has a slot.
+ */
+void PartitionedMatrix::buildPart(const int& a_part, const vector<int>& a_nodeOffsets,
+                                  const vector<int>& a_nodeElements)
+{
+  m_parts[a_part].reset(new Part());
+  Part& part = *m_parts[a_part];
+  const vector<int>& rowOf = m_partition.rowOf();
+  const vector<int>& interiorNodeOf = m_partition.interiorNodeOf();
+  part.rowBegin = m_partition.rowBegin(a_part);
+  part.numRows = m_partition.rowBegin(a_part + 1) - part.rowBegin;
+
+  part.rowPtr.assign(part.numRows + 1, 0);
+  vector<int> columns;
+  for (int i = 0; i < part.numRows; i++)
+  {
+    int id = interiorNodeOf[part.rowBegin + i];
+    columns.clear();
+    for (int k = a_nodeOffsets[id]; k < a_nodeOffsets[id + 1]; k++)
+    {
+      for (int n = 0; n < VERTICES; n++)
+      {
+        int col = m_grid.getNode(a_nodeElements[k], n).getInteriorNodeID();
+        if (col >= 0)
+          columns.push_back(rowOf[col]);
+      }
+    }
+    sort(columns.begin(), columns.end());
+    columns.erase(unique(columns.begin(), columns.end()), columns.end());
+    part.colInd.insert(part.colInd.end(), columns.begin(), columns.end());
+    part.rowPtr[i + 1] = part.colInd.size();
+  }
+  part.values.assign(part.colInd.size(), 0.0);
+
+  // Entries of rows owned elsewhere become send entries, sorted by (row, column)
+  part.elements = m_partition.elements(a_part);
+  part.coordinates.resize(part.elements.size() * VERTICES * DIM);
+  for (size_t e = 0; e < part.elements.size(); e++)
+  {
+    for (int m = 0; m < VERTICES; m++)
+    {
+      m_grid.getNode(part.elements[e], m).getPosition(&part.coordinates[(e * VERTICES + m) * DIM]);
+    }
+  }
+  int numEntries = part.elements.size() * VERTICES * VERTICES;
+  part.slots.assign(numEntries, -1);
+  vector<pair<int, int> > foreign;
+  for (size_t e = 0; e < part.elements.size(); e++)
+  {
+    for (int m = 0; m < VERTICES; m++)
+    {
+      int rowID = m_grid.getNode(part.elements[e], m).getInteriorNodeID();
+      int row = (rowID < 0) ? -1 : rowOf[rowID];
+      if (row < 0 || (row >= part.rowBegin && row < part.rowBegin + part.numRows))
+        continue;
+      for (int n = 0; n < VERTICES; n++)
+      {
+        int colID = m_grid.getNode(part.elements[e], n).getInteriorNodeID();
+        if (colID >= 0)
+          foreign.push_back(make_pair(row, rowOf[colID]));
+      }
+    }
+  }
+  sort(foreign.begin(), foreign.end());
+  foreign.erase(unique(foreign.begin(), foreign.end()), foreign.end());
+  for (size_t k = 0; k < foreign.size(); k++)
+  {
+    part.sendRows.push_back(foreign[k].first);
+    part.sendCols.push_back(foreign[k].second);
+  }
+  part.send.assign(foreign.size(), 0.0);
+
+  for (size_t e = 0; e < part.elements.size(); e++)
+  {
+    for (int m = 0; m < VERTICES; m++)
+    {
+      int rowID = m_grid.getNode(part.elements[e], m).getInteriorNodeID();
+      if (rowID < 0)
+        continue;
+      int row = rowOf[rowID];
+      bool own = (row >= part.rowBegin && row < part.rowBegin + part.numRows);
+      for (int n = 0; n < VERTICES; n++)
+      {
+        int colID = m_grid.getNode(part.elements[e], n).getInteriorNodeID();
+        if (colID < 0)
+          continue;
+        int col = rowOf[colID];
+        int& slot = part.slots[(e * VERTICES + m) * VERTICES + n];
+        if (own)
+        {
+          const int* first = part.colInd.data() + part.rowPtr[row - part.rowBegin];
+          const int* last = part.colInd.data() + part.rowPtr[row - part.rowBegin + 1];
+          slot = lower_bound(first, last, col) - part.colInd.data();
+        }
+        else
+        {
+          slot = -2 - (lower_bound(foreign.begin(), foreign.end(), make_pair(row, col)) - foreign.begin());
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Build the receive list of a partition from its neighbours' send lists.
+ *
+ * @param a_part The partition.
+ */
+void PartitionedMatrix::buildReceives(const int& a_part)
+{
+  Part& part = *m_parts[a_part];
+  int rowEnd = part.rowBegin + part.numRows;
+  for (int p = 0; p < m_partition.numParts(); p++)
+  {
+    const vector<int>& neighbors = m_partition.neighbors(p);
+    if (p == a_part || !binary_search(neighbors.begin(), neighbors.end(), a_part))
+      continue;
+    const Part& sender = *m_parts[p];
+    int k = lower_bound(sender.sendRows.begin(), sender.sendRows.end(), part.rowBegin) - sender.sendRows.begin();
+    for (; k < (int)sender.sendRows.size() && sender.sendRows[k] < rowEnd; k++)
+    {
+      int i = sender.sendRows[k] - part.rowBegin;
+      const int* first = part.colInd.data() + part.rowPtr[i];
+      const int* last = part.colInd.data() + part.rowPtr[i + 1];
+      part.recvPart.push_back(p);
+      part.recvIndex.push_back(k);
+      part.recvSlot.push_back(lower_bound(first, last, sender.sendCols[k]) - part.colInd.data());
+    }
+  }
+}
+
+/**
+ * @brief Integrate all elements partition-locally and exchange the interface contributions.
+ *
+ * The two loops are the two phases: every send buffer is complete at the end of
+ * the first, before any owner reads it in the second.
+ */
+void PartitionedMatrix::assemble()
+{
+  PROFILE_SCOPE("partition_assembly");
+  int numParts = m_parts.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1)
+#endif
+  for (int p = 0; p < numParts; p++)
+  {
+    Part& part = *m_parts[p];
+    fill(part.values.begin(), part.values.end(), 0.0);
+    fill(part.send.begin(), part.send.end(), 0.0);
+    for (size_t e = 0; e < part.elements.size(); e++)
+    {
+      double x[VERTICES][DIM], kij[VERTICES * VERTICES];
+      const double* coordinates = &part.coordinates[e * VERTICES * DIM];
+      copy(coordinates, coordinates + VERTICES * DIM, &x[0][0]);
+      FEAssembler::elementStiffness(x, m_conductivity, kij);
+      const int* slots = &part.slots[e * VERTICES * VERTICES];
+      for (int k = 0; k < VERTICES * VERTICES; k++)
+      {
+        if (slots[k] >= 0)
+          part.values[slots[k]] += kij[k];
+        else if (slots[k] <= -2)
+          part.send[-2 - slots[k]] += kij[k];
+      }
+    }
+  }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1)
+#endif
+  for (int p = 0; p < numParts; p++)
+  {
+    Part& part = *m_parts[p];
+    for (size_t k = 0; k < part.recvSlot.size(); k++)
+    {
+      part.values[part.recvSlot[k]] += m_parts[part.recvPart[k]]->send[part.recvIndex[k]];
+    }
+  }
+  PROFILE_COUNT("elements_integrated", m_grid.getNumElts());
+}
+
+/**
+ * @brief Compute a_y = A * a_x, each partition computing its own rows.
+ *
+ * @param a_x Input vector in partition numbering.
+ * @param a_y Output vector in partition numbering.
+ */
+void PartitionedMatrix::multiply(const double* a_x, double* a_y) const
+{
+  int numParts = m_parts.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1)
+#endif
+  for (int p = 0; p < numParts; p++)
+  {
+    const Part& part = *m_parts[p];
+    const int* rowPtr = part.rowPtr.data();
+    const int* colInd = part.colInd.data();
+    const double* values = part.values.data();
+    double* y = a_y + part.rowBegin;
+    for (int i = 0; i < part.numRows; i++)
+    {
+      double sum = 0.0;
+      for (int k = rowPtr[i]; k < rowPtr[i + 1]; k++)
+      {
+        sum += values[k] * a_x[colInd[k]];
+      }
+      y[i] = sum;
+    }
+  }
+}
+
+/**
+ * @brief Zero a vector, each partition touching its own rows first.
+ *
+ * @param a_v Vector of numRows() values, freshly allocated and not yet written.
+ */
+void PartitionedMatrix::firstTouch(double* a_v) const
+{
+  int numParts = m_parts.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1)
+#endif
+  for (int p = 0; p < numParts; p++)
+  {
+    fill(a_v + m_parts[p]->rowBegin, a_v + m_parts[p]->rowBegin + m_parts[p]->numRows, 0.0);
+  }
+}
+
+/**
+ * @brief Get the number of rows.
+ *
+ * @return The number of interior nodes.
+ */
+int PartitionedMatrix::numRows() const
+{
+  return m_partition.rowBegin(m_partition.numParts());
+}
+
+/**
+ * @brief Get the number of stored entries over all partitions.
+ *
+ * @return The number of non-zeros.
+ */
+int PartitionedMatrix::nnz() const
+{
+  int count = 0;
+  for (size_t p = 0; p < m_parts.size(); p++)
+  {
+    count += m_parts[p]->colInd.size();
+  }
+  return count;
+}
+
+/**
+ * @brief Get the number of entries exchanged by an assembly.
+ *
+ * @return The number of send buffer entries over all partitions.
+ */
+int PartitionedMatrix::getNumExchanged() const
+{
+  int count = 0;
+  for (size_t p = 0; p < m_parts.size(); p++)
+  {
+    count += m_parts[p]->send.size();
+  }
+  return count;
+}
+
+/**
+ * @brief Largest difference to a matrix in interior node numbering.
+ *
+ * @param a_matrix The reference (e.g. FEAssembler::matrix()).
+ * @return The largest absolute difference of an entry, or -1 if the patterns differ.
+ */
+double PartitionedMatrix::maxDifference(const SparseMatrix& a_matrix) const
+{
+  if (a_matrix.numRows() != numRows() || a_matrix.nnz() != nnz())
+    return -1.0;
+  const vector<int>& interiorNodeOf = m_partition.interiorNodeOf();
+  double difference = 0.0;
+  for (size_t p = 0; p < m_parts.size(); p++)
+  {
+    const Part& part = *m_parts[p];
+    for (int i = 0; i < part.numRows; i++)
+    {
+      int row = interiorNodeOf[part.rowBegin + i];
+      for (int k = part.rowPtr[i]; k < part.rowPtr[i + 1]; k++)
+      {
+        int slot = a_matrix.find(row, interiorNodeOf[part.colInd[k]]);
+        if (slot < 0)
+          return -1.0;
+        difference = max(difference, fabs(part.values[k] - a_matrix.values()[slot]));
+      }
+    }
+  }
+  return difference;
+}
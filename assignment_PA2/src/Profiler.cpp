@@ -0,0 +1,234 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
+#include "Profiler.h"
+
+/** Maximum number of scopes kept for the trace (24 bytes each). */
+static const size_t s_maxEvents = 1 << 20;
+
+/** Nesting depth of the scopes of the calling thread. */
+static thread_local int s_depth = 0;
+
+/** Trace lane of the calling thread, 0 until it records a scope. */
+static thread_local int s_thread = 0;
+
+/**
+ * @brief Exit handler printing the requested reports.
+ */
+static void reportAtExit()
+{
+  Profiler::instance().report();
+}
+
+/**
+ * @brief Get the process-wide profiler.
+ *
+ * @return The profiler; created (and its exit report registered) on first use.
+ */
+Profiler& Profiler::instance()
+{
+  static Profiler* profiler = new Profiler();
+  return *profiler;
+}
+
+/**
+ * @brief Constructor reading FEM_PROFILE and FEM_TRACE.
+ *
+ * The profiler is never destroyed, so scopes closing during static destruction stay valid.
+ */
+Profiler::Profiler()
+  : m_origin(chrono::steady_clock::now()), m_reported(false), m_numThreads(0), m_droppedEvents(0)
+{
+  const char* summary = getenv("FEM_PROFILE");
+  const char* trace = getenv("FEM_TRACE");
+  m_summary = (summary != NULL && summary[0] != '\0' && strcmp(summary, "0") != 0);
+  if (trace != NULL)
+    m_traceFile = trace;
+  m_enabled = m_summary || !m_traceFile.empty();
+  if (m_enabled)
+    atexit(reportAtExit);
+}
+
+/**
+ * @brief Register a timed phase.
+ *
+ * @param a_name Phase name; must be a string literal or otherwise outlive the profiler.
+ * @return The phase index (the same index for the same name).
+ */
+int Profiler::section(const char* a_name)
+{
+  lock_guard<mutex> guard(m_lock);
+  for (size_t s = 0; s < m_sections.size(); s++)
+  {
+    if (strcmp(m_sections[s].name, a_name) == 0)
+      return s;
+  }
+  Section s = {a_name, -1, 0, 0.0, 0.0, 0, 0};
+  m_sections.push_back(s);
+  return m_sections.size() - 1;
+}
+
+/**
+ * @brief Register an event counter.
+ *
+ * @param a_name Counter name; must be a string literal or otherwise outlive the profiler.
+ * @return The counter index (the same index for the same name).
+ */
+int Profiler::counter(const char* a_name)
+{
+  lock_guard<mutex> guard(m_lock);
+  for (size_t c = 0; c < m_counters.size(); c++)
+  {
+    if (strcmp(m_counters[c].name, a_name) == 0)
+      return c;
+  }
+  Counter c = {a_name, 0};
+  m_counters.push_back(c);
+  return m_counters.size() - 1;
+}
+
+/**
+ * @brief Mark the start of a phase (called by ScopedTimer).
+ *
+ * @param a_section Phase index.
+ * @return The peak RSS in kB at entry for an outermost phase of its thread, -1 for a nested one.
+ * Takes no lock; getrusage is only called for outermost phases.
+ */
+long Profiler::enter(const int& a_section)
+{
+  return (s_depth++ == 0) ? peakRSS() : -1;
+}
+
+/**
+ * @brief Record a finished phase (called by ScopedTimer).
+ *
+ * @param a_section Phase index.
+ * @param a_start Start time stamp (now()).
+ * @param a_peakAtEntry Peak RSS in kB returned by enter(), -1 if not measured.
+ */
+void Profiler::leave(const int& a_section, const double& a_start, const long& a_peakAtEntry)
+{
+  double duration = now() - a_start;
+  long peak = (a_peakAtEntry >= 0) ? peakRSS() : -1;
+  s_depth--;
+  lock_guard<mutex> guard(m_lock);
+  if (s_thread == 0)
+    s_thread = ++m_numThreads;
+  Section& s = m_sections[a_section];
+  if (s.depth < 0)
+    s.depth = s_depth;
+  s.calls++;
+  s.total += duration;
+  if (duration > s.longest)
+    s.longest = duration;
+  if (peak > s.peakRSS)
+    s.peakRSS = peak;
+  if (peak >= 0 && peak - a_peakAtEntry > s.growth)
+    s.growth = peak - a_peakAtEntry;
+
+  if (!m_traceFile.empty())
+  {
+    if (m_events.size() < s_maxEvents)
+    {
+      Event e = {a_section, s_thread, a_start, duration};
+      m_events.push_back(e);
+    }
+    else
+    {
+      m_droppedEvents++;
+    }
+  }
+}
+
+/**
+ * @brief Peak resident set size of the process so far.
+ *
+ * @return The peak RSS in kB.
+ */
+long Profiler::peakRSS()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+/**
+ * @brief Print the summary table and/or write the trace, as requested.
+ *
+ * Runs automatically at exit; calling it again does nothing.
+ */
+void Profiler::report()
+{
+  lock_guard<mutex> guard(m_lock);
+  if (m_reported || !m_enabled)
+    return;
+  m_reported = true;
+  if (m_summary)
+    printSummary();
+  if (!m_traceFile.empty() && !writeTrace())
+    fprintf(stderr, "Error: Could not write trace file %s\n", m_traceFile.c_str());
+}
+
+/**
+ * @brief Print the summary table to stderr.
+ *
+ * Phases are listed in order of first use and indented by nesting depth; the
+ * share is relative to the time since the profiler was created. Memory columns
+ * are left blank for phases that only ran nested in another one.
+ */
+void Profiler::printSummary() const
+{
+  double elapsed = now();
+  fprintf(stderr, "\n%-32s %8s %12s %12s %12s %7s %10s %10s\n", "phase", "calls", "total ms", "mean ms",
+          "max ms", "share", "peak MB", "+MB");
+  for (size_t i = 0; i < m_sections.size(); i++)
+  {
+    const Section& s = m_sections[i];
+    if (s.calls == 0)
+      continue;
+    std::string name = std::string(2 * s.depth, ' ') + s.name;
+    fprintf(stderr, "%-32s %8ld %12.3f %12.4f %12.3f %6.1f%%", name.c_str(), s.calls, s.total / 1e3,
+            s.total / 1e3 / s.calls, s.longest / 1e3, 100.0 * s.total / elapsed);
+    if (s.peakRSS > 0)
+      fprintf(stderr, " %10.1f %10.1f\n", s.peakRSS / 1024.0, s.growth / 1024.0);
+    else
+      fprintf(stderr, "\n");
+  }
+  fprintf(stderr, "%-32s %8s %12.3f %12s %12s %7s %10.1f\n", "(wall time)", "", elapsed / 1e3, "", "", "",
+          peakRSS() / 1024.0);
+  for (size_t c = 0; c < m_counters.size(); c++)
+  {
+    fprintf(stderr, "%-32s %20ld\n", m_counters[c].name, m_counters[c].value);
+  }
+  if (m_droppedEvents > 0)
+    fprintf(stderr, "(%ld scopes not written to the trace)\n", m_droppedEvents);
+}
+
+/**
+ * @brief Write the Chrome trace.
+ *
+ * @return False if the file could not be written.
+ * Every scope becomes a complete ("X") event; the counters are written as one
+ * counter ("C") event at the end of the run.
+ */
+bool Profiler::writeTrace() const
+{
+  FILE* fp = fopen(m_traceFile.c_str(), "w");
+  if (!fp)
+    return false;
+  fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  for (size_t i = 0; i < m_events.size(); i++)
+  {
+    const Event& e = m_events[i];
+    fprintf(fp, "{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f},\n",
+            m_sections[e.section].name, e.thread, e.start, e.duration);
+  }
+  fprintf(fp, "{\"name\": \"counters\", \"ph\": \"C\", \"pid\": 1, \"tid\": 1, \"ts\": %.3f, \"args\": {", now());
+  for (size_t c = 0; c < m_counters.size(); c++)
+  {
+    fprintf(fp, "%s\"%s\": %ld", (c > 0) ? ", " : "", m_counters[c].name, m_counters[c].value);
+  }
+  fprintf(fp, "}}\n]}\n");
+  return fclose(fp) == 0;
+}
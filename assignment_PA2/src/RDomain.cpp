@@ -1,6 +1,7 @@
 // RDomain.cpp (Implementation File)
 
 #include "RDomain.h"
+#include "Profiler.h"
 #include <fstream>
 #include <iostream>
 #include <cstdio>  // for fopen, fwrite, fclose
@@ -26,6 +27,7 @@ void RDomain::generateGrid() {
 
 // Print the grid to a binary file
 void RDomain::PrintGrid(const std::string& outputFileName) const {
+    PROFILE_SCOPE("output");
     // Open the file for writing in binary mode
     FILE* fp = fopen(outputFileName.c_str(), "wb");
     if (!fp) {
@@ -43,5 +45,6 @@ void RDomain::PrintGrid(const std::string& outputFileName) const {
 
     // Close the file
     fclose(fp);
+    PROFILE_COUNT("bytes_written", (xSize + ySize) * sizeof(double));
 }
 
@@ -1,4 +1,5 @@
 #include "Solution.h"
+#include "Profiler.h"
 #include <iostream>
 
 Solution::Solution(GridFn* gridFn) : gridFunction(gridFn) {}
@@ -10,14 +11,19 @@ void Solution::applyBoundaryConditions() {
 }
 
 void Solution::iterate() {
+    // The per-step grid printing is part of this scope; printGrid() has no scope of its own
+    PROFILE_SCOPE("time_stepping");
     for (int step = 0; step < numSteps; ++step) {
         printf("Time Step %d:\n", step);
         gridFunction->solve();  // Solve for the next time step
         gridFunction->printGrid();  // Print grid at this step
     }
+    PROFILE_COUNT("time_steps", numSteps);
+    PROFILE_COUNT("points_updated", (long)numSteps * (gridFunction->size() > 2 ? gridFunction->size() - 2 : 0));
 }
 
 void Solution::printResults() {
+    PROFILE_SCOPE("output");
     printf("Final Temperature Distribution:\n");
     gridFunction->printGrid();  // Print final grid values after iteration
 }
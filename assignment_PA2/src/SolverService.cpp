@@ -0,0 +1,436 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "SolverService.h"
+#include "ContentHash.h"
+#include "Profiler.h"
+
+/** Number of request latencies kept for the percentiles. */
+static const size_t s_maxLatencies = 100000;
+
+/**
+ * @brief Read exactly a_bytes from a socket.
+ *
+ * @return False on end of file or error.
+ */
+static bool readFully(const int& a_fd, void* a_buffer, size_t a_bytes)
+{
+  char* p = static_cast<char*>(a_buffer);
+  while (a_bytes > 0)
+  {
+    ssize_t n = read(a_fd, p, a_bytes);
+    if (n <= 0)
+      return false;
+    p += n;
+    a_bytes -= n;
+  }
+  return true;
+}
+
+/**
+ * @brief Write exactly a_bytes to a socket.
+ *
+ * @return False on error.
+ */
+static bool writeFully(const int& a_fd, const void* a_buffer, size_t a_bytes)
+{
+  const char* p = static_cast<const char*>(a_buffer);
+  while (a_bytes > 0)
+  {
+    ssize_t n = write(a_fd, p, a_bytes);
+    if (n <= 0)
+      return false;
+    p += n;
+    a_bytes -= n;
+  }
+  return true;
+}
+
+/**
+ * @brief Fill a Unix domain socket address.
+ *
+ * @return False if the path is too long.
+ */
+static bool socketAddress(const std::string& a_path, struct sockaddr_un& a_address)
+{
+  memset(&a_address, 0, sizeof(a_address));
+  a_address.sun_family = AF_UNIX;
+  if (a_path.size() >= sizeof(a_address.sun_path))
+    return false;
+  strcpy(a_address.sun_path, a_path.c_str());
+  return true;
+}
+
+/**
+ * @brief Constructor.
+ *
+ * @param a_socketPath Path of the Unix domain socket to create.
+ * @param a_memoryBudget Bytes available to cached meshes and systems.
+ */
+SolverService::SolverService(const std::string& a_socketPath, const size_t& a_memoryBudget)
+  : m_socketPath(a_socketPath), m_listenFd(-1), m_memoryBudget(a_memoryBudget), m_cachedBytes(0),
+    m_meshHits(0), m_meshMisses(0), m_systemHits(0), m_systemMisses(0), m_evictions(0), m_numSolves(0),
+    m_numErrors(0)
+{
+}
+
+/**
+ * @brief Destructor closing and removing the socket.
+ */
+SolverService::~SolverService()
+{
+  if (m_listenFd >= 0)
+  {
+    close(m_listenFd);
+    unlink(m_socketPath.c_str());
+  }
+}
+
+/**
+ * @brief Accept connections and serve requests until a SHUTDOWN request.
+ *
+ * @return False if the socket could not be created.
+ */
+bool SolverService::run()
+{
+  struct sockaddr_un address;
+  if (!socketAddress(m_socketPath, address))
+    return false;
+  // A client that disconnects early must not kill the service
+  signal(SIGPIPE, SIG_IGN);
+  unlink(m_socketPath.c_str());
+  m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (m_listenFd < 0 || bind(m_listenFd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+      listen(m_listenFd, 64) != 0)
+    return false;
+
+  bool running = true;
+  while (running)
+  {
+    int fd = accept(m_listenFd, NULL, NULL);
+    if (fd < 0)
+      continue;
+    running = serve(fd);
+    close(fd);
+  }
+  return true;
+}
+
+/**
+ * @brief Serve one connection until the client closes it.
+ *
+ * @return False if a SHUTDOWN request was served.
+ */
+bool SolverService::serve(const int& a_fd)
+{
+  ServiceRequest request;
+  while (readFully(a_fd, &request, sizeof(request)))
+  {
+    auto start = chrono::steady_clock::now();
+    ServiceResponse response;
+    memset(&response, 0, sizeof(response));
+    response.magic = s_responseMagic;
+
+    if (request.magic != s_requestMagic || request.pathLength > 4096 || request.numValues > (1u << 28))
+    {
+      response.status = BAD_REQUEST;
+      m_numErrors++;
+      writeFully(a_fd, &response, sizeof(response));
+      return true;
+    }
+    std::string prefix(request.pathLength, '\0');
+    vector<double> rhs(request.numValues);
+    if (!readFully(a_fd, &prefix[0], request.pathLength) ||
+        !readFully(a_fd, rhs.data(), rhs.size() * sizeof(double)))
+      return true;
+
+    if (request.type == SOLVE)
+    {
+      vector<double> solution;
+      solve(request, prefix, rhs, response, solution);
+      response.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      if (response.status == OK)
+      {
+        if (m_latencies.size() < s_maxLatencies)
+          m_latencies.push_back(response.seconds);
+        else
+          m_latencies[m_numSolves % s_maxLatencies] = response.seconds;
+        m_numSolves++;
+      }
+      else
+      {
+        m_numErrors++;
+      }
+      if (!writeFully(a_fd, &response, sizeof(response)) ||
+          !writeFully(a_fd, solution.data(), solution.size() * sizeof(double)))
+        return true;
+    }
+    else if (request.type == STATS || request.type == SHUTDOWN)
+    {
+      std::ostringstream text;
+      printStatistics(text);
+      std::string s = text.str();
+      response.numValues = s.size();
+      if (!writeFully(a_fd, &response, sizeof(response)) || !writeFully(a_fd, s.data(), s.size()))
+        return true;
+      if (request.type == SHUTDOWN)
+        return false;
+    }
+    else
+    {
+      response.status = BAD_REQUEST;
+      m_numErrors++;
+      writeFully(a_fd, &response, sizeof(response));
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Handle a SOLVE request.
+ *
+ * Looks up (or loads) the mesh, then (or assembles and factors) the system for the
+ * requested conductivity, and solves with the cached preconditioner from a zero
+ * initial guess.
+ */
+void SolverService::solve(const ServiceRequest& a_request, const std::string& a_prefix, const vector<double>& a_rhs,
+                          ServiceResponse& a_response, vector<double>& a_solution)
+{
+  PROFILE_SCOPE("service_solve");
+  uint64_t hash;
+  if (!meshHash(a_prefix, hash))
+  {
+    a_response.status = MESH_NOT_FOUND;
+    return;
+  }
+  char meshKey[32];
+  snprintf(meshKey, sizeof(meshKey), "M:%016llx", (unsigned long long)hash);
+  std::string systemKey = std::string(meshKey) + ":";
+  for (int k = 0; k < DIM * DIM; k++)
+  {
+    char c[32];
+    snprintf(c, sizeof(c), "%.17g,", a_request.conductivity[k]);
+    systemKey += c;
+  }
+  systemKey[0] = 'S';
+
+  shared_ptr<System> system;
+  Entry* cached = lookup(systemKey);
+  if (cached)
+  {
+    m_systemHits++;
+    a_response.cacheHits |= 2;
+    system = cached->system;
+  }
+  else
+  {
+    m_systemMisses++;
+    shared_ptr<FEGrid> grid;
+    Entry* mesh = lookup(meshKey);
+    if (mesh)
+    {
+      m_meshHits++;
+      a_response.cacheHits |= 1;
+      grid = mesh->grid;
+    }
+    else
+    {
+      m_meshMisses++;
+      // A malformed mesh is rejected before anything about it is cached
+      grid.reset(new FEGrid());
+      if (!grid->load(a_prefix + ".node", a_prefix + ".elem"))
+      {
+        a_response.status = BAD_MESH;
+        return;
+      }
+      Entry entry = {meshKey, grid, shared_ptr<System>(),
+                     grid->getNumNodes() * sizeof(Node) + grid->getNumElts() * sizeof(Element)};
+      insert(entry);
+    }
+
+    system.reset(new System);
+    system->grid = grid;
+    system->assembler.reset(new FEAssembler(*grid, a_request.conductivity));
+    system->assembler->assemble();
+    system->solver.reset(new PCGSolver(system->assembler->matrix(), PCGSolver::IC0));
+    system->unitLoad.resize(grid->getNumInteriorNodes());
+    system->assembler->assembleLoad(1.0, system->unitLoad.data());
+
+    // Matrix and factor (about half the matrix), element matrices with their scatter map, work vectors
+    size_t nnz = system->assembler->matrix().nnz();
+    size_t numElts = grid->getNumElts();
+    size_t n = grid->getNumInteriorNodes();
+    Entry entry = {systemKey, shared_ptr<FEGrid>(), system,
+                   nnz * (sizeof(int) + sizeof(double)) * 3 / 2 +
+                   numElts * (VERTICES * VERTICES * (sizeof(int) + sizeof(double)) + DIM * DIM * sizeof(double)) +
+                   n * 7 * sizeof(double)};
+    insert(entry);
+  }
+
+  int n = system->unitLoad.size();
+  if (!a_rhs.empty() && (int)a_rhs.size() != n)
+  {
+    a_response.status = BAD_REQUEST;
+    return;
+  }
+  vector<double> load;
+  if (a_rhs.empty())
+  {
+    load.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+      load[i] = a_request.source * system->unitLoad[i];
+    }
+  }
+  a_solution.assign(n, 0.0);
+  double tolerance = (a_request.tolerance > 0) ? a_request.tolerance : 1e-10;
+  a_response.iterations = system->solver->solve(a_rhs.empty() ? load.data() : a_rhs.data(), a_solution.data(), tolerance);
+  a_response.residual = system->solver->getResidual();
+  a_response.numValues = n;
+  a_response.status = OK;
+}
+
+/**
+ * @brief Content hash of the mesh files of a prefix.
+ *
+ * @param a_prefix Mesh prefix.
+ * @param a_hash Hash to fill.
+ * @return False if a file could not be read.
+ * The files are only rehashed when their size or modification time changed.
+ */
+bool SolverService::meshHash(const std::string& a_prefix, uint64_t& a_hash)
+{
+  const std::string files[2] = {a_prefix + ".node", a_prefix + ".elem"};
+  FileHash current;
+  for (int f = 0; f < 2; f++)
+  {
+    struct stat st;
+    if (stat(files[f].c_str(), &st) != 0)
+      return false;
+    current.stamp[2 * f] = st.st_size;
+    current.stamp[2 * f + 1] = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+  }
+  unordered_map<std::string, FileHash>::const_iterator known = m_fileHashes.find(a_prefix);
+  if (known != m_fileHashes.end() && memcmp(known->second.stamp, current.stamp, sizeof(current.stamp)) == 0)
+  {
+    a_hash = known->second.hash;
+    return true;
+  }
+
+  uint64_t hash = ContentHash::s_offset;
+  if (!ContentHash::addFiles(vector<std::string>(files, files + 2), hash))
+    return false;
+  current.hash = hash;
+  m_fileHashes[a_prefix] = current;
+  a_hash = hash;
+  return true;
+}
+
+/**
+ * @brief Find an entry and mark it most recently used.
+ *
+ * @return The entry, or NULL.
+ */
+SolverService::Entry* SolverService::lookup(const std::string& a_key)
+{
+  unordered_map<std::string, list<Entry>::iterator>::iterator it = m_index.find(a_key);
+  if (it == m_index.end())
+    return NULL;
+  m_lru.splice(m_lru.begin(), m_lru, it->second);
+  return &m_lru.front();
+}
+
+/**
+ * @brief Insert an entry as most recently used and evict down to the budget.
+ *
+ * The new entry itself is never evicted, so a mesh larger than the budget is
+ * still served (and dropped by the next insertion). Evicted objects still in use
+ * by the current request stay alive through their shared pointers.
+ */
+void SolverService::insert(const Entry& a_entry)
+{
+  m_lru.push_front(a_entry);
+  m_index[a_entry.key] = m_lru.begin();
+  m_cachedBytes += a_entry.bytes;
+  while (m_cachedBytes > m_memoryBudget && m_lru.size() > 1)
+  {
+    m_cachedBytes -= m_lru.back().bytes;
+    m_index.erase(m_lru.back().key);
+    m_lru.pop_back();
+    m_evictions++;
+  }
+}
+
+/**
+ * @brief Print cache and request latency statistics.
+ *
+ * @param a_os Output stream.
+ */
+void SolverService::printStatistics(ostream& a_os) const
+{
+  a_os << "requests: " << m_numSolves << " solved, " << m_numErrors << " failed" << endl;
+  a_os << "mesh cache: " << m_meshHits << " hits, " << m_meshMisses << " misses" << endl;
+  a_os << "system cache: " << m_systemHits << " hits, " << m_systemMisses << " misses" << endl;
+  a_os << "cached: " << m_lru.size() << " entries, " << m_cachedBytes / 1e6 << " of " << m_memoryBudget / 1e6
+       << " MB, " << m_evictions << " evictions" << endl;
+  if (m_latencies.empty())
+    return;
+  vector<double> sorted(m_latencies);
+  sort(sorted.begin(), sorted.end());
+  double sum = 0.0;
+  for (size_t i = 0; i < sorted.size(); i++)
+  {
+    sum += sorted[i];
+  }
+  size_t last = sorted.size() - 1;
+  a_os << "latency ms (last " << sorted.size() << "): mean " << 1e3 * sum / sorted.size() << ", p50 "
+       << 1e3 * sorted[last / 2] << ", p95 " << 1e3 * sorted[(size_t)(0.95 * last)] << ", p99 "
+       << 1e3 * sorted[(size_t)(0.99 * last)] << ", max " << 1e3 * sorted[last] << endl;
+}
+
+/**
+ * @brief Send a request and read the response (client side).
+ *
+ * @param a_socketPath Path of the service socket.
+ * @param a_request Request header; magic and pathLength are filled in.
+ * @param a_prefix Mesh prefix.
+ * @param a_rhs Right hand side (may be empty); numValues is filled in.
+ * @param a_response Response header.
+ * @param a_payload Response payload (solution or statistics text bytes).
+ * @return False if the service could not be reached.
+ */
+bool SolverService::request(const std::string& a_socketPath, ServiceRequest& a_request, const std::string& a_prefix,
+                            const vector<double>& a_rhs, ServiceResponse& a_response, vector<char>& a_payload)
+{
+  struct sockaddr_un address;
+  if (!socketAddress(a_socketPath, address))
+    return false;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0)
+  {
+    if (fd >= 0)
+      close(fd);
+    return false;
+  }
+  a_request.magic = s_requestMagic;
+  a_request.pathLength = a_prefix.size();
+  a_request.numValues = a_rhs.size();
+  bool ok = writeFully(fd, &a_request, sizeof(a_request)) && writeFully(fd, a_prefix.data(), a_prefix.size()) &&
+            writeFully(fd, a_rhs.data(), a_rhs.size() * sizeof(double)) &&
+            readFully(fd, &a_response, sizeof(a_response)) && a_response.magic == s_responseMagic;
+  if (ok)
+  {
+    size_t bytes = (a_request.type == SOLVE) ? a_response.numValues * sizeof(double) : a_response.numValues;
+    a_payload.resize(bytes);
+    ok = readFully(fd, a_payload.data(), bytes);
+  }
+  close(fd);
+  return ok;
+}
@@ -0,0 +1,307 @@
+#include <cassert>
+#include <algorithm>
+#include "SparseMatrix.h"
+
+/**
+ * @brief Default constructor. Creates an empty 0x0 matrix.
+ */
+SparseMatrix::SparseMatrix() : m_numRows(0), m_nnz(0), m_isView(false), m_rowPtr(1, 0)
+{
+  bind();
+}
+
+/**
+ * @brief Constructor from a sparsity pattern. All values are set to zero.
+ *
+ * @param a_rowPtr Row pointers, of size numRows + 1.
+ * @param a_colInd Column indices, sorted within each row.
+ */
+SparseMatrix::SparseMatrix(const vector<int>& a_rowPtr, const vector<int>& a_colInd)
+  : m_numRows(a_rowPtr.size() - 1), m_nnz(a_colInd.size()), m_isView(false), m_rowPtr(a_rowPtr), m_colInd(a_colInd),
+    m_values(a_colInd.size(), 0.0)
+{
+  assert(m_rowPtr[m_numRows] == (int)m_colInd.size());
+  bind();
+}
+
+/**
+ * @brief Constructor wrapping existing CSR arrays without copying them.
+ *
+ * @param a_numRows Number of rows.
+ * @param a_rowPtr Row pointers, of size numRows + 1.
+ * @param a_colInd Column indices, sorted within each row.
+ * @param a_values Values; written by zero(), add() and addDiagonal().
+ */
+SparseMatrix::SparseMatrix(const int& a_numRows, const int* a_rowPtr, const int* a_colInd, double* a_values)
+  : m_numRows(a_numRows), m_nnz(a_rowPtr[a_numRows]), m_isView(true), m_rowPtrData(a_rowPtr), m_colIndData(a_colInd),
+    m_valuesData(a_values)
+{
+}
+
+/**
+ * @brief Copy constructor.
+ */
+SparseMatrix::SparseMatrix(const SparseMatrix& a_other)
+  : m_numRows(a_other.m_numRows), m_nnz(a_other.m_nnz), m_isView(a_other.m_isView), m_rowPtr(a_other.m_rowPtr),
+    m_colInd(a_other.m_colInd), m_values(a_other.m_values), m_rowPtrData(a_other.m_rowPtrData),
+    m_colIndData(a_other.m_colIndData), m_valuesData(a_other.m_valuesData)
+{
+  bind();
+}
+
+/**
+ * @brief Move constructor.
+ */
+SparseMatrix::SparseMatrix(SparseMatrix&& a_other)
+  : m_numRows(a_other.m_numRows), m_nnz(a_other.m_nnz), m_isView(a_other.m_isView),
+    m_rowPtr(std::move(a_other.m_rowPtr)), m_colInd(std::move(a_other.m_colInd)),
+    m_values(std::move(a_other.m_values)), m_rowPtrData(a_other.m_rowPtrData), m_colIndData(a_other.m_colIndData),
+    m_valuesData(a_other.m_valuesData)
+{
+  bind();
+  a_other = SparseMatrix();
+}
+
+/**
+ * @brief Copy assignment.
+ */
+SparseMatrix& SparseMatrix::operator=(const SparseMatrix& a_other)
+{
+  if (this != &a_other)
+  {
+    SparseMatrix copy(a_other);
+    *this = std::move(copy);
+  }
+  return *this;
+}
+
+/**
+ * @brief Move assignment.
+ */
+SparseMatrix& SparseMatrix::operator=(SparseMatrix&& a_other)
+{
+  if (this != &a_other)
+  {
+    m_numRows = a_other.m_numRows;
+    m_nnz = a_other.m_nnz;
+    m_isView = a_other.m_isView;
+    m_rowPtr.swap(a_other.m_rowPtr);
+    m_colInd.swap(a_other.m_colInd);
+    m_values.swap(a_other.m_values);
+    m_rowPtrData = a_other.m_rowPtrData;
+    m_colIndData = a_other.m_colIndData;
+    m_valuesData = a_other.m_valuesData;
+    bind();
+    a_other.m_isView = false;
+    a_other.m_numRows = 0;
+    a_other.m_nnz = 0;
+    a_other.m_rowPtr.assign(1, 0);
+    a_other.m_colInd.clear();
+    a_other.m_values.clear();
+    a_other.bind();
+  }
+  return *this;
+}
+
+/**
+ * @brief Point the array pointers at the owned vectors, unless the matrix is a view.
+ */
+void SparseMatrix::bind()
+{
+  if (m_isView)
+    return;
+  m_rowPtrData = m_rowPtr.data();
+  m_colIndData = m_colInd.data();
+  m_valuesData = m_values.data();
+}
+
+/**
+ * @brief Get the number of rows (and columns) of the matrix.
+ *
+ * @return The number of rows.
+ */
+int SparseMatrix::numRows() const
+{
+  return m_numRows;
+}
+
+/**
+ * @brief Get the number of stored entries.
+ *
+ * @return The number of non-zeros in the pattern.
+ */
+int SparseMatrix::nnz() const
+{
+  return m_nnz;
+}
+
+/**
+ * @brief Find the storage slot of entry (a_row, a_col) by binary search in the row.
+ *
+ * @param a_row Row index.
+ * @param a_col Column index.
+ * @return Index into values(), or -1 if the entry is not in the pattern.
+ */
+int SparseMatrix::find(const int& a_row, const int& a_col) const
+{
+  const int* first = m_colIndData + m_rowPtrData[a_row];
+  const int* last = m_colIndData + m_rowPtrData[a_row + 1];
+  const int* it = lower_bound(first, last, a_col);
+  if (it == last || *it != a_col)
+  {
+    return -1;
+  }
+  return it - m_colIndData;
+}
+
+/**
+ * @brief Set all stored values to zero, keeping the pattern.
+ */
+void SparseMatrix::zero()
+{
+  fill(m_valuesData, m_valuesData + m_nnz, 0.0);
+}
+
+/**
+ * @brief Add a multiple of another matrix with the same pattern, A += a_alpha * a_other.
+ *
+ * @param a_alpha Scale factor.
+ * @param a_other Matrix with an identical pattern.
+ */
+void SparseMatrix::add(const double& a_alpha, const SparseMatrix& a_other)
+{
+  assert(a_other.m_numRows == m_numRows && a_other.m_nnz == m_nnz);
+  for (int k = 0; k < m_nnz; k++)
+  {
+    m_valuesData[k] += a_alpha * a_other.m_valuesData[k];
+  }
+}
+
+/**
+ * @brief Add a_diag[i] to each diagonal entry A_ii.
+ *
+ * @param a_diag Vector of size numRows(); the pattern must contain the diagonal.
+ */
+void SparseMatrix::addDiagonal(const double* a_diag)
+{
+  for (int i = 0; i < m_numRows; i++)
+  {
+    int k = find(i, i);
+    assert(k >= 0);
+    m_valuesData[k] += a_diag[i];
+  }
+}
+
+/**
+ * @brief Compute a_y = A * a_x.
+ *
+ * @param a_x Input vector of size numRows().
+ * @param a_y Output vector of size numRows().
+ */
+void SparseMatrix::multiply(const double* a_x, double* a_y) const
+{
+  for (int i = 0; i < m_numRows; i++)
+  {
+    double sum = 0.0;
+    for (int k = m_rowPtrData[i]; k < m_rowPtrData[i + 1]; k++)
+    {
+      sum += m_valuesData[k] * a_x[m_colIndData[k]];
+    }
+    a_y[i] = sum;
+  }
+}
+
+/**
+ * @brief Copy the diagonal of the matrix. Missing diagonal entries are zero.
+ *
+ * @param a_diag Output vector of size numRows().
+ */
+void SparseMatrix::diagonal(double* a_diag) const
+{
+  for (int i = 0; i < m_numRows; i++)
+  {
+    int k = find(i, i);
+    a_diag[i] = (k < 0) ? 0.0 : m_valuesData[k];
+  }
+}
+
+/**
+ * @brief Lower bandwidth, the largest row - col over stored entries.
+ *
+ * @return The lower bandwidth.
+ */
+int SparseMatrix::lowerBandwidth() const
+{
+  int bandwidth = 0;
+  for (int i = 0; i < m_numRows; i++)
+  {
+    if (m_rowPtrData[i] < m_rowPtrData[i + 1])
+    {
+      bandwidth = max(bandwidth, i - m_colIndData[m_rowPtrData[i]]);
+    }
+  }
+  return bandwidth;
+}
+
+/**
+ * @brief Upper bandwidth, the largest col - row over stored entries.
+ *
+ * @return The upper bandwidth.
+ */
+int SparseMatrix::upperBandwidth() const
+{
+  int bandwidth = 0;
+  for (int i = 0; i < m_numRows; i++)
+  {
+    if (m_rowPtrData[i] < m_rowPtrData[i + 1])
+    {
+      bandwidth = max(bandwidth, m_colIndData[m_rowPtrData[i + 1] - 1] - i);
+    }
+  }
+  return bandwidth;
+}
+
+/**
+ * @brief Write the matrix in dense, space separated form (for debugging).
+ *
+ * @param a_os Output stream.
+ */
+void SparseMatrix::printDense(ostream& a_os) const
+{
+  for (int i = 0; i < m_numRows; i++)
+  {
+    int k = m_rowPtrData[i];
+    for (int j = 0; j < m_numRows; j++)
+    {
+      if (k < m_rowPtrData[i + 1] && m_colIndData[k] == j)
+      {
+        a_os << m_valuesData[k++];
+      }
+      else
+      {
+        a_os << 0;
+      }
+      a_os << ((j != m_numRows - 1) ? " " : "\n");
+    }
+  }
+}
+
+const int* SparseMatrix::rowPtr() const
+{
+  return m_rowPtrData;
+}
+
+const int* SparseMatrix::colInd() const
+{
+  return m_colIndData;
+}
+
+const double* SparseMatrix::values() const
+{
+  return m_valuesData;
+}
+
+double* SparseMatrix::values()
+{
+  return m_valuesData;
+}
@@ -0,0 +1,570 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <queue>
+#include <chrono>
+#include <unistd.h>
+#include "StreamAssembler.h"
+#include "Profiler.h"
+#include "FEGrid.h"
+#include "FEAssembler.h"
+
+static const int s_binaryMagic = 0x42454546; /**< "FEEB", first int32 of a binary element file. */
+static const size_t s_minMergeBuffer = 4096; /**< Smallest read buffer of a merge input, in triplets. */
+static const int s_maxFanIn = 64; /**< Largest number of runs merged at once (open files). */
+
+/**
+ * @brief Seconds elapsed since a_start.
+ */
+static double secondsSince(const chrono::steady_clock::time_point& a_start)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - a_start).count();
+}
+
+/**
+ * @brief Constructor reading the node file.
+ *
+ * @param a_nodeFileName The .node file.
+ * @param a_conductivity Conductivity tensor (row major DIM x DIM) of every element.
+ * @param a_memoryBudget Working memory in bytes for the chunk and merge buffers.
+ * @param a_tempDir Directory for the run files.
+ * Nodes are tagged and numbered exactly like FEGrid does. The node file is
+ * checked like FEGrid::load() does; if it is invalid the table stays empty
+ * and assemble() fails.
+ */
+StreamAssembler::StreamAssembler(const std::string& a_nodeFileName, const double a_conductivity[DIM * DIM],
+                                 const size_t& a_memoryBudget, const std::string& a_tempDir)
+  : m_numInteriorNodes(0), m_memoryBudget(a_memoryBudget), m_tempDir(a_tempDir), m_numSpilledRuns(0),
+    m_numMergePasses(0), m_nodesValid(false), m_binaryElements(NULL), m_remaining(0), m_peakBytes(0)
+{
+  for (int k = 0; k < DIM * DIM; k++)
+  {
+    m_conductivity[k] = a_conductivity[k];
+  }
+  memset(m_stages, 0, sizeof(m_stages));
+
+  ifstream nodes(a_nodeFileName.c_str());
+  int ncount = 0;
+  if (!nodes || !(nodes >> ncount) || ncount <= 0)
+    return;
+  m_coordinates.resize(ncount * DIM);
+  m_interiorID.resize(ncount);
+  vector<bool> isInterior(ncount), seen(ncount);
+  for (int i = 0; i < ncount; i++)
+  {
+    int vertex;
+    std::string tmp[DIM];
+    double x[DIM];
+    nodes >> vertex >> tmp[0] >> tmp[1];
+    vertex--;
+    if (!nodes || vertex < 0 || vertex >= ncount || seen[vertex])
+    {
+      vector<double>().swap(m_coordinates);
+      vector<int>().swap(m_interiorID);
+      return;
+    }
+    seen[vertex] = true;
+    x[0] = atof(tmp[0].c_str());
+    x[1] = atof(tmp[1].c_str());
+    m_coordinates[vertex * DIM] = x[0];
+    m_coordinates[vertex * DIM + 1] = x[1];
+    isInterior[vertex] = !FEGrid::isBoundaryPosition(x);
+  }
+  for (int i = 0; i < ncount; i++)
+  {
+    m_interiorID[i] = isInterior[i] ? m_numInteriorNodes++ : -1;
+  }
+  m_nodesValid = true;
+}
+
+/**
+ * @brief Convert a text .elem file to the binary element format.
+ *
+ * @param a_textFileName The .elem file to read.
+ * @param a_binaryFileName The binary file to write.
+ * @return False if a file could not be opened.
+ */
+bool StreamAssembler::writeBinaryElements(const std::string& a_textFileName, const std::string& a_binaryFileName)
+{
+  ifstream elements(a_textFileName.c_str());
+  FILE* fp = fopen(a_binaryFileName.c_str(), "wb");
+  if (!elements || !fp)
+  {
+    if (fp)
+      fclose(fp);
+    return false;
+  }
+  int ncell = 0;
+  elements >> ncell;
+  fwrite(&s_binaryMagic, sizeof(int), 1, fp);
+  fwrite(&ncell, sizeof(int), 1, fp);
+
+  // Copy the elements in file order through a fixed size buffer; the element
+  // numbers are dropped since assembly does not depend on the element order
+  const int bufferSize = 65536;
+  vector<int> vertices(bufferSize * VERTICES);
+  for (int first = 0; first < ncell; first += bufferSize)
+  {
+    int count = min(bufferSize, ncell - first);
+    for (int i = 0; i < count; i++)
+    {
+      int cellID;
+      elements >> cellID;
+      for (int ivert = 0; ivert < VERTICES; ivert++)
+      {
+        elements >> vertices[i * VERTICES + ivert];
+      }
+    }
+    fwrite(vertices.data(), sizeof(int), count * VERTICES, fp);
+  }
+  fclose(fp);
+  return true;
+}
+
+/**
+ * @brief Read up to a_max elements (0-based vertices) from the open element file.
+ *
+ * @return The number of elements read, or -1 if the file is truncated or a vertex is out of range.
+ * The header promises m_remaining elements, so a short read is an error, not
+ * the end of the file.
+ */
+int StreamAssembler::readElements(int* a_vertices, const int& a_max)
+{
+  int count = min(a_max, m_remaining);
+  if (m_binaryElements)
+  {
+    if ((int)fread(a_vertices, sizeof(int) * VERTICES, count, m_binaryElements) != count)
+      return -1;
+    m_stages[0].bytes += (long)count * VERTICES * sizeof(int);
+  }
+  else
+  {
+    streampos first = m_textElements.tellg();
+    for (int i = 0; i < count; i++)
+    {
+      int cellID;
+      m_textElements >> cellID;
+      for (int ivert = 0; ivert < VERTICES; ivert++)
+      {
+        m_textElements >> a_vertices[i * VERTICES + ivert];
+      }
+    }
+    if (!m_textElements)
+      return -1;
+    m_stages[0].bytes += m_textElements.tellg() - first;
+  }
+  const int numNodes = m_interiorID.size();
+  for (int k = 0; k < count * VERTICES; k++)
+  {
+    if (a_vertices[k] < 1 || a_vertices[k] > numNodes)
+      return -1;
+    a_vertices[k]--;
+  }
+  m_remaining -= count;
+  return count;
+}
+
+/**
+ * @brief Assemble the stiffness matrix and the load vector of a uniform source.
+ *
+ * @param a_elementFileName Text .elem file or binary element file (see writeBinaryElements()).
+ * @param a_matrix Matrix to fill with the stiffness matrix over the interior nodes.
+ * @param a_load Vector to fill with the load vector.
+ * @param a_source Uniform source value f.
+ * @return False if the node file was invalid, a file could not be opened, read or written, or the element
+ * file is truncated or malformed.
+ * The chunk size is chosen so that the vertex buffer and the VERTICES^2 triplets
+ * per element fit in the memory budget.
+ */
+bool StreamAssembler::assemble(const std::string& a_elementFileName, SparseMatrix& a_matrix, vector<double>& a_load,
+                               const double& a_source)
+{
+  PROFILE_SCOPE("stream_assembly");
+  const char* names[5] = {"parse", "kernel", "sort", "spill", "merge"};
+  for (int s = 0; s < 5; s++)
+  {
+    m_stages[s].name = names[s];
+    m_stages[s].seconds = 0.0;
+    m_stages[s].items = 0;
+    m_stages[s].bytes = 0;
+  }
+  m_runs.clear();
+  m_runLengths.clear();
+  m_numSpilledRuns = 0;
+  m_numMergePasses = 0;
+  m_peakBytes = 0;
+  if (!m_nodesValid)
+  {
+    return false;
+  }
+
+  // Detect the element file format from its first int32
+  m_binaryElements = fopen(a_elementFileName.c_str(), "rb");
+  if (!m_binaryElements)
+  {
+    return false;
+  }
+  int header[2] = {0, 0};
+  if (fread(header, sizeof(int), 2, m_binaryElements) == 2 && header[0] == s_binaryMagic)
+  {
+    m_remaining = header[1];
+  }
+  else
+  {
+    fclose(m_binaryElements);
+    m_binaryElements = NULL;
+    m_textElements.close();
+    m_textElements.clear();
+    m_textElements.open(a_elementFileName.c_str());
+    m_textElements >> m_remaining;
+    if (!m_textElements)
+      m_remaining = -1;
+  }
+  if (m_remaining < 0)
+  {
+    if (m_binaryElements)
+      fclose(m_binaryElements);
+    m_binaryElements = NULL;
+    m_textElements.close();
+    return false;
+  }
+
+  const size_t bytesPerElement = VERTICES * sizeof(int) + VERTICES * VERTICES * sizeof(Triplet);
+  const int chunkSize = max<size_t>(1, m_memoryBudget / bytesPerElement);
+  vector<int> vertices(chunkSize * VERTICES);
+  vector<Triplet> triplets;
+  triplets.reserve(chunkSize * VERTICES * VERTICES);
+  a_load.assign(m_numInteriorNodes, 0.0);
+
+  bool ok = true;
+  while (m_remaining > 0)
+  {
+    auto start = chrono::steady_clock::now();
+    int count = readElements(vertices.data(), chunkSize);
+    m_stages[0].seconds += secondsSince(start);
+    if (count <= 0)
+    {
+      ok = false;
+      break;
+    }
+    m_stages[0].items += count;
+
+    // Element kernels: interior entries of every element of the chunk
+    start = chrono::steady_clock::now();
+    triplets.clear();
+    for (int i = 0; i < count; i++)
+    {
+      const int* v = &vertices[i * VERTICES];
+      double x[VERTICES][DIM];
+      int rows[VERTICES];
+      for (int m = 0; m < VERTICES; m++)
+      {
+        x[m][0] = m_coordinates[v[m] * DIM];
+        x[m][1] = m_coordinates[v[m] * DIM + 1];
+        rows[m] = m_interiorID[v[m]];
+      }
+      double kij[VERTICES * VERTICES];
+      FEAssembler::elementStiffness(x, m_conductivity, kij);
+      double share = a_source * fabs((x[1][0] - x[0][0]) * (x[2][1] - x[0][1]) - (x[2][0] - x[0][0]) * (x[1][1] - x[0][1])) / 2 / VERTICES;
+      for (int m = 0; m < VERTICES; m++)
+      {
+        if (rows[m] < 0)
+          continue;
+        a_load[rows[m]] += share;
+        for (int n = 0; n < VERTICES; n++)
+        {
+          if (rows[n] >= 0)
+          {
+            Triplet t = {rows[m], rows[n], kij[m * VERTICES + n]};
+            triplets.push_back(t);
+          }
+        }
+      }
+    }
+    m_stages[1].seconds += secondsSince(start);
+    m_stages[1].items += count;
+    m_peakBytes = max(m_peakBytes, vertices.size() * sizeof(int) + triplets.capacity() * sizeof(Triplet));
+
+    // Sort the chunk and combine duplicate entries
+    start = chrono::steady_clock::now();
+    sort(triplets.begin(), triplets.end(), [](const Triplet& a, const Triplet& b)
+         { return (a.row < b.row) || (a.row == b.row && a.col < b.col); });
+    size_t out = 0;
+    for (size_t k = 0; k < triplets.size(); k++)
+    {
+      if (out > 0 && triplets[out - 1].row == triplets[k].row && triplets[out - 1].col == triplets[k].col)
+        triplets[out - 1].value += triplets[k].value;
+      else
+        triplets[out++] = triplets[k];
+    }
+    triplets.resize(out);
+    m_stages[2].seconds += secondsSince(start);
+    m_stages[2].items += out;
+
+    // Spill the sorted run
+    start = chrono::steady_clock::now();
+    char runName[64];
+    snprintf(runName, sizeof(runName), "/femrun_%d_%d.bin", (int)getpid(), (int)m_runs.size());
+    std::string runFile = m_tempDir + runName;
+    FILE* fp = fopen(runFile.c_str(), "wb");
+    if (!fp || fwrite(triplets.data(), sizeof(Triplet), out, fp) != out)
+    {
+      if (fp)
+        fclose(fp);
+      ok = false;
+      break;
+    }
+    fclose(fp);
+    m_runs.push_back(runFile);
+    m_runLengths.push_back(out);
+    m_numSpilledRuns++;
+    m_stages[3].seconds += secondsSince(start);
+    m_stages[3].items += out;
+    m_stages[3].bytes += out * sizeof(Triplet);
+  }
+
+  if (m_binaryElements)
+  {
+    fclose(m_binaryElements);
+    m_binaryElements = NULL;
+  }
+  m_textElements.close();
+  vector<int>().swap(vertices);
+  vector<Triplet>().swap(triplets);
+
+  if (ok)
+  {
+    auto start = chrono::steady_clock::now();
+    ok = merge(a_matrix);
+    m_stages[4].seconds += secondsSince(start);
+  }
+  for (size_t r = 0; r < m_runs.size(); r++)
+  {
+    remove(m_runs[r].c_str());
+  }
+  PROFILE_COUNT("elements_integrated", m_stages[1].items);
+  PROFILE_COUNT("bytes_written", m_stages[3].bytes);
+  return ok;
+}
+
+/**
+ * @brief Merge the run files into the CSR matrix.
+ *
+ * @return False if a run file could not be read or written.
+ * The fan-in F is the number of read buffers of at least s_minMergeBuffer
+ * triplets that fit in the budget next to one output buffer (at least 2, at
+ * most s_maxFanIn). While there are more than F runs, every group of F runs is
+ * merged into an intermediate run on disk; the last pass merges at most F
+ * runs straight into the CSR arrays. Memory and open files are bounded by F
+ * whatever the number of runs.
+ */
+bool StreamAssembler::merge(SparseMatrix& a_matrix)
+{
+  const size_t numBuffers = m_memoryBudget / (s_minMergeBuffer * sizeof(Triplet));
+  const size_t fanIn = min<size_t>(s_maxFanIn, max<size_t>(3, numBuffers) - 1);
+  const size_t bufferSize = max<size_t>(1, m_memoryBudget / ((fanIn + 1) * sizeof(Triplet)));
+
+  // Intermediate passes: runs [first, first + F) become one run of the next pass
+  while (m_runs.size() > fanIn)
+  {
+    m_numMergePasses++;
+    vector<std::string> runs;
+    vector<long> runLengths;
+    for (size_t first = 0; first < m_runs.size(); first += fanIn)
+    {
+      size_t last = min(first + fanIn, m_runs.size());
+      char runName[64];
+      snprintf(runName, sizeof(runName), "/femrun_%d_p%d_%d.bin", (int)getpid(), m_numMergePasses, (int)runs.size());
+      std::string runFile = m_tempDir + runName;
+      FILE* fp = fopen(runFile.c_str(), "wb");
+      if (!fp)
+        return false;
+      runs.push_back(runFile);
+      runLengths.push_back(0);
+      vector<Triplet> output;
+      output.reserve(bufferSize);
+      auto flush = [&]() -> bool
+      {
+        size_t count = output.size();
+        m_stages[3].bytes += count * sizeof(Triplet);
+        bool written = fwrite(output.data(), sizeof(Triplet), count, fp) == count;
+        output.clear();
+        return written;
+      };
+      bool ok = mergeRuns(first, last, bufferSize, [&](const Triplet& a_t) -> bool
+      {
+        output.push_back(a_t);
+        runLengths.back()++;
+        return output.size() < bufferSize || flush();
+      });
+      ok = ok && flush();
+      fclose(fp);
+      for (size_t r = first; r < last; r++)
+      {
+        remove(m_runs[r].c_str());
+      }
+      if (!ok)
+      {
+        // The unmerged inputs of this pass are still listed for removal
+        m_runs.erase(m_runs.begin(), m_runs.begin() + last);
+        m_runs.insert(m_runs.end(), runs.begin(), runs.end());
+        return false;
+      }
+    }
+    m_runs.swap(runs);
+    m_runLengths.swap(runLengths);
+    m_peakBytes = max(m_peakBytes, (fanIn + 1) * bufferSize * sizeof(Triplet));
+  }
+
+  // Final pass into the CSR arrays
+  m_numMergePasses++;
+  vector<int> rowPtr(m_numInteriorNodes + 1, 0);
+  vector<int> colInd;
+  vector<double> values;
+  bool ok = mergeRuns(0, m_runs.size(), bufferSize, [&](const Triplet& a_t) -> bool
+  {
+    colInd.push_back(a_t.col);
+    values.push_back(a_t.value);
+    rowPtr[a_t.row + 1] = colInd.size();
+    return true;
+  });
+  m_peakBytes = max(m_peakBytes, m_runs.size() * bufferSize * sizeof(Triplet));
+
+  // Rows without entries inherit the end of the previous row
+  for (int i = 0; i < m_numInteriorNodes; i++)
+  {
+    rowPtr[i + 1] = max(rowPtr[i + 1], rowPtr[i]);
+  }
+  a_matrix = SparseMatrix(rowPtr, colInd);
+  copy(values.begin(), values.end(), a_matrix.values());
+  return ok;
+}
+
+/**
+ * @brief Merge a group of runs in (row, col) order, summing equal keys.
+ *
+ * @param a_first First run of the group.
+ * @param a_last One past the last run.
+ * @param a_bufferSize Read buffer per run, in triplets.
+ * @param a_emit Called with every combined entry in order; returns false on a write error.
+ * @return False if a run could not be read or a_emit failed.
+ * A min-heap keyed on (row, col) yields the entries in order; an entry is
+ * emitted once the next key differs, so equal keys from different runs are summed.
+ */
+bool StreamAssembler::mergeRuns(const int& a_first, const int& a_last, const size_t& a_bufferSize,
+                                const function<bool(const Triplet&)>& a_emit)
+{
+  struct Reader
+  {
+    FILE* fp;
+    vector<Triplet> buffer;
+    size_t position;
+    long remaining;
+  };
+  const int numRuns = a_last - a_first;
+  vector<Reader> readers(numRuns);
+
+  // Refill the buffer of a reader; false when the run is exhausted or unreadable
+  bool readError = false;
+  auto refill = [&](Reader& r) -> bool
+  {
+    size_t count = min<long>(a_bufferSize, r.remaining);
+    r.buffer.resize(count);
+    if (count == 0)
+      return false;
+    if (fread(r.buffer.data(), sizeof(Triplet), count, r.fp) != count)
+    {
+      readError = true;
+      return false;
+    }
+    r.remaining -= count;
+    r.position = 0;
+    m_stages[4].bytes += count * sizeof(Triplet);
+    return true;
+  };
+
+  typedef pair<pair<int, int>, int> HeapEntry;  // ((row, col), reader)
+  priority_queue<HeapEntry, vector<HeapEntry>, greater<HeapEntry> > heap;
+  bool ok = true;
+  for (int r = 0; r < numRuns; r++)
+  {
+    readers[r].fp = fopen(m_runs[a_first + r].c_str(), "rb");
+    readers[r].remaining = m_runLengths[a_first + r];
+    if (!readers[r].fp)
+    {
+      ok = false;
+      continue;
+    }
+    if (refill(readers[r]))
+    {
+      heap.push(HeapEntry(make_pair(readers[r].buffer[0].row, readers[r].buffer[0].col), r));
+    }
+  }
+
+  Triplet pending = {-1, -1, 0.0};
+  while (ok && !readError && !heap.empty())
+  {
+    HeapEntry top = heap.top();
+    heap.pop();
+    Reader& reader = readers[top.second];
+    const Triplet& t = reader.buffer[reader.position];
+    if (t.row == pending.row && t.col == pending.col)
+    {
+      pending.value += t.value;
+    }
+    else
+    {
+      if (pending.row >= 0 && !a_emit(pending))
+        ok = false;
+      pending = t;
+    }
+    m_stages[4].items++;
+
+    reader.position++;
+    if (reader.position < reader.buffer.size() || refill(reader))
+    {
+      const Triplet& next = reader.buffer[reader.position];
+      heap.push(HeapEntry(make_pair(next.row, next.col), top.second));
+    }
+  }
+  if (ok && !readError && pending.row >= 0 && !a_emit(pending))
+    ok = false;
+  for (int r = 0; r < numRuns; r++)
+  {
+    if (readers[r].fp)
+      fclose(readers[r].fp);
+  }
+  return ok && !readError;
+}
+
+/**
+ * @brief Print time, volume and throughput of each stage of the last assemble().
+ *
+ * @param a_os Output stream.
+ */
+void StreamAssembler::printStatistics(ostream& a_os) const
+{
+  char line[160];
+  snprintf(line, sizeof(line), "Streaming assembly: %d runs, %d merge passes, budget %.2f MB, peak working memory %.2f MB\n",
+           m_numSpilledRuns, m_numMergePasses, m_memoryBudget / 1e6, m_peakBytes / 1e6);
+  a_os << line;
+  for (int s = 0; s < 5; s++)
+  {
+    const Stage& stage = m_stages[s];
+    double seconds = max(stage.seconds, 1e-9);
+    snprintf(line, sizeof(line), "  %-6s %9.3f ms %12ld items %12.3g items/s %10.1f MB/s\n",
+             stage.name, stage.seconds * 1000, stage.items, stage.items / seconds, stage.bytes / seconds / 1e6);
+    a_os << line;
+  }
+}
+
+/**
+ * @brief Get the number of interior nodes (rows of the matrix).
+ *
+ * @return The number of interior nodes.
+ */
+int StreamAssembler::getNumInteriorNodes() const
+{
+  return m_numInteriorNodes;
+}
@@ -0,0 +1,239 @@
+#include "ThreadPool.h"
+
+/** Pool of the calling worker thread, NULL for other threads. */
+static thread_local const ThreadPool* s_pool = NULL;
+
+/** Index of the calling worker thread in s_pool. */
+static thread_local int s_worker = -1;
+
+/**
+ * @brief Constructor starting the workers.
+ *
+ * @param a_numThreads Number of workers, 0 for the number of hardware threads.
+ */
+ThreadPool::ThreadPool(const int& a_numThreads)
+  : m_queued(0), m_pending(0), m_next(0), m_numTasks(0), m_numSteals(0), m_stop(false)
+{
+  int numThreads = a_numThreads;
+  if (numThreads <= 0)
+    numThreads = max(1u, thread::hardware_concurrency());
+  for (int w = 0; w < numThreads; w++)
+  {
+    m_queues.push_back(unique_ptr<Queue>(new Queue()));
+  }
+  for (int w = 0; w < numThreads; w++)
+  {
+    m_threads.push_back(thread(&ThreadPool::work, this, w));
+  }
+}
+
+/**
+ * @brief Destructor finishing all submitted tasks and joining the workers.
+ */
+ThreadPool::~ThreadPool()
+{
+  wait();
+  {
+    lock_guard<mutex> guard(m_lock);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for (size_t w = 0; w < m_threads.size(); w++)
+  {
+    m_threads[w].join();
+  }
+}
+
+/**
+ * @brief Queue a task.
+ *
+ * @param a_task The task; it may submit further tasks.
+ */
+void ThreadPool::submit(const Task& a_task)
+{
+  int worker = currentWorker();
+  if (worker < 0)
+    worker = m_next++ % m_queues.size();
+  m_pending++;
+  {
+    lock_guard<mutex> guard(m_queues[worker]->lock);
+    m_queues[worker]->tasks.push_back(a_task);
+  }
+  m_queued++;
+  // Taking the lock orders the notification after a sleeping worker's check of m_queued
+  lock_guard<mutex> guard(m_lock);
+  m_wake.notify_one();
+}
+
+/**
+ * @brief Block until every submitted task (including tasks they submitted) has finished.
+ */
+void ThreadPool::wait()
+{
+  unique_lock<mutex> guard(m_lock);
+  m_idle.wait(guard, [this] { return m_pending == 0; });
+}
+
+/**
+ * @brief Run a_body(begin, end) over chunks of [a_begin, a_end) in parallel.
+ *
+ * @param a_begin First index.
+ * @param a_end One past the last index.
+ * @param a_grain Chunk size; a range no larger than this runs inline.
+ * @param a_body Loop body called with disjoint subranges.
+ * The calling thread runs chunks itself (and any other queued task) while it waits.
+ */
+void ThreadPool::parallelFor(const int& a_begin, const int& a_end, const int& a_grain,
+                             const function<void(int, int)>& a_body)
+{
+  int grain = max(1, a_grain);
+  if (a_end - a_begin <= grain || m_queues.size() == 1)
+  {
+    if (a_end > a_begin)
+      a_body(a_begin, a_end);
+    return;
+  }
+  int numChunks = (a_end - a_begin + grain - 1) / grain;
+  shared_ptr<atomic<int> > remaining(new atomic<int>(numChunks - 1));
+  for (int c = 1; c < numChunks; c++)
+  {
+    int begin = a_begin + c * grain;
+    int end = min(a_end, begin + grain);
+    submit([remaining, begin, end, &a_body] {
+      a_body(begin, end);
+      (*remaining)--;
+    });
+  }
+  a_body(a_begin, min(a_end, a_begin + grain));
+  int worker = currentWorker();
+  while (*remaining > 0)
+  {
+    if (!runOne(worker))
+      this_thread::yield();
+  }
+}
+
+/**
+ * @brief Get the number of workers.
+ *
+ * @return The number of threads.
+ */
+int ThreadPool::numThreads() const
+{
+  return m_threads.size();
+}
+
+/**
+ * @brief Get the number of tasks run so far.
+ *
+ * @return The number of tasks.
+ */
+long ThreadPool::getNumTasks() const
+{
+  return m_numTasks;
+}
+
+/**
+ * @brief Get the number of tasks taken from another worker's deque.
+ *
+ * @return The number of steals.
+ */
+long ThreadPool::getNumSteals() const
+{
+  return m_numSteals;
+}
+
+/**
+ * @brief Index of the calling thread among the workers of this pool.
+ *
+ * @return The worker index, -1 for other threads.
+ */
+int ThreadPool::currentWorker() const
+{
+  return (s_pool == this) ? s_worker : -1;
+}
+
+/**
+ * @brief Take a task: from the back of the own deque, else from the front of another.
+ *
+ * @param a_worker Worker index, -1 to only steal.
+ * @param a_task Task to fill.
+ * @return False if every deque is empty.
+ */
+bool ThreadPool::take(const int& a_worker, Task& a_task)
+{
+  if (m_queued == 0)
+    return false;
+  if (a_worker >= 0)
+  {
+    Queue& own = *m_queues[a_worker];
+    lock_guard<mutex> guard(own.lock);
+    if (!own.tasks.empty())
+    {
+      a_task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      m_queued--;
+      return true;
+    }
+  }
+  // Visit the victims starting after the thief, so thieves spread over the deques
+  int numQueues = m_queues.size();
+  for (int i = 1; i <= numQueues; i++)
+  {
+    int victim = (a_worker + i + numQueues) % numQueues;
+    if (victim == a_worker)
+      continue;
+    Queue& other = *m_queues[victim];
+    lock_guard<mutex> guard(other.lock);
+    if (!other.tasks.empty())
+    {
+      a_task = std::move(other.tasks.front());
+      other.tasks.pop_front();
+      m_queued--;
+      m_numSteals++;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Run one queued task if there is one.
+ *
+ * @param a_worker Worker index, -1 for other threads.
+ * @return False if no task was found.
+ */
+bool ThreadPool::runOne(const int& a_worker)
+{
+  Task task;
+  if (!take(a_worker, task))
+    return false;
+  task();
+  m_numTasks++;
+  if (--m_pending == 0)
+  {
+    lock_guard<mutex> guard(m_lock);
+    m_idle.notify_all();
+  }
+  return true;
+}
+
+/**
+ * @brief Main loop of a worker.
+ *
+ * @param a_worker Worker index.
+ */
+void ThreadPool::work(const int& a_worker)
+{
+  s_pool = this;
+  s_worker = a_worker;
+  while (true)
+  {
+    if (runOne(a_worker))
+      continue;
+    unique_lock<mutex> guard(m_lock);
+    m_wake.wait(guard, [this] { return m_stop || m_queued > 0; });
+    if (m_stop && m_queued == 0)
+      return;
+  }
+}
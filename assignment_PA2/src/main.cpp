@@ -1,11 +1,14 @@
 #include "GridFn.h"
 #include "Solution.h"
 #include "RDomain.h"
+#include "Profiler.h"
 #include <iostream>
 #include <string>
 
 
+// Set FEM_PROFILE=1 for a per-phase summary or FEM_TRACE=<file> for a Chrome trace (see Profiler.h)
 int main(int argc, char* argv[]) {
+    PROFILE_SCOPE("part2");
     // Read command-line arguments for l (length), dt (time step), and dx (space step)
     if (argc != 4) {
         std::cerr << "Usage: " << argv[0] << " <length> <time-step> <space-step>" << std::endl;